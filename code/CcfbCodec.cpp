@@ -0,0 +1,204 @@
+#include "CcfbCodec.h"
+
+/*
+* Select the instruction set at compile time, SSE2 is always available
+*  on x86-64, AVX2 requires -mavx2 or -march=native
+*/
+#if !defined(CCFB_SCALAR) && defined(__AVX2__)
+#define CCFB_AVX2
+#include <immintrin.h>
+#elif !defined(CCFB_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CCFB_SSE2
+#include <emmintrin.h>
+#elif !defined(CCFB_SCALAR) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define CCFB_NEON
+#include <arm_neon.h>
+#endif
+
+static const uint16_t kReceived = 0x8000;
+static const uint16_t kCeMask = 0x03;
+static const uint16_t kAtoMask = 0x1FFF;
+static const uint16_t kAtoMax = 0x1FFE; // 0x1FFF means ATO unavailable
+
+void CcfbCodec::encodeReports(uint32_t time_ntp,
+	uint16_t sn,
+	const uint16_t* seqNrHist,
+	const uint32_t* rxTimeHist,
+	const uint8_t* ceBitsHist,
+	int n,
+	unsigned char* buf) {
+	int k = 0;
+#if defined(CCFB_AVX2)
+	const __m256i vIdx = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m256i vTime = _mm256_set1_epi32(time_ntp);
+	const __m256i vZero = _mm256_setzero_si256();
+	const __m256i vAtoMax = _mm256_set1_epi16(kAtoMax);
+	const __m256i vCeMask = _mm256_set1_epi16(kCeMask);
+	const __m256i vReceived = _mm256_set1_epi16(short(kReceived));
+	for (; k + 16 <= n; k += 16) {
+		__m256i vSn = _mm256_add_epi16(_mm256_set1_epi16(short(uint16_t(sn + k))), vIdx);
+		__m256i isSeq = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(seqNrHist + k)), vSn);
+		__m256i t0 = _mm256_loadu_si256((const __m256i*)(rxTimeHist + k));
+		__m256i t1 = _mm256_loadu_si256((const __m256i*)(rxTimeHist + k + 8));
+		/*
+		* The 32 to 16 bit packing is done per 128 bit lane, the permute
+		*  restores the order
+		*/
+		__m256i isZero = _mm256_packs_epi32(_mm256_cmpeq_epi32(t0, vZero), _mm256_cmpeq_epi32(t1, vZero));
+		isZero = _mm256_permute4x64_epi64(isZero, 0xD8);
+		__m256i isValid = _mm256_andnot_si256(isZero, isSeq);
+		/*
+		* ATO in Q10 is less than 2^26, the signed saturation limits it to 0x7FFF
+		*/
+		__m256i a0 = _mm256_srli_epi32(_mm256_sub_epi32(vTime, t0), 6);
+		__m256i a1 = _mm256_srli_epi32(_mm256_sub_epi32(vTime, t1), 6);
+		__m256i ato = _mm256_permute4x64_epi64(_mm256_packs_epi32(a0, a1), 0xD8);
+		ato = _mm256_min_epi16(ato, vAtoMax);
+		__m256i ce = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(ceBitsHist + k)));
+		ce = _mm256_slli_epi16(_mm256_and_si256(ce, vCeMask), 13);
+		__m256i w = _mm256_and_si256(_mm256_or_si256(_mm256_or_si256(vReceived, ce), ato), isValid);
+		w = _mm256_or_si256(_mm256_slli_epi16(w, 8), _mm256_srli_epi16(w, 8));
+		_mm256_storeu_si256((__m256i*)(buf + 2 * k), w);
+	}
+#elif defined(CCFB_SSE2)
+	const __m128i vIdx = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m128i vTime = _mm_set1_epi32(time_ntp);
+	const __m128i vZero = _mm_setzero_si128();
+	const __m128i vAtoMax = _mm_set1_epi16(kAtoMax);
+	const __m128i vCeMask = _mm_set1_epi16(kCeMask);
+	const __m128i vReceived = _mm_set1_epi16(short(kReceived));
+	for (; k + 8 <= n; k += 8) {
+		__m128i vSn = _mm_add_epi16(_mm_set1_epi16(short(uint16_t(sn + k))), vIdx);
+		__m128i isSeq = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(seqNrHist + k)), vSn);
+		__m128i t0 = _mm_loadu_si128((const __m128i*)(rxTimeHist + k));
+		__m128i t1 = _mm_loadu_si128((const __m128i*)(rxTimeHist + k + 4));
+		__m128i isZero = _mm_packs_epi32(_mm_cmpeq_epi32(t0, vZero), _mm_cmpeq_epi32(t1, vZero));
+		__m128i isValid = _mm_andnot_si128(isZero, isSeq);
+		/*
+		* ATO in Q10 is less than 2^26, the signed saturation limits it to 0x7FFF
+		*/
+		__m128i a0 = _mm_srli_epi32(_mm_sub_epi32(vTime, t0), 6);
+		__m128i a1 = _mm_srli_epi32(_mm_sub_epi32(vTime, t1), 6);
+		__m128i ato = _mm_min_epi16(_mm_packs_epi32(a0, a1), vAtoMax);
+		__m128i ce = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(ceBitsHist + k)), vZero);
+		ce = _mm_slli_epi16(_mm_and_si128(ce, vCeMask), 13);
+		__m128i w = _mm_and_si128(_mm_or_si128(_mm_or_si128(vReceived, ce), ato), isValid);
+		w = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));
+		_mm_storeu_si128((__m128i*)(buf + 2 * k), w);
+	}
+#elif defined(CCFB_NEON)
+	static const uint16_t kIdx[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+	const uint16x8_t vIdx = vld1q_u16(kIdx);
+	const uint32x4_t vTime = vdupq_n_u32(time_ntp);
+	const uint32x4_t vZero = vdupq_n_u32(0);
+	const uint16x8_t vAtoMax = vdupq_n_u16(kAtoMax);
+	const uint16x8_t vCeMask = vdupq_n_u16(kCeMask);
+	const uint16x8_t vReceived = vdupq_n_u16(kReceived);
+	for (; k + 8 <= n; k += 8) {
+		uint16x8_t vSn = vaddq_u16(vdupq_n_u16(uint16_t(sn + k)), vIdx);
+		uint16x8_t isSeq = vceqq_u16(vld1q_u16(seqNrHist + k), vSn);
+		uint32x4_t t0 = vld1q_u32(rxTimeHist + k);
+		uint32x4_t t1 = vld1q_u32(rxTimeHist + k + 4);
+		uint16x8_t isZero = vcombine_u16(vmovn_u32(vceqq_u32(t0, vZero)), vmovn_u32(vceqq_u32(t1, vZero)));
+		uint16x8_t isValid = vbicq_u16(isSeq, isZero);
+		uint16x8_t ato = vcombine_u16(vqmovn_u32(vshrq_n_u32(vsubq_u32(vTime, t0), 6)),
+			vqmovn_u32(vshrq_n_u32(vsubq_u32(vTime, t1), 6)));
+		ato = vminq_u16(ato, vAtoMax);
+		uint16x8_t ce = vshlq_n_u16(vandq_u16(vmovl_u8(vld1_u8(ceBitsHist + k)), vCeMask), 13);
+		uint16x8_t w = vandq_u16(vorrq_u16(vorrq_u16(vReceived, ce), ato), isValid);
+		vst1q_u8(buf + 2 * k, vrev16q_u8(vreinterpretq_u8_u16(w)));
+	}
+#endif
+	for (; k < n; k++) {
+		uint16_t tmp_s = 0x0000;
+		if (seqNrHist[k] == uint16_t(sn + k) && rxTimeHist[k] != 0) {
+			uint32_t ato = (time_ntp - rxTimeHist[k]) >> 6; // Q16->Q10
+			if (ato > kAtoMax)
+				ato = kAtoMax;
+			tmp_s = kReceived | ((ceBitsHist[k] & kCeMask) << 13) | ato;
+		}
+		buf[2 * k] = tmp_s >> 8;
+		buf[2 * k + 1] = tmp_s & 0xFF;
+	}
+}
+
+void CcfbCodec::decodeReports(uint32_t rts,
+	const unsigned char* buf,
+	int n,
+	uint8_t* isRx,
+	uint8_t* ceBits,
+	uint32_t* rxTime) {
+	int k = 0;
+#if defined(CCFB_AVX2)
+	const __m256i vRts = _mm256_set1_epi32(rts);
+	const __m256i vCeMask = _mm256_set1_epi16(kCeMask);
+	const __m256i vAtoMask = _mm256_set1_epi16(kAtoMask);
+	for (; k + 16 <= n; k += 16) {
+		__m256i w = _mm256_loadu_si256((const __m256i*)(buf + 2 * k));
+		w = _mm256_or_si256(_mm256_slli_epi16(w, 8), _mm256_srli_epi16(w, 8));
+		/*
+		* The 16 to 8 bit packing is done per 128 bit lane, the permute
+		*  moves the result to the lower 128 bits
+		*/
+		__m256i rx = _mm256_srli_epi16(w, 15);
+		__m256i ce = _mm256_and_si256(_mm256_srli_epi16(w, 13), vCeMask);
+		rx = _mm256_permute4x64_epi64(_mm256_packus_epi16(rx, rx), 0x08);
+		ce = _mm256_permute4x64_epi64(_mm256_packus_epi16(ce, ce), 0x08);
+		_mm_storeu_si128((__m128i*)(isRx + k), _mm256_castsi256_si128(rx));
+		_mm_storeu_si128((__m128i*)(ceBits + k), _mm256_castsi256_si128(ce));
+		__m256i ato = _mm256_and_si256(w, vAtoMask);
+		__m256i a0 = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(ato)), 6); // Q10->Q16
+		__m256i a1 = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(ato, 1)), 6);
+		_mm256_storeu_si256((__m256i*)(rxTime + k), _mm256_sub_epi32(vRts, a0));
+		_mm256_storeu_si256((__m256i*)(rxTime + k + 8), _mm256_sub_epi32(vRts, a1));
+	}
+#elif defined(CCFB_SSE2)
+	const __m128i vRts = _mm_set1_epi32(rts);
+	const __m128i vZero = _mm_setzero_si128();
+	const __m128i vCeMask = _mm_set1_epi16(kCeMask);
+	const __m128i vAtoMask = _mm_set1_epi16(kAtoMask);
+	for (; k + 8 <= n; k += 8) {
+		__m128i w = _mm_loadu_si128((const __m128i*)(buf + 2 * k));
+		w = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));
+		__m128i rx = _mm_srli_epi16(w, 15);
+		__m128i ce = _mm_and_si128(_mm_srli_epi16(w, 13), vCeMask);
+		_mm_storel_epi64((__m128i*)(isRx + k), _mm_packus_epi16(rx, rx));
+		_mm_storel_epi64((__m128i*)(ceBits + k), _mm_packus_epi16(ce, ce));
+		__m128i ato = _mm_and_si128(w, vAtoMask);
+		__m128i a0 = _mm_slli_epi32(_mm_unpacklo_epi16(ato, vZero), 6); // Q10->Q16
+		__m128i a1 = _mm_slli_epi32(_mm_unpackhi_epi16(ato, vZero), 6);
+		_mm_storeu_si128((__m128i*)(rxTime + k), _mm_sub_epi32(vRts, a0));
+		_mm_storeu_si128((__m128i*)(rxTime + k + 4), _mm_sub_epi32(vRts, a1));
+	}
+#elif defined(CCFB_NEON)
+	const uint32x4_t vRts = vdupq_n_u32(rts);
+	const uint16x8_t vCeMask = vdupq_n_u16(kCeMask);
+	const uint16x8_t vAtoMask = vdupq_n_u16(kAtoMask);
+	for (; k + 8 <= n; k += 8) {
+		uint16x8_t w = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(buf + 2 * k)));
+		vst1_u8(isRx + k, vmovn_u16(vshrq_n_u16(w, 15)));
+		vst1_u8(ceBits + k, vmovn_u16(vandq_u16(vshrq_n_u16(w, 13), vCeMask)));
+		uint16x8_t ato = vandq_u16(w, vAtoMask);
+		vst1q_u32(rxTime + k, vsubq_u32(vRts, vshlq_n_u32(vmovl_u16(vget_low_u16(ato)), 6))); // Q10->Q16
+		vst1q_u32(rxTime + k + 4, vsubq_u32(vRts, vshlq_n_u32(vmovl_u16(vget_high_u16(ato)), 6)));
+	}
+#endif
+	for (; k < n; k++) {
+		uint16_t tmp_s = (buf[2 * k] << 8) | buf[2 * k + 1];
+		isRx[k] = tmp_s >> 15;
+		ceBits[k] = (tmp_s >> 13) & kCeMask;
+		rxTime[k] = rts - (uint32_t(tmp_s & kAtoMask) << 6); // Q10->Q16
+	}
+}
+
+const char* CcfbCodec::getImplementationName() {
+#if defined(CCFB_AVX2)
+	return "avx2";
+#elif defined(CCFB_SSE2)
+	return "sse2";
+#elif defined(CCFB_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
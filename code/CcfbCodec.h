@@ -0,0 +1,57 @@
+#ifndef CCFB_CODEC
+#define CCFB_CODEC
+
+#include <cstdint>
+
+/*
+* Encoding and decoding of the RFC 8888 (CCFB) report blocks, i.e the
+*  16 bit report elements that follow the SSRC, begin_seq and num_reports
+*  of each stream. A report element is
+*   R(1) | ECN(2) | ATO(13)
+*  where R is the received bit and ATO is the arrival time offset in Q10
+*  relative to the report timestamp.
+* ScreamRx uses the encoder and ScreamV2Tx uses the decoder. Both process
+*  8 (SSE2, NEON) or 16 (AVX2) report elements per iteration, the
+*  instruction set is selected at compile time and the remaining elements
+*  are processed one by one. Define CCFB_SCALAR to use the scalar code only.
+* Time is in NTP domain Q16, as in the rest of SCReAM
+*/
+class CcfbCodec {
+public:
+	/*
+	* Encode n report elements for the sequence numbers sn, sn+1 ... sn+n-1
+	*  seqNrHist, rxTimeHist and ceBitsHist are the n receiver history entries
+	*  that correspond to these sequence numbers. A packet is reported as
+	*  received if the entry holds the expected sequence number and a receive
+	*  time, ATO is the time from the receive time to time_ntp and is limited
+	*  to 0x1FFE. The report elements are written to buf in network byte order,
+	*  2*n octets
+	*/
+	static void encodeReports(uint32_t time_ntp,
+		uint16_t sn,
+		const uint16_t* seqNrHist,
+		const uint32_t* rxTimeHist,
+		const uint8_t* ceBitsHist,
+		int n,
+		unsigned char* buf);
+
+	/*
+	* Decode n report elements in network byte order from buf
+	*  isRx[k] is 1 if the packet is reported received, ceBits[k] is the ECN field
+	*  and rxTime[k] is the receive time given by the report timestamp rts and
+	*  ATO. ceBits and rxTime are only meaningful if isRx[k] is 1
+	*/
+	static void decodeReports(uint32_t rts,
+		const unsigned char* buf,
+		int n,
+		uint8_t* isRx,
+		uint8_t* ceBits,
+		uint32_t* rxTime);
+
+	/*
+	* Name of the instruction set that is used, "avx2", "sse2", "neon" or "scalar"
+	*/
+	static const char* getImplementationName();
+};
+
+#endif
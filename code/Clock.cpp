@@ -0,0 +1,46 @@
+#include "Clock.h"
+#ifdef _WIN32
+#include <chrono>
+#include <thread>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+static const uint64_t kStartTime_ns = 1000000ull;
+
+#ifdef _WIN32
+static uint64_t getMonotonicTimeInNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#else
+static uint64_t getMonotonicTimeInNs() {
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+#endif
+
+RealClock::RealClock() {
+	t0_ns = getMonotonicTimeInNs() - kStartTime_ns;
+}
+
+uint64_t RealClock::getTimeInNs() {
+	return getMonotonicTimeInNs() - t0_ns;
+}
+
+void RealClock::sleepUntil(uint64_t time_ns) {
+	uint64_t wakeT_ns = t0_ns + time_ns;
+#ifdef _WIN32
+	uint64_t now_ns = getMonotonicTimeInNs();
+	if (wakeT_ns > now_ns)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(wakeT_ns - now_ns));
+#else
+	struct timespec wakeT;
+	wakeT.tv_sec = wakeT_ns / 1000000000ull;
+	wakeT.tv_nsec = wakeT_ns % 1000000000ull;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeT, NULL) == EINTR)
+		;
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+
+/*
+* Time source and sleep for the sender and receiver tools, RealClock follows
+*  the system monotonic clock and is the only implementation.
+* The event loop timers and the SO_TXTIME departure times in the sender
+*  use kernel clocks directly, and the sockets are not abstracted, so the
+*  tools cannot run on simulated time
+*/
+class Clock {
+public:
+	virtual ~Clock() {}
+
+	/*
+	* Time since the clock was created [ns], starts at 1ms as time 0
+	*  has a special meaning in a few places in ScreamTx
+	*/
+	virtual uint64_t getTimeInNs() = 0;
+
+	/*
+	* Sleep until getTimeInNs() >= time_ns
+	*/
+	virtual void sleepUntil(uint64_t time_ns) = 0;
+
+	/*
+	* Sleep for delay_us [us], replaces usleep()
+	*/
+	void sleepUs(uint32_t delay_us) {
+		sleepUntil(getTimeInNs() + delay_us * 1000ull);
+	}
+
+	/*
+	* Time in Q32, used by the high resolution packet pacing
+	*/
+	uint64_t getTimeInNtpQ32() {
+		uint64_t time_ns = getTimeInNs();
+		uint64_t sec = time_ns / 1000000000ull;
+		uint64_t ns = time_ns % 1000000000ull;
+		return (sec << 32) + (ns << 32) / 1000000000ull;
+	}
+
+	/*
+	* Time in Q16, the mid 32 bits of the Q32 time
+	*/
+	uint32_t getTimeInNtp() {
+		return uint32_t(getTimeInNtpQ32() >> 16);
+	}
+};
+
+class RealClock : public Clock {
+public:
+	RealClock();
+
+	uint64_t getTimeInNs();
+
+	void sleepUntil(uint64_t time_ns);
+
+private:
+	uint64_t t0_ns;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "EventLog.h"
+#include <iostream>
+#include <chrono>
+#ifdef EVENT_LOG_ZLIB
+#include <zlib.h>
+#endif
+using namespace std;
+
+/*
+* Binary event log
+*/
+
+/*
+* The file starts with a header record of type 0, a new header is added
+*  each time the file is appended to
+*/
+static const char* kEventLogMagic = "SCReAM event log";
+static const int kEventLogVersion = 1;
+
+/*
+* The writer thread sleeps this long when the ring buffer is empty
+*/
+static const int kWriterSleep_ms = 10;
+
+EventLog::EventLog(const char* fileName, bool append, int capacity) {
+	int n = 1;
+	while (n < capacity)
+		n *= 2;
+	records = new EventLogRecord[n];
+	mask = n - 1;
+	head = 0;
+	tail = 0;
+	nDropped = 0;
+	stopWriter = false;
+	fp = 0;
+	gz = 0;
+	writer = 0;
+
+	int len = strlen(fileName);
+	if (len > 3 && strcmp(fileName + len - 3, ".gz") == 0) {
+#ifdef EVENT_LOG_ZLIB
+		gz = gzopen(fileName, append ? "ab" : "wb");
+#else
+		cerr << "EventLog: built without zlib, " << fileName << " is not compressed" << endl;
+		fp = fopen(fileName, append ? "ab" : "wb");
+#endif
+	}
+	else {
+		fp = fopen(fileName, append ? "ab" : "wb");
+	}
+	if (!isOpen()) {
+		cerr << "EventLog: could not open " << fileName << endl;
+		return;
+	}
+
+	EventLogRecord header;
+	memset(&header, 0, sizeof(header));
+	header.type = 0;
+	header.seqNr = kEventLogVersion;
+	strcpy(header.timeString, kEventLogMagic);
+	write(&header, sizeof(header));
+
+	writer = new std::thread(&EventLog::run, this);
+}
+
+EventLog::~EventLog() {
+	if (writer) {
+		stopWriter = true;
+		writer->join();
+		delete writer;
+	}
+	if (fp)
+		fclose(fp);
+#ifdef EVENT_LOG_ZLIB
+	if (gz)
+		gzclose((gzFile)gz);
+#endif
+	delete[] records;
+}
+
+void EventLog::write(const void* data, int size) {
+	if (fp)
+		fwrite(data, 1, size, fp);
+#ifdef EVENT_LOG_ZLIB
+	if (gz)
+		gzwrite((gzFile)gz, data, size);
+#endif
+}
+
+/*
+* Writer thread, the records between tail and head are written directly from
+*  the ring buffer, at most two writes are needed when the ring wraps around
+*/
+void EventLog::run() {
+	for (;;) {
+		bool isStop = stopWriter;
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		uint32_t h = head.load(std::memory_order_acquire);
+		while (t != h) {
+			uint32_t ix = t & mask;
+			uint32_t n = std::min(h - t, mask + 1 - ix);
+			write(&records[ix], n * sizeof(EventLogRecord));
+			t += n;
+			tail.store(t, std::memory_order_release);
+		}
+		if (isStop)
+			return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(kWriterSleep_ms));
+	}
+}
+
+void* EventLog::openFile(const char* fileName) {
+#ifdef EVENT_LOG_ZLIB
+	/*
+	* gzread reads uncompressed files as well
+	*/
+	return gzopen(fileName, "rb");
+#else
+	return fopen(fileName, "rb");
+#endif
+}
+
+void EventLog::closeFile(void* file) {
+#ifdef EVENT_LOG_ZLIB
+	gzclose((gzFile)file);
+#else
+	fclose((FILE*)file);
+#endif
+}
+
+bool EventLog::readRecord(void* file, EventLogRecord& record) {
+	for (;;) {
+#ifdef EVENT_LOG_ZLIB
+		int n = gzread((gzFile)file, &record, sizeof(record));
+#else
+		int n = fread(&record, 1, sizeof(record), (FILE*)file);
+#endif
+		if (n != sizeof(record))
+			return false;
+		if (record.type != 0)
+			return true;
+		/*
+		* Header record
+		*/
+		if (strcmp(record.timeString, kEventLogMagic) != 0 || record.seqNr != kEventLogVersion) {
+			cerr << "EventLog: not a SCReAM event log or unsupported version" << endl;
+			return false;
+		}
+	}
+}
+
+void EventLog::formatRecord(const EventLogRecord& record, const char* extraData, char* s) {
+	const float ntp2SecScaleFactor = 1.0f / 65536;
+	const EventLogDetailed& d = record.u.detailed;
+	const EventLogTxRx& t = record.u.txRx;
+	s[0] = 0;
+	switch (record.type) {
+	case kEventLogDetailed:
+		/*
+		* Same format as ScreamV2Tx::markAcked and ScreamV2Tx::logFeedback
+		*/
+		s += sprintf(s, "%s,%1.4f,%1.4f,", record.timeString, d.queueDelay, d.rtt);
+		s += sprintf(s, " %d,%d,%d,%1.0f,%d,%d,%d,%d,%1.0f,%1.0f,%1.0f,%1.0f,%1.0f,%d,%1.0f,%3.3f, %d",
+			d.cwnd, d.bytesInFlight, 0, d.rateTransmittedAvg, d.streamId, record.seqNr, d.bytesNewlyAcked, d.ecnCeMarkedBytes,
+			d.rateRtp, d.rateTransmitted, d.rateAcked, d.rateLost, d.rateCe,
+			record.isMark, d.targetBitrate, d.rtpQueueDelay, d.cwndI);
+		if (strlen(extraData) > 0)
+			s += sprintf(s, ",%s", extraData);
+		sprintf(s, "\n");
+		break;
+	case kEventLogTxRx:
+		sprintf(s, "%s, %d, %d.%04d, %d.%04d, %d.%04d\n", record.timeString, record.seqNr,
+			t.timeTx_ntp >> 16,
+			uint32_t((t.timeTx_ntp & 0xFFFF) * ntp2SecScaleFactor * 10000 + 0.5),
+			t.timeRx_ntp >> 16,
+			uint32_t((t.timeRx_ntp & 0xFFFF) * ntp2SecScaleFactor * 10000 + 0.5),
+			t.owd_ntp >> 16,
+			uint32_t((t.owd_ntp & 0xFFFF) * ntp2SecScaleFactor * 10000 + 0.5));
+		break;
+	case kEventLogTxRxLost:
+		sprintf(s, "%s, %d, %d.%04d, -1.0, -1.0\n", record.timeString, record.seqNr,
+			t.timeTx_ntp >> 16,
+			uint32_t((t.timeTx_ntp & 0xFFFF) * ntp2SecScaleFactor * 10000 + 0.5));
+		break;
+	}
+}
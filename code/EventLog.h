@@ -0,0 +1,166 @@
+#ifndef EVENT_LOG
+#define EVENT_LOG
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <thread>
+
+/*
+* Binary event log, an alternative to the detailed per-ACK log and the
+*  TX/RX log that ScreamV2Tx writes with fprintf.
+* ScreamV2Tx pushes fixed size records to a lock free ring buffer, push()
+*  never blocks and records are dropped if the ring is full. A background
+*  thread drains the ring to file. The file is gzip compressed if the file
+*  name ends with .gz and the code is built with EVENT_LOG_ZLIB.
+* push() may be called from different threads but not concurrently, this is
+*  the case as the application serializes the calls to ScreamV2Tx.
+* scream_log_convert converts the binary file to the same CSV format as
+*  the -log and -txrxlog options of scream_bw_test_tx
+*/
+
+/*
+* Record types
+*/
+const uint8_t kEventLogDetailed = 1;  // Detailed log item for an ACKed packet
+const uint8_t kEventLogTxRx = 2;      // TX and RX time of an ACKed packet
+const uint8_t kEventLogTxRxLost = 3;  // TX time of a lost packet
+const uint8_t kEventLogExtraData = 4; // Part of the extra data that is appended to the detailed log items
+
+const int kEventLogTimeStringSize = 28;
+const int kEventLogExtraDataSize = 64;
+
+struct EventLogDetailed {
+	float queueDelay;
+	float rtt;
+	int cwnd;
+	int bytesInFlight;
+	float rateTransmittedAvg;
+	int streamId;
+	int bytesNewlyAcked;
+	int ecnCeMarkedBytes;
+	float rateRtp;
+	float rateTransmitted;
+	float rateAcked;
+	float rateLost;
+	float rateCe;
+	float targetBitrate;
+	float rtpQueueDelay;
+	int cwndI;
+};
+
+struct EventLogTxRx {
+	uint32_t timeTx_ntp;
+	uint32_t timeRx_ntp;
+	uint32_t owd_ntp;
+};
+
+/*
+* A record is 96 bytes
+*/
+struct EventLogRecord {
+	uint8_t type;
+	uint8_t isMark;
+	uint16_t seqNr;
+	char timeString[kEventLogTimeStringSize];
+	union {
+		EventLogDetailed detailed;
+		EventLogTxRx txRx;
+		/*
+		* The extra data is split in several records, the first
+		*  record has seqNr = 0 and the following 1, 2 ...
+		*/
+		char extraData[kEventLogExtraDataSize];
+	} u;
+};
+
+/*
+* Default ring buffer size [records]
+*/
+const int kEventLogSize = 16384;
+
+class EventLog {
+public:
+	/*
+	* Open fileName for writing, append = true appends to an existing file.
+	* capacity is the ring buffer size [records], rounded up to a power of two
+	*/
+	EventLog(const char* fileName, bool append = false, int capacity = kEventLogSize);
+	/*
+	* The remaining records are written before the file is closed
+	*/
+	~EventLog();
+
+	bool isOpen() { return fp != 0 || gz != 0; }
+
+	/*
+	* Add a record, false is returned and the record is dropped if the ring is full
+	*/
+	bool push(const EventLogRecord& record) {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) > mask) {
+			nDropped++;
+			return false;
+		}
+		records[h & mask] = record;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	* Add n records, either all of them or none are added. false is returned
+	*  and the records are dropped if the ring does not have room for all of them
+	*/
+	bool push(const EventLogRecord* records_, int n) {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) + n > mask + 1) {
+			nDropped += n;
+			return false;
+		}
+		for (int i = 0; i < n; i++)
+			records[(h + i) & mask] = records_[i];
+		head.store(h + n, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	* Number of records that are dropped because the ring was full
+	*/
+	int getDroppedCount() { return nDropped; }
+
+	/*
+	* Read the next record from a binary log file that is opened with openFile()
+	*  false is returned at the end of the file
+	*/
+	static void* openFile(const char* fileName);
+	static bool readRecord(void* file, EventLogRecord& record);
+	static void closeFile(void* file);
+
+	/*
+	* Format a record as a line in the detailed log (kEventLogDetailed) or
+	*  TX/RX log (kEventLogTxRx, kEventLogTxRxLost), extraData is appended to
+	*  detailed log items if it is not empty
+	*/
+	static void formatRecord(const EventLogRecord& record, const char* extraData, char* s);
+
+private:
+	void run();
+	void write(const void* data, int size);
+
+	EventLogRecord* records; // Ring buffer with inline records
+	uint32_t mask;
+	FILE* fp;
+	void* gz;
+	std::thread* writer;
+	std::atomic<bool> stopWriter;
+	std::atomic<int> nDropped;
+
+	char pad0[64];
+	std::atomic<uint32_t> head; // Number of pushed records, written by ScreamV2Tx
+	char pad1[64];
+	std::atomic<uint32_t> tail; // Number of written records, written by the writer thread
+	char pad2[64];
+};
+
+#endif
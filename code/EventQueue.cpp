@@ -0,0 +1,75 @@
+#include "EventQueue.h"
+
+/*
+* Implements a simple discrete event queue
+*/
+
+EventQueue::EventQueue(int nSources) {
+	generation.assign(nSources, 0);
+	scheduledN.assign(nSources, 0);
+	pending.assign(nSources, false);
+	popped.assign(nSources, false);
+	nEvents = 0;
+}
+
+void EventQueue::schedule(int source, uint64_t n) {
+	if (pending[source] && scheduledN[source] == n) {
+		/*
+		* Already scheduled at this time
+		*/
+		return;
+	}
+	generation[source]++;
+	scheduledN[source] = n;
+	pending[source] = true;
+	Event event = { n, source, generation[source] };
+	events.push(event);
+}
+
+void EventQueue::cancel(int source) {
+	/*
+	* Bump the generation, the old event becomes stale
+	*/
+	generation[source]++;
+	pending[source] = false;
+}
+
+bool EventQueue::isScheduled(int source) {
+	return pending[source];
+}
+
+void EventQueue::purge() {
+	while (!events.empty()) {
+		const Event& event = events.top();
+		if (pending[event.source] && event.generation == generation[event.source])
+			return;
+		events.pop();
+	}
+}
+
+bool EventQueue::peek(uint64_t& n) {
+	purge();
+	if (events.empty())
+		return false;
+	n = events.top().n;
+	return true;
+}
+
+int EventQueue::popAll(uint64_t n) {
+	int nPopped = 0;
+	for (int k = 0; k < int(poppedSources.size()); k++)
+		popped[poppedSources[k]] = false;
+	poppedSources.clear();
+	purge();
+	while (!events.empty() && events.top().n == n) {
+		int source = events.top().source;
+		events.pop();
+		pending[source] = false;
+		popped[source] = true;
+		poppedSources.push_back(source);
+		nPopped++;
+		nEvents++;
+		purge();
+	}
+	return nPopped;
+}
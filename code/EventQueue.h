@@ -0,0 +1,84 @@
+#ifndef EVENT_QUEUE
+#define EVENT_QUEUE
+
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+/*
+* Implements a simple discrete event queue for the simulator.
+* Time is expressed in Q16 ticks (1.0s = 65536), i.e the same
+*  time base as the NTP time used by SCReAM.
+* Each event source (frame timer, pace timer, network queues, feedback...)
+*  has at most one pending event. A new call to schedule() for the same
+*  source replaces the earlier event, stale events are silently
+*  dropped when they reach the head of the queue.
+*/
+class EventQueue {
+public:
+	EventQueue(int nSources);
+
+	/*
+	* Schedule an event for the given source at time n [Q16 ticks]
+	* An already pending event for this source is replaced
+	*/
+	void schedule(int source, uint64_t n);
+
+	/*
+	* Cancel the pending event for the given source, if any
+	*/
+	void cancel(int source);
+
+	/*
+	* Return true if the given source has a pending event
+	*/
+	bool isScheduled(int source);
+
+	/*
+	* Get the time of the next pending event, the event is not removed
+	* Return false if the queue is empty
+	*/
+	bool peek(uint64_t& n);
+
+	/*
+	* Remove all pending events at time n, isPopped() tells which sources
+	*  they belong to until the next call.
+	* Return the number of removed events
+	*/
+	int popAll(uint64_t n);
+
+	/*
+	* Return true if an event for the given source was removed by the last popAll()
+	*/
+	bool isPopped(int source) { return popped[source]; };
+
+	/*
+	* Number of events processed so far
+	*/
+	uint64_t getNumberOfEvents() { return nEvents; };
+
+private:
+	struct Event {
+		uint64_t n;
+		int source;
+		uint32_t generation;
+		bool operator>(const Event& other) const {
+			return n > other.n || (n == other.n && source > other.source);
+		}
+	};
+
+	/*
+	* Drop stale events at the head of the queue
+	*/
+	void purge();
+
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+	std::vector<uint32_t> generation;
+	std::vector<uint64_t> scheduledN;
+	std::vector<bool> pending;
+	std::vector<bool> popped;
+	std::vector<int> poppedSources; // Sources with popped[] set
+	uint64_t nEvents;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "LatencyHistogram.h"
+#include <cstring>
+#include <cmath>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+* Index of the most significant set bit, value must be > 0
+*/
+static int msb(uint32_t value) {
+#ifdef _MSC_VER
+	unsigned long ix;
+	_BitScanReverse(&ix, value);
+	return int(ix);
+#else
+	return 31 - __builtin_clz(value);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+	clear();
+}
+
+void LatencyHistogram::clear() {
+	memset(counts, 0, sizeof(counts));
+	count = 0;
+	min_us = UINT32_MAX;
+	max_us = 0;
+	sum_us = 0.0;
+}
+
+int LatencyHistogram::getIx(uint32_t value_us) {
+	if (value_us < uint32_t(kSubBuckets))
+		return value_us;
+	if (value_us >= (1u << kMaxBits))
+		return kSize - 1;
+	int e = msb(value_us);
+	return ((e - kSubBucketBits + 1) << kSubBucketBits) + int(value_us >> (e - kSubBucketBits)) - kSubBuckets;
+}
+
+uint32_t LatencyHistogram::getMidValue(int ix) {
+	if (ix < kSubBuckets)
+		return ix;
+	int shift = (ix >> kSubBucketBits) - 1;
+	uint32_t low = uint32_t(kSubBuckets + (ix & (kSubBuckets - 1))) << shift;
+	return low + ((1u << shift) >> 1);
+}
+
+void LatencyHistogram::add(float value) {
+	uint32_t value_us = 0;
+	if (value > 0.0f)
+		value_us = value < 4000.0f ? uint32_t(value * 1e6f + 0.5f) : UINT32_MAX;
+	counts[getIx(value_us)]++;
+	count++;
+	if (value_us < min_us)
+		min_us = value_us;
+	if (value_us > max_us)
+		max_us = value_us;
+	sum_us += value_us;
+}
+
+float LatencyHistogram::getPercentile(float percentile) {
+	if (count == 0)
+		return 0.0f;
+	uint32_t rank = uint32_t(ceil(percentile / 100.0 * count));
+	if (rank < 1)
+		rank = 1;
+	uint32_t acc = 0;
+	for (int ix = 0; ix < kSize; ix++) {
+		acc += counts[ix];
+		if (acc >= rank) {
+			/*
+			* The mid value of the bucket is limited to the exact min and max
+			*/
+			uint32_t value_us = getMidValue(ix);
+			if (value_us < min_us)
+				value_us = min_us;
+			if (value_us > max_us)
+				value_us = max_us;
+			return value_us * 1e-6f;
+		}
+	}
+	return max_us * 1e-6f;
+}
+
+float LatencyHistogram::getMin() {
+	return count == 0 ? 0.0f : min_us * 1e-6f;
+}
+
+float LatencyHistogram::getMax() {
+	return max_us * 1e-6f;
+}
+
+float LatencyHistogram::getMean() {
+	return count == 0 ? 0.0f : float(sum_us / count * 1e-6);
+}
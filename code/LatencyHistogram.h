@@ -0,0 +1,55 @@
+#ifndef LATENCY_HISTOGRAM
+#define LATENCY_HISTOGRAM
+
+#include <cstdint>
+
+/*
+* Constant memory histogram of latency values with log bucketed resolution,
+*  similar to HDR histograms.
+* Values are counted in microseconds. Values below 64us have one bucket each,
+*  above that each power of two range is split in 64 linear buckets, this gives
+*  a relative error of at most 1/128 (0.8%) as the bucket mid points are reported.
+* Values up to 2^27us (~134s) are resolved, larger values are counted in the
+*  last bucket. The exact min, max and mean are kept as well.
+* add() is O(1), getPercentile() walks the buckets
+*/
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	/*
+	* Add a value [s], negative values are counted as 0
+	*/
+	void add(float value);
+
+	void clear();
+
+	uint32_t getCount() { return count; }
+
+	/*
+	* Get the value [s] at percentile [0..100], e.g 99.9
+	*  0 is returned if the histogram is empty
+	*/
+	float getPercentile(float percentile);
+
+	float getMin();  // [s]
+	float getMax();  // [s]
+	float getMean(); // [s]
+
+private:
+	static const int kSubBucketBits = 6;
+	static const int kSubBuckets = 1 << kSubBucketBits;
+	static const int kMaxBits = 27;
+	static const int kSize = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+	static int getIx(uint32_t value_us);
+	static uint32_t getMidValue(int ix);
+
+	uint32_t counts[kSize];
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t max_us;
+	double sum_us;
+};
+
+#endif
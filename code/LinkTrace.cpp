@@ -0,0 +1,104 @@
+#include "LinkTrace.h"
+#include <stdlib.h>
+#include <iostream>
+
+using namespace std;
+
+/*
+* Implements a streamed link capacity trace
+*/
+
+static const double kRateWindow = 0.1; // Window for the capacity estimate [s]
+static const double kInitialRateWindowMs = 1000.0;
+
+LinkTrace::LinkTrace(const char* fname, int bytesPerOpportunity_) {
+	bytesPerOpportunity = bytesPerOpportunity_;
+	hasNext = false;
+	tNext = 0.0;
+	offset = 0.0;
+	lastTs = 0.0;
+	isEmptyPass = true;
+	bytesOffered = 0.0;
+	rate = 0.0f;
+	windowStart = 0.0;
+	windowBytes = 0.0;
+	fp = fopen(fname, "r");
+	if (fp == 0) {
+		cerr << "Cannot open link trace " << fname << endl;
+		return;
+	}
+
+	/*
+	* The initial capacity estimate is given by the first second of the trace
+	*/
+	int n = 0;
+	double span = kInitialRateWindowMs;
+	char s[100];
+	bool isEof = true;
+	while (fgets(s, sizeof(s), fp)) {
+		char* end;
+		double ts = strtod(s, &end);
+		if (end == s)
+			continue;
+		if (ts >= kInitialRateWindowMs) {
+			isEof = false;
+			break;
+		}
+		lastTs = ts;
+		n++;
+	}
+	if (isEof)
+		span = lastTs;
+	if (span > 0.0)
+		rate = float(n * bytesPerOpportunity * 8 / (span * 1e-3));
+	rewind(fp);
+	lastTs = 0.0;
+
+	hasNext = readNext();
+	if (!hasNext)
+		cerr << "Link trace " << fname << " contains no delivery opportunities" << endl;
+}
+
+LinkTrace::~LinkTrace() {
+	if (fp)
+		fclose(fp);
+}
+
+bool LinkTrace::readNext() {
+	char s[100];
+	while (true) {
+		while (fgets(s, sizeof(s), fp)) {
+			char* end;
+			double ts = strtod(s, &end);
+			if (end == s)
+				continue;
+			lastTs = ts;
+			isEmptyPass = false;
+			tNext = (offset + ts) * 1e-3;
+			return true;
+		}
+		/*
+		* End of file, the trace repeats with a period equal to
+		*  the last timestamp. A file without timestamps or with
+		*  a zero period would repeat forever
+		*/
+		if (isEmptyPass || lastTs <= 0.0)
+			return false;
+		offset += lastTs;
+		isEmptyPass = true;
+		rewind(fp);
+	}
+}
+
+void LinkTrace::pop() {
+	if (!hasNext)
+		return;
+	bytesOffered += bytesPerOpportunity;
+	if (tNext - windowStart >= kRateWindow) {
+		rate = float(windowBytes * 8 / (tNext - windowStart));
+		windowStart = tNext;
+		windowBytes = 0.0;
+	}
+	windowBytes += bytesPerOpportunity;
+	hasNext = readNext();
+}
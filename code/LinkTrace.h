@@ -0,0 +1,65 @@
+#ifndef LINK_TRACE
+#define LINK_TRACE
+
+#include <cstdio>
+
+/*
+* Link capacity trace in the Mahimahi format, i.e one line per packet
+*  delivery opportunity with the time in milliseconds. Each opportunity
+*  can deliver bytesPerOpportunity bytes, several lines with the same
+*  time give several opportunities. The trace repeats when the end is
+*  reached, with a period equal to the last timestamp.
+* The file is streamed, only the next opportunity is kept in memory.
+* Time is in seconds from the start of the trace
+*/
+class LinkTrace {
+public:
+	LinkTrace(const char* fname, int bytesPerOpportunity = 1500);
+	~LinkTrace();
+
+	/*
+	* Return false if the file could not be opened or has no opportunities
+	*/
+	bool isOpen() { return hasNext; };
+
+	/*
+	* Time [s] of the next delivery opportunity, -1.0 if there is none
+	*/
+	double peek() { return hasNext ? tNext : -1.0; };
+
+	/*
+	* Consume the next delivery opportunity
+	*/
+	void pop();
+
+	/*
+	* Capacity [bps] over the latest window of consumed opportunities
+	*/
+	float getRate() { return rate; };
+
+	/*
+	* Total number of bytes of the consumed opportunities
+	*/
+	double getBytesOffered() { return bytesOffered; };
+
+	int bytesPerOpportunity;
+
+private:
+	/*
+	* Read the next timestamp, wrap around at the end of the file
+	*/
+	bool readNext();
+
+	FILE* fp;
+	bool hasNext;
+	double tNext;
+	double offset; // Added to the timestamps in the file [ms]
+	double lastTs; // Last timestamp read from the file [ms]
+	bool isEmptyPass; // No timestamp read since the last wrap around
+	double bytesOffered;
+	float rate;
+	double windowStart;
+	double windowBytes;
+};
+
+#endif
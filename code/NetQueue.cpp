@@ -1,4 +1,6 @@
 #include "NetQueue.h"
+#include "NetQueueAqm.h"
+#include "LinkTrace.h"
 #include <iostream>
 #include <string.h>
 #include <stdio.h>
@@ -10,25 +12,65 @@ using namespace std;
  * Implements a simple RTP packet queue
  */
 
-const float l4sThLo = 0.008f;
-const float l4sThHi = 0.012f;
 NetQueueItem::NetQueueItem() {
 	packet = 0;
-	used = false;
+	ssrc = 0;
 	size = 0;
 	seqNr = 0;
 	timeStamp = 0;
 	tRelease = 0.0;
     tQueue = 0.0;
+	ecn = 0x00;
+	isCe = false;
+	isMark = false;
 }
 
-NetQueue::NetQueue(float delay_, float rate_, float jitter_, bool isL4s_) {
-	for (int n=0; n < NetQueueSize; n++) {
-		items[n] = new NetQueueItem();
-	}
+NetQueueFifo::NetQueueFifo(int capacity) {
+	items.resize(capacity);
 	head = -1;
 	tail = 0;
 	nItems = 0;
+	bytesInQueue = 0;
+}
+
+NetQueueItem* NetQueueFifo::push() {
+	if (nItems == int(items.size())) {
+		grow();
+	}
+	nItems++;
+	head++; if (head == int(items.size())) head = 0;
+	return &items[head];
+}
+
+void NetQueueFifo::pop() {
+	bytesInQueue -= items[tail].size;
+	tail++; if (tail == int(items.size())) tail = 0;
+	nItems--;
+}
+
+void NetQueueFifo::grow() {
+	/*
+	* Unwrap the ring buffer into a buffer with twice the capacity
+	*/
+	std::vector<NetQueueItem> tmp(items.size() * 2);
+	for (int n = 0; n < nItems; n++) {
+		tmp[n] = items[(tail + n) % items.size()];
+	}
+	items.swap(tmp);
+	tail = 0;
+	head = nItems - 1;
+}
+
+NetQueue::NetQueue(float delay_, float rate_, float jitter_, bool isL4s_) {
+	aqm = 0;
+	linkTrace = 0;
+	nItems = 0;
+	bytesInQueue = 0;
+	nDropped = 0;
+	nMarked = 0;
+	maxBytes = 0;
+	lastQueueDelay = 0.0f;
+	rngState = 1;
 	rate = rate_;
 	delay = delay_;
 	jitter = jitter_;
@@ -43,59 +85,118 @@ NetQueue::NetQueue(float delay_, float rate_, float jitter_, bool isL4s_) {
 	tQueueAvg = 0.0;
 	bytes = 0.0;
 	tLastAddBytes = 0.0;
+	if (isL4s)
+		setAqm(new RampAqm());
+	else
+		setAqm(new StepAqm());
+}
+
+NetQueue::~NetQueue() {
+	delete aqm;
+	delete linkTrace;
+}
+
+void NetQueue::setLinkTrace(LinkTrace* linkTrace_) {
+	delete linkTrace;
+	linkTrace = linkTrace_;
+	if (linkTrace)
+		rate = linkTrace->getRate();
+}
+
+void NetQueue::setSeed(unsigned int seed) {
+	rngState = seed;
+	if (aqm)
+		aqm->setSeed(seed ^ 0x5bd1e995u);
+}
+
+float NetQueue::random() {
+	rngState = rngState * 1664525u + 1013904223u;
+	return (rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+void NetQueue::setAqm(NetQueueAqm* aqm_) {
+	if (nItems > 0) {
+		cerr << "NetQueue::setAqm, queue is not empty" << endl;
+		return;
+	}
+	delete aqm;
+	aqm = aqm_;
+	if (aqm)
+		aqm->setSeed(rngState ^ 0x5bd1e995u);
+	fifos.clear();
+	if (aqm)
+		fifos.resize(aqm->getNumberOfFifos(), NetQueueFifo(aqm->getFifoCapacity()));
+	else
+		fifos.resize(1);
+}
 
+int NetQueue::nextFifo(float time) {
+	if (aqm)
+		return aqm->select(time, this);
+	return 0;
 }
 
-float pMarkList[] = {0.0,0.5000,1.0000,1.5000,2.0000,5.0000,10.0000,20.0000,30.0000,40.0000,50.0000 };
-float markCarry = 0.0f;
-void NetQueue::insert(float time,
+bool NetQueue::insert(float time,
 	void* rtpPacket,
 	unsigned int ssrc,
 	int size,
 	unsigned short seqNr,
 	bool isCe,
 	bool isMark,
-	unsigned int timeStamp) {
-	int prevHead = head;
-	if (false && nItems > 1000)
-		return;
-	nItems++;
-	head++; if (head == NetQueueSize) head = 0;
-	items[head]->used = true;
-	items[head]->packet = rtpPacket;
-	items[head]->ssrc = ssrc;
-	items[head]->size = size;
-	items[head]->seqNr = seqNr;
-	items[head]->timeStamp = timeStamp;
+	unsigned int timeStamp,
+	unsigned char ecn) {
+	if (maxBytes > 0 && bytesInQueue + size > maxBytes && isRateLimited()) {
+		/*
+		* Tail drop, the buffer is full
+		*/
+		nDropped++;
+		return false;
+	}
+	if (nItems == 0) {
+		/*
+		* Queue was empty, the link capacity is accumulated
+		* from the time this packet arrives
+		*/
+		tLastAddBytes = time;
+		bytes = 0.0;
+		if (linkTrace) {
+			/*
+			* Delivery opportunities while the queue was empty are lost
+			*/
+			while (linkTrace->isOpen() && linkTrace->peek() < time)
+				linkTrace->pop();
+		}
+	}
+	NetQueueItem item;
+	item.packet = rtpPacket;
+	item.ssrc = ssrc;
+	item.size = size;
+	item.seqNr = seqNr;
+	item.timeStamp = timeStamp;
+	item.tQueue = time;
+	item.ecn = ecn;
+	item.isMark = isMark;
+	int fifo = 0;
+	if (aqm) {
+		fifo = aqm->classify(item);
+		if (isRateLimited() && !aqm->enqueue(time, fifo, item, this)) {
+			nDropped++;
+			return false;
+		}
+		if (item.isCe)
+			nMarked++;
+	}
 	float tmp = 0;
 	if (rate > 0)
 		tmp += size * 8 / rate;
 	sendTime = std::max(sendTime, time) + tmp;	
-	items[head]->tRelease = sendTime + delay + jitter * (rand() / float(RAND_MAX));;
-	items[head]->tQueue = time;
-	/*
-	if (rate > 0) {
-		float qDelay = items[tail]->tRelease - items[tail]->tQueue;
-		if (isL4s) {
-			int ix = int(time / 60.0f);
-			//float pMark = pMarkList[ix] / 100.0;
-			float pMark = std::max(0.0f, std::min(1.0f, (qDelay - l4sThLo) / (l4sThHi - l4sThLo)));
-			markCarry += pMark;
-			//if (markCarry >= 1.0f) {
-			if ((rand() % 1000) / 1000.0 < pMark) {
-				markCarry -= 1.0f;
-				isCe = true;
-			}
-		} else {
-			if (qDelay > 0.03) {
-				isCe = true;
-			}
-		}
-	}
-	*/
-
-	//items[head]->isCe = isCe;
-	items[head]->isMark = isMark;
+	item.tRelease = sendTime + delay + jitter * random();
+	NetQueueFifo& f = fifos[fifo];
+	*f.push() = item;
+	f.bytesInQueue += size;
+	nItems++;
+	bytesInQueue += size;
+	return true;
 }
 
 bool NetQueue::extract(float time,
@@ -106,48 +207,55 @@ bool NetQueue::extract(float time,
 	bool& isCe,
 	bool& isMark,
 	unsigned int& timeStamp) {
-	if (items[tail]->used == false) {
+	if (nItems == 0) {
 		lastQueueLow = time;
 		bytes = 0.0;
 		return false;
 	}
 	else {
-		if (time >= items[tail]->tRelease || rate > 0.0) {
-		//	items[tail]->tReleaseExt = time;
-			rtpPacket = items[tail]->packet;
-			seqNr = items[tail]->seqNr;
-			timeStamp = items[tail]->timeStamp;
-			ssrc = items[tail]->ssrc;
-			size = items[tail]->size;
-			//isCe = items[tail]->isCe;
-			isMark = items[tail]->isMark;
-
-			if (rate > 0) {
-				float qDelay = items[tail]->tRelease - items[tail]->tQueue;
-				if (isL4s) {
-					int ix = int(time / 60.0f);
-					//float pMark = pMarkList[ix] / 100.0;
-					float pMark = std::max(0.0f, std::min(1.0f, (qDelay - l4sThLo) / (l4sThHi - l4sThLo)));
-					markCarry += pMark;
-					//if (markCarry >= 1.0f) {
-					if ((rand() % 1000) / 1000.0 < pMark) {
-						markCarry -= 1.0f;
-						isCe = true;
-					}
-				}
-				else {
-					if (qDelay > 0.03) {
-						isCe = true;
-					}
+		int fifo = nextFifo(time);
+		NetQueueFifo& f = fifos[fifo];
+		if (time >= f.front().tRelease || isRateLimited()) {
+			NetQueueItem item = f.front();
+			f.pop();
+			nItems--;
+			bytesInQueue -= item.size;
+		//	item->tReleaseExt = time;
+			rtpPacket = item.packet;
+			seqNr = item.seqNr;
+			timeStamp = item.timeStamp;
+			ssrc = item.ssrc;
+			size = item.size;
+			isMark = item.isMark;
+			isCe = item.isCe;
+			/*
+			* The packet left the queue when its transmission started,
+			*  the queue delay does not include its own serialization time
+			*/
+			float tDequeue = time;
+			if (rate > 0)
+				tDequeue = std::max(item.tQueue, time - item.size * 8 / rate);
+			lastQueueDelay = tDequeue - item.tQueue;
+
+			if (isRateLimited() && aqm) {
+				switch (aqm->dequeue(tDequeue, fifo, item, this)) {
+				case kAqmMark:
+					isCe = true;
+					nMarked++;
+					break;
+				case kAqmDrop:
+					/*
+					* Dropped packets do not consume link capacity
+					*/
+					nDropped++;
+					bytes += size;
+					return false;
+				default:
+					break;
 				}
 			}
 
-			items[tail]->used = false;
-
 			bytesTx += size;
-			tail++; if (tail == NetQueueSize) tail = 0;
-			nItems = std::max(0, nItems - 1);
-
 			return true;
 		}
 		return false;
@@ -155,7 +263,19 @@ bool NetQueue::extract(float time,
 }
 
 void NetQueue::addBytes(float time) {
-	if (sizeOfQueue() > 0) {
+	if (linkTrace) {
+		/*
+		* Each delivery opportunity up to this time adds a fixed
+		*  number of bytes, the rate is the estimated capacity
+		*/
+		while (linkTrace->isOpen() && linkTrace->peek() <= time) {
+			if (sizeOfQueue() > 0)
+				bytes += linkTrace->bytesPerOpportunity;
+			linkTrace->pop();
+		}
+		rate = linkTrace->getRate();
+	}
+	else if (sizeOfQueue() > 0) {
 		bytes += (time - tLastAddBytes) * rate / 8.0;
 	}
 	else {
@@ -166,9 +286,10 @@ void NetQueue::addBytes(float time) {
 }
 
 bool NetQueue::canExtract() {
-	if (sizeOfQueue() > 0) {
-		if (items[tail]->size <= bytes) {
-			bytes -= items[tail]->size;
+	if (nItems > 0) {
+		NetQueueItem& item = fifos[nextFifo(tLastAddBytes)].front();
+		if (item.size <= bytes) {
+			bytes -= item.size;
 			return true;
 		}
 		else {
@@ -181,13 +302,26 @@ bool NetQueue::canExtract() {
 	}
 }
 
-int NetQueue::sizeOfQueue() {
-	int size = 0;
-	for (int n=0; n < NetQueueSize; n++) {
-		if (items[n]->used)  
-			size += items[n]->size;
+float NetQueue::nextReleaseTime() {
+	if (nItems == 0)
+		return -1.0f;
+	NetQueueItem& item = fifos[nextFifo(tLastAddBytes)].front();
+	if (linkTrace) {
+		/*
+		* Trace driven, the next item is released at the next delivery opportunity
+		*/
+		if (item.size <= bytes)
+			return tLastAddBytes;
+		return float(linkTrace->peek());
+	}
+	if (rate > 0) {
+		/*
+		* Rate limited, the next item is released when enough bytes
+		* are accumulated
+		*/
+		return tLastAddBytes + std::max(0.0f, item.size - bytes) * 8 / rate;
 	}
-	return size;
+	return item.tRelease;
 }
 
 const float rateUpdateT = 0.05f;
@@ -1,6 +1,10 @@
 #ifndef NET_QUEUE
 #define NET_QUEUE
 
+#include <vector>
+
+class NetQueueAqm;
+class LinkTrace;
 
 class NetQueueItem {
 public:
@@ -13,33 +17,95 @@ public:
     float tRelease;
 //    float tReleaseExt;
     float tQueue;
+    unsigned char ecn; // ECN bits of the IP header, 0x01 = ECT(1), 0x02 = ECT(0)
     bool isCe;
     bool isMark;
-    bool used;
 };
-const int NetQueueSize = 10000;
+/*
+* Initial number of items in the queue, the queue
+* capacity is doubled when it becomes full
+*/
+const int NetQueueSize = 1024;
+
+/*
+* FIFO ring buffer with inline items
+*/
+class NetQueueFifo {
+public:
+    NetQueueFifo(int capacity = NetQueueSize);
+
+    /*
+    * Append an item, the capacity is doubled if the FIFO is full
+    */
+    NetQueueItem* push();
+
+    /*
+    * Remove the oldest item
+    */
+    void pop();
+
+    /*
+    * The oldest item
+    */
+    NetQueueItem& front() { return items[tail]; };
+
+    bool isEmpty() { return nItems == 0; };
+
+    /*
+    * Double the capacity, items are kept in order
+    */
+    void grow();
+
+    std::vector<NetQueueItem> items; // Ring buffer with inline items
+    int head; // Pointer to last inserted item
+    int tail; // Pointer to the oldest item
+    int nItems;
+    int bytesInQueue;
+};
+
 class NetQueue {
 public:
 
     NetQueue(float delay, float rate=0.0f, float jitter=0.0f, bool isL4s = false);
+    ~NetQueue();
 
-    void insert(float time,
+    /*
+    * Insert a packet, ecn is the ECN codepoint that the AQM uses
+    *  for classification and to decide between CE marking and drop
+    * Return false if the packet is dropped by the AQM or
+    *  because the buffer is full (maxBytes)
+    */
+    bool insert(float time,
         void *rtpPacket,
         unsigned int ssrc,
         int size,
         unsigned short seqNr,
         bool isCe,
         bool isMark,
-        unsigned int timeStamp);
-    bool extract(float time, 
-        void *rtpPacket, 
+        unsigned int timeStamp,
+        unsigned char ecn = 0x00);
+    /*
+    * Extract a packet, isCe is set to true if the packet is CE marked
+    * Return false if no packet is released, or if the released packet
+    *  is dropped by the AQM
+    */
+    bool extract(float time,
+        void *rtpPacket,
         unsigned int &ssrc,
-        int& size, 
+        int& size,
         unsigned short &seqNr,
         bool &isCe,
         bool &isMark,
         unsigned int& timeStamp);
-    int sizeOfQueue();
+    /*
+    * Number of bytes in queue
+    */
+    int sizeOfQueue() { return bytesInQueue; };
+
+    /*
+    * Number of items in queue
+    */
+    int numberOfItems() { return nItems; };
 
     void updateRate(float time);
 
@@ -47,10 +113,57 @@ public:
 
     bool canExtract();
 
-    NetQueueItem *items[NetQueueSize];
-    int head; // Pointer to last inserted item
-    int tail; // Pointer to the oldest item
+    /*
+    * Time [s] when the oldest item can be extracted,
+    * -1.0 if the queue is empty
+    */
+    float nextReleaseTime();
+
+    /*
+    * Replace the AQM, the queue takes ownership of the AQM object
+    *  and deletes it. The queue must be empty.
+    * NULL disables AQM, i.e a plain FIFO without marking or drops
+    * The default AQM is a ramp marker (isL4s = true) or a
+    *  step marker (isL4s = false), see NetQueueAqm.h
+    * The AQM is applied only if the queue is rate limited (isRateLimited)
+    */
+    void setAqm(NetQueueAqm* aqm);
+
+    NetQueueAqm* getAqm() { return aqm; };
+
+    /*
+    * Make the capacity follow a trace of delivery opportunities instead
+    *  of a fixed rate, see LinkTrace.h. The queue takes ownership of the
+    *  trace. rate is then updated with the estimated capacity of the trace
+    */
+    void setLinkTrace(LinkTrace* linkTrace);
+
+    LinkTrace* getLinkTrace() { return linkTrace; };
+
+    /*
+    * True if packets are released by the link capacity rather than
+    *  by the release time
+    */
+    bool isRateLimited() { return rate > 0 || linkTrace != 0; };
+
+    /*
+    * Seed the random generators of the queue (jitter) and the AQM
+    */
+    void setSeed(unsigned int seed);
+
+    int getNumberOfFifos() { return int(fifos.size()); };
+
+    NetQueueFifo& getFifo(int ix) { return fifos[ix]; };
+
+    std::vector<NetQueueFifo> fifos; // One FIFO per AQM queue
+    NetQueueAqm* aqm;
+    LinkTrace* linkTrace;
     int nItems;
+    int bytesInQueue;
+    int maxBytes; // Buffer size [byte], packets that do not fit are dropped, 0 = unlimited
+    int nDropped; // Number of packets dropped by the AQM or the buffer limit
+    int nMarked; // Number of packets CE marked by the AQM
+    float lastQueueDelay; // Queue delay [s] of the last extracted packet
     float delay;
     float rate;
     float jitter;
@@ -65,6 +178,19 @@ public:
 	float tQueueAvg;
     float bytes;
     float tLastAddBytes;
+
+private:
+    /*
+    * The FIFO to extract the next packet from
+    */
+    int nextFifo(float time);
+
+    /*
+    * Uniformly distributed random number in the range [0.0,1.0[
+    */
+    float random();
+
+    unsigned int rngState;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,330 @@
+#include "NetQueueAqm.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+/*
+* Implements AQM models for the NetQueue bottleneck
+*/
+
+/*
+* Sojourn time of the oldest item in a FIFO
+*/
+static float headSojournTime(float time, NetQueue* queue, int fifo) {
+	NetQueueFifo& f = queue->getFifo(fifo);
+	if (f.isEmpty())
+		return 0.0f;
+	return time - f.front().tQueue;
+}
+
+/*
+* Largest sojourn time over all FIFOs
+*/
+static float maxSojournTime(float time, NetQueue* queue) {
+	float qDelay = 0.0f;
+	for (int n = 0; n < queue->getNumberOfFifos(); n++)
+		qDelay = std::max(qDelay, headSojournTime(time, queue, n));
+	return qDelay;
+}
+
+NetQueueAqm::NetQueueAqm(int nFifos_, int fifoCapacity_) {
+	nFifos = nFifos_;
+	fifoCapacity = fifoCapacity_;
+	rngState = 1;
+}
+
+int NetQueueAqm::select(float time, NetQueue* queue) {
+	for (int n = 0; n < nFifos; n++) {
+		if (!queue->getFifo(n).isEmpty())
+			return n;
+	}
+	return 0;
+}
+
+float NetQueueAqm::random() {
+	/*
+	* Linear congruential generator, 24 most significant bits are used
+	*/
+	rngState = rngState * 1664525u + 1013904223u;
+	return (rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+StepAqm::StepAqm(float threshold_) : NetQueueAqm() {
+	threshold = threshold_;
+}
+
+AqmVerdict StepAqm::dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) {
+	float qDelay = item.tRelease - item.tQueue;
+	if (qDelay > threshold)
+		return kAqmMark;
+	return kAqmPass;
+}
+
+RampAqm::RampAqm(float thLo_, float thHi_) : NetQueueAqm() {
+	thLo = thLo_;
+	thHi = thHi_;
+}
+
+AqmVerdict RampAqm::dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) {
+	float qDelay = item.tRelease - item.tQueue;
+	float pMark = std::max(0.0f, std::min(1.0f, (qDelay - thLo) / (thHi - thLo)));
+	if (random() < pMark)
+		return kAqmMark;
+	return kAqmPass;
+}
+
+PieAqm::PieAqm(float target_, float tUpdate_) : NetQueueAqm() {
+	target = target_;
+	tUpdate = tUpdate_;
+	alpha = 0.125f;
+	beta = 1.25f;
+	maxBurst = 0.15f;
+	ecnTh = 0.1f;
+	p = 0.0f;
+	qDelayOld = 0.0f;
+	burstAllowance = maxBurst;
+	tNextUpdate = -1.0f;
+}
+
+void PieAqm::update(float time, NetQueue* queue) {
+	if (tNextUpdate < 0.0f)
+		tNextUpdate = time;
+	float qDelay = maxSojournTime(time, queue);
+	while (time >= tNextUpdate) {
+		/*
+		* Scale the gains down when p is small, RFC 8033 section 5.2
+		*/
+		float scale = 1.0f;
+		if (p < 0.000001f) scale = 1.0f / 2048;
+		else if (p < 0.00001f) scale = 1.0f / 512;
+		else if (p < 0.0001f) scale = 1.0f / 128;
+		else if (p < 0.001f) scale = 1.0f / 32;
+		else if (p < 0.01f) scale = 1.0f / 8;
+		else if (p < 0.1f) scale = 1.0f / 2;
+		float pDelta = scale * (alpha * (qDelay - target) + beta * (qDelay - qDelayOld));
+		if (p >= 0.1f && pDelta > 0.02f)
+			pDelta = 0.02f;
+		p += pDelta;
+		if (qDelay == 0.0f && qDelayOld == 0.0f)
+			p *= 0.98f;
+		p = std::max(0.0f, std::min(1.0f, p));
+		burstAllowance = std::max(0.0f, burstAllowance - tUpdate);
+		if (p == 0.0f && qDelay < target / 2 && qDelayOld < target / 2)
+			burstAllowance = maxBurst;
+		qDelayOld = qDelay;
+		tNextUpdate += tUpdate;
+	}
+}
+
+bool PieAqm::enqueue(float time, int fifo, NetQueueItem& item, NetQueue* queue) {
+	update(time, queue);
+	if (burstAllowance > 0.0f)
+		return true;
+	if (qDelayOld < target / 2 && p < 0.2f)
+		return true;
+	if (queue->sizeOfQueue() < 2 * 1514)
+		return true;
+	if (random() < p) {
+		if (item.ecn && p <= ecnTh) {
+			item.isCe = true;
+			return true;
+		}
+		return false;
+	}
+	return true;
+}
+
+AqmVerdict PieAqm::dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) {
+	return kAqmPass;
+}
+
+CoDel::CoDel(float target_, float interval_) {
+	target = target_;
+	interval = interval_;
+	isDropping = false;
+	firstAboveTime = 0.0f;
+	dropNext = 0.0f;
+	count = 0;
+	lastCount = 0;
+}
+
+float CoDel::controlLaw(float t) {
+	return t + interval / sqrtf(float(count));
+}
+
+bool CoDel::dequeue(float time, float sojournTime, int bytesInQueue) {
+	bool isOkToDrop = false;
+	if (sojournTime < target || bytesInQueue <= 1514) {
+		firstAboveTime = 0.0f;
+	}
+	else if (firstAboveTime == 0.0f) {
+		firstAboveTime = time + interval;
+	}
+	else {
+		isOkToDrop = time >= firstAboveTime;
+	}
+
+	if (isDropping) {
+		if (!isOkToDrop) {
+			isDropping = false;
+			return false;
+		}
+		if (time >= dropNext) {
+			count++;
+			dropNext = controlLaw(dropNext);
+			return true;
+		}
+		return false;
+	}
+	if (isOkToDrop) {
+		/*
+		* Enter drop state, resume the previous drop rate if
+		*  the drop state was left recently
+		*/
+		isDropping = true;
+		int delta = count - lastCount;
+		count = 1;
+		if (delta > 1 && time - dropNext < 16 * interval)
+			count = delta;
+		dropNext = controlLaw(time);
+		lastCount = count;
+		return true;
+	}
+	return false;
+}
+
+CoDelAqm::CoDelAqm(float target, float interval) : NetQueueAqm(), codel(target, interval) {
+}
+
+AqmVerdict CoDelAqm::dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) {
+	if (codel.dequeue(time, time - item.tQueue, queue->sizeOfQueue()))
+		return markOrDrop(item);
+	return kAqmPass;
+}
+
+FqCoDelAqm::FqCoDelAqm(int nFlows, int quantum_, float target, float interval) :
+	NetQueueAqm(nFlows, 16) {
+	quantum = quantum_;
+	codel.assign(nFlows, CoDel(target, interval));
+	deficit.assign(nFlows, 0);
+	isActive.assign(nFlows, false);
+}
+
+int FqCoDelAqm::classify(const NetQueueItem& item) {
+	uint32_t h = item.ssrc * 2654435761u;
+	return int(h % uint32_t(nFifos));
+}
+
+bool FqCoDelAqm::enqueue(float time, int fifo, NetQueueItem& item, NetQueue* queue) {
+	if (!isActive[fifo]) {
+		isActive[fifo] = true;
+		deficit[fifo] = quantum;
+		activeFlows.push_back(fifo);
+	}
+	return true;
+}
+
+int FqCoDelAqm::select(float time, NetQueue* queue) {
+	/*
+	* Deficit round robin, a flow is served when its deficit
+	*  covers the size of its oldest packet
+	*/
+	while (!activeFlows.empty()) {
+		int fifo = activeFlows.front();
+		NetQueueFifo& f = queue->getFifo(fifo);
+		if (f.isEmpty()) {
+			isActive[fifo] = false;
+			activeFlows.pop_front();
+			continue;
+		}
+		if (deficit[fifo] >= f.front().size)
+			return fifo;
+		deficit[fifo] += quantum;
+		activeFlows.pop_front();
+		activeFlows.push_back(fifo);
+	}
+	return NetQueueAqm::select(time, queue);
+}
+
+AqmVerdict FqCoDelAqm::dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) {
+	deficit[fifo] -= item.size;
+	if (codel[fifo].dequeue(time, time - item.tQueue, queue->getFifo(fifo).bytesInQueue))
+		return markOrDrop(item);
+	return kAqmPass;
+}
+
+DualPi2Aqm::DualPi2Aqm(float target_, float tUpdate_) : NetQueueAqm(2) {
+	target = target_;
+	tUpdate = tUpdate_;
+	alpha = 0.16f;
+	beta = 3.2f;
+	k = 2.0f;
+	minTh = 0.0008f;
+	range = 0.0004f;
+	tShift = 2 * target;
+	pBase = 0.0f;
+	qDelayOld = 0.0f;
+	tNextUpdate = -1.0f;
+}
+
+int DualPi2Aqm::classify(const NetQueueItem& item) {
+	return (item.ecn & 0x01) ? 0 : 1;
+}
+
+int DualPi2Aqm::select(float time, NetQueue* queue) {
+	NetQueueFifo& l = queue->getFifo(0);
+	NetQueueFifo& c = queue->getFifo(1);
+	if (c.isEmpty())
+		return 0;
+	if (l.isEmpty())
+		return 1;
+	if (l.front().tQueue - tShift <= c.front().tQueue)
+		return 0;
+	return 1;
+}
+
+void DualPi2Aqm::update(float time, NetQueue* queue) {
+	if (tNextUpdate < 0.0f)
+		tNextUpdate = time;
+	float qDelay = maxSojournTime(time, queue);
+	while (time >= tNextUpdate) {
+		pBase += alpha * (qDelay - target) + beta * (qDelay - qDelayOld);
+		pBase = std::max(0.0f, std::min(1.0f, pBase));
+		qDelayOld = qDelay;
+		tNextUpdate += tUpdate;
+	}
+}
+
+AqmVerdict DualPi2Aqm::dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) {
+	update(time, queue);
+	if (fifo == 0) {
+		float qDelay = time - item.tQueue;
+		float th = minTh;
+		if (queue->rate > 0)
+			th = std::max(th, 2 * 1514 * 8 / queue->rate);
+		float pNative = std::max(0.0f, std::min(1.0f, (qDelay - th) / range));
+		float pL = std::max(pNative, std::min(1.0f, k * pBase));
+		if (random() < pL)
+			return kAqmMark;
+		return kAqmPass;
+	}
+	if (random() < pBase * pBase)
+		return markOrDrop(item);
+	return kAqmPass;
+}
+
+NetQueueAqm* createAqm(const char* name) {
+	if (strcmp(name, "step") == 0)
+		return new StepAqm();
+	if (strcmp(name, "ramp") == 0)
+		return new RampAqm();
+	if (strcmp(name, "pie") == 0)
+		return new PieAqm();
+	if (strcmp(name, "codel") == 0)
+		return new CoDelAqm();
+	if (strcmp(name, "fq_codel") == 0)
+		return new FqCoDelAqm();
+	if (strcmp(name, "dualpi2") == 0)
+		return new DualPi2Aqm();
+	return 0;
+}
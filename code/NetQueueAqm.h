@@ -0,0 +1,250 @@
+#ifndef NET_QUEUE_AQM
+#define NET_QUEUE_AQM
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "NetQueue.h"
+
+/*
+* AQM (Active Queue Management) models for the rate limited
+*  NetQueue bottleneck. An AQM decides
+*  - Which FIFO a packet is queued in (classify)
+*  - If a packet is dropped or CE marked on enqueue
+*  - Which FIFO is served next (select)
+*  - If a packet is dropped or CE marked on dequeue
+* Each AQM has its own random generator, i.e. marking decisions
+*  do not depend on other users of rand()
+*/
+/*
+* Default thresholds [s] of the step and ramp markers, these are also the
+*  built in markers of NetQueue
+*/
+const float kStepAqmThreshold = 0.03f;
+const float kRampAqmThLo = 0.008f;
+const float kRampAqmThHi = 0.012f;
+
+enum AqmVerdict {
+	kAqmPass,
+	kAqmMark,
+	kAqmDrop
+};
+
+class NetQueueAqm {
+public:
+	NetQueueAqm(int nFifos = 1, int fifoCapacity = NetQueueSize);
+	virtual ~NetQueueAqm() {};
+
+	/*
+	* Return the FIFO that the item is queued in
+	*/
+	virtual int classify(const NetQueueItem& /*item*/) { return 0; };
+
+	/*
+	* Called before the item is queued in the given FIFO.
+	* The AQM may CE mark the item by setting item.isCe
+	* Return false to drop the item
+	*/
+	virtual bool enqueue(float /*time*/, int /*fifo*/, NetQueueItem& /*item*/, NetQueue* /*queue*/) { return true; };
+
+	/*
+	* Return the FIFO that the next packet is extracted from,
+	*  the queue is not empty. The default is the first non-empty FIFO.
+	* Repeated calls without a dequeue in between must return the same FIFO
+	*/
+	virtual int select(float time, NetQueue* queue);
+
+	/*
+	* Called when the item is removed from the given FIFO, time is
+	*  when the transmission of the item starts
+	*/
+	virtual AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue) = 0;
+
+	int getNumberOfFifos() { return nFifos; };
+	int getFifoCapacity() { return fifoCapacity; };
+
+	/*
+	* Seed the random generator
+	*/
+	void setSeed(uint32_t seed) { rngState = seed; };
+
+protected:
+	/*
+	* Uniformly distributed random number in the range [0.0,1.0[
+	*/
+	float random();
+
+	/*
+	* Mark ECN capable packets, drop others
+	*/
+	AqmVerdict markOrDrop(const NetQueueItem& item) {
+		return item.ecn ? kAqmMark : kAqmDrop;
+	};
+
+	int nFifos;
+	int fifoCapacity;
+	uint32_t rngState;
+};
+
+/*
+* Mark if the queue delay exceeds a threshold.
+* The queue delay is the time from insertion until the packet
+*  is serialized at the bottleneck, computed at insertion
+* Not-ECT packets are marked too, it is up to the receiver to ignore
+*  the CE mark, this is the behavior of the original simulator.
+*/
+class StepAqm : public NetQueueAqm {
+public:
+	StepAqm(float threshold = kStepAqmThreshold);
+	AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue);
+
+	float threshold;
+};
+
+/*
+* Mark with a probability that increases linearly from 0 to 1
+*  as the queue delay increases from thLo to thHi.
+* The queue delay is computed as for StepAqm
+*/
+class RampAqm : public NetQueueAqm {
+public:
+	RampAqm(float thLo = kRampAqmThLo, float thHi = kRampAqmThHi);
+	AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue);
+
+	float thLo;
+	float thHi;
+};
+
+/*
+* PIE, RFC 8033
+* Drop or mark on enqueue with a probability that is
+*  updated by a PI controller on the queue delay.
+* ECN capable packets are marked as long as the probability
+*  is below 10%
+*/
+class PieAqm : public NetQueueAqm {
+public:
+	PieAqm(float target = 0.015f, float tUpdate = 0.015f);
+	bool enqueue(float time, int fifo, NetQueueItem& item, NetQueue* queue);
+	AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue);
+
+	float target;
+	float tUpdate;
+	float alpha;
+	float beta;
+	float maxBurst;
+	float ecnTh;
+	float p;
+
+private:
+	void update(float time, NetQueue* queue);
+
+	float qDelayOld;
+	float burstAllowance;
+	float tNextUpdate;
+};
+
+/*
+* CoDel controller state, RFC 8289
+* Shared by CoDelAqm and FqCoDelAqm
+*/
+class CoDel {
+public:
+	CoDel(float target = 0.005f, float interval = 0.1f);
+
+	/*
+	* Return true if the packet with the given sojourn time
+	*  should be dropped or marked, bytesInQueue is the number of
+	*  bytes left in the queue
+	*/
+	bool dequeue(float time, float sojournTime, int bytesInQueue);
+
+	float target;
+	float interval;
+
+private:
+	float controlLaw(float t);
+
+	bool isDropping;
+	float firstAboveTime;
+	float dropNext;
+	int count;
+	int lastCount;
+};
+
+/*
+* CoDel, RFC 8289, on a single FIFO
+*/
+class CoDelAqm : public NetQueueAqm {
+public:
+	CoDelAqm(float target = 0.005f, float interval = 0.1f);
+	AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue);
+
+	CoDel codel;
+};
+
+/*
+* FQ-CoDel, RFC 8290
+* Flows are hashed on SSRC into nFlows FIFOs that are served
+*  with deficit round robin, each FIFO has its own CoDel instance
+*/
+class FqCoDelAqm : public NetQueueAqm {
+public:
+	FqCoDelAqm(int nFlows = 64, int quantum = 1514, float target = 0.005f, float interval = 0.1f);
+	int classify(const NetQueueItem& item);
+	bool enqueue(float time, int fifo, NetQueueItem& item, NetQueue* queue);
+	int select(float time, NetQueue* queue);
+	AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue);
+
+	int quantum;
+
+private:
+	std::vector<CoDel> codel;
+	std::vector<int> deficit;
+	std::vector<bool> isActive;
+	std::deque<int> activeFlows;
+};
+
+/*
+* DualPI2, RFC 9332
+* ECT(1) and CE packets are queued in the L4S FIFO (0),
+*  other packets in the classic FIFO (1).
+* A PI controller on the queue delay computes a base probability p',
+*  classic packets are dropped/marked with probability p'^2, L4S packets
+*  are marked with probability max(k*p', native L4S ramp).
+* The native ramp starts at minTh but not below two MTU serialization
+*  times, a single queued packet does not cause marking at low link rates
+* The FIFOs are served in time shifted FIFO order, i.e an L4S packet
+*  is served before a classic packet that arrived up to tShift earlier
+*/
+class DualPi2Aqm : public NetQueueAqm {
+public:
+	DualPi2Aqm(float target = 0.015f, float tUpdate = 0.016f);
+	int classify(const NetQueueItem& item);
+	int select(float time, NetQueue* queue);
+	AqmVerdict dequeue(float time, int fifo, const NetQueueItem& item, NetQueue* queue);
+
+	float target;
+	float tUpdate;
+	float alpha;
+	float beta;
+	float k; // Coupling factor
+	float minTh; // Native L4S ramp start
+	float range; // Native L4S ramp width
+	float tShift;
+	float pBase; // p'
+
+private:
+	void update(float time, NetQueue* queue);
+
+	float qDelayOld;
+	float tNextUpdate;
+};
+
+/*
+* Create an AQM by name: "step", "ramp", "pie", "codel", "fq_codel" or "dualpi2"
+* Return NULL if the name is unknown
+*/
+NetQueueAqm* createAqm(const char* name);
+
+#endif
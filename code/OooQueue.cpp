@@ -30,6 +30,13 @@ OooQueue::OooQueue(float maxDelay_) {
 	nDelayed;
 }
 
+OooQueue::~OooQueue() {
+	for (int n = 0; n < OooQueueSize; n++) {
+		delete items[n];
+	}
+	delete item;
+}
+
 bool OooQueue::insert(float time,
 	void* rtpPacket,
 	unsigned int ssrc,
@@ -117,3 +124,13 @@ bool OooQueue::extract(float time,
 	}
 
 }
+
+float OooQueue::nextReleaseTime() {
+	float tRelease = -1.0f;
+	for (int n = 0; n < OooQueueSize; n++) {
+		if (items[n]->used && (tRelease < 0.0f || items[n]->tRelease < tRelease)) {
+			tRelease = items[n]->tRelease;
+		}
+	}
+	return tRelease;
+}
@@ -21,6 +21,7 @@ class OooQueue {
 public:
 
     OooQueue(float maxDelay);
+    ~OooQueue();
 
     /*
     * Return true of packet is delayed, otherwise false
@@ -42,6 +43,12 @@ public:
         bool& isMark,
         unsigned int& timeStamp);
 
+    /*
+    * Earliest release time [s] of delayed packets,
+    * -1.0 if no packets are delayed
+    */
+    float nextReleaseTime();
+
     OooQueueItem *items[OooQueueSize];
     OooQueueItem *item;
     int nItems;
@@ -0,0 +1,75 @@
+#include "PacketPool.h"
+#include <iostream>
+using namespace std;
+
+/*
+* Fixed size pool of RTP packet buffers
+*/
+
+PacketPool::PacketPool(int nBuffers_, int bufferSize_) {
+	nBuffers = nBuffers_;
+	/*
+	* Keep the buffers cache line aligned
+	*/
+	bufferSize = (bufferSize_ + 63) & ~63;
+	memory = new unsigned char[nBuffers * bufferSize + 64];
+	refCount = new int[nBuffers];
+	freeList = new int[nBuffers];
+	for (int n = 0; n < nBuffers; n++) {
+		refCount[n] = 0;
+		freeList[n] = nBuffers - 1 - n;
+	}
+	nFree = nBuffers;
+}
+
+PacketPool::~PacketPool() {
+	delete[] memory;
+	delete[] refCount;
+	delete[] freeList;
+}
+
+int PacketPool::getIx(void* packet) {
+	return int(((unsigned char*)packet - getBase()) / bufferSize);
+}
+
+unsigned char* PacketPool::getBase() {
+	return (unsigned char*)((uintptr_t(memory) + 63) & ~uintptr_t(63));
+}
+
+void* PacketPool::alloc() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (nFree == 0)
+		return NULL;
+	int ix = freeList[--nFree];
+	refCount[ix] = 1;
+	return getBase() + ix * bufferSize;
+}
+
+void PacketPool::addRef(void* packet) {
+	std::unique_lock<std::mutex> lock(mutex);
+	refCount[getIx(packet)]++;
+}
+
+bool PacketPool::release(void* packet) {
+	std::unique_lock<std::mutex> lock(mutex);
+	int ix = getIx(packet);
+	if (refCount[ix] <= 0) {
+		cerr << "PacketPool::release buffer " << ix << " is not allocated" << endl;
+		return false;
+	}
+	if (--refCount[ix] > 0)
+		return false;
+	freeList[nFree++] = ix;
+	return true;
+}
+
+bool PacketPool::isFromPool(void* packet) {
+	unsigned char* p = (unsigned char*)packet;
+	unsigned char* base = getBase();
+	return p >= base && p < base + nBuffers * bufferSize && (p - base) % bufferSize == 0;
+}
+
+int PacketPool::getFreeCount() {
+	std::unique_lock<std::mutex> lock(mutex);
+	return nFree;
+}
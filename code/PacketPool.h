@@ -0,0 +1,60 @@
+#ifndef PACKET_POOL
+#define PACKET_POOL
+
+#include <cstdint>
+#include <mutex>
+
+/*
+* Fixed size pool of RTP packet buffers with reference counts.
+* All buffers are allocated in one block when the pool is created, alloc()
+*  and release() only move buffer indices on a free list so that there is no
+*  heap traffic when media is transmitted.
+* A buffer is returned to the pool when the last reference is released,
+*  addRef() is used when more than one owner needs to keep the packet,
+*  for instance a retransmission buffer.
+* alloc() and release() may be called from different threads
+*/
+class PacketPool {
+public:
+	PacketPool(int nBuffers, int bufferSize);
+	~PacketPool();
+
+	/*
+	* Get a buffer with reference count 1, NULL is returned if the pool is empty
+	*/
+	void* alloc();
+
+	/*
+	* Add a reference to a buffer
+	*/
+	void addRef(void* packet);
+
+	/*
+	* Release a reference to a buffer, the buffer is returned to the pool
+	*  when the reference count reaches 0, true is then returned
+	*/
+	bool release(void* packet);
+
+	/*
+	* Return true if packet is a buffer in this pool
+	*/
+	bool isFromPool(void* packet);
+
+	int getBufferSize() { return bufferSize; }
+	int getNumberOfBuffers() { return nBuffers; }
+	int getFreeCount();
+
+private:
+	int getIx(void* packet);
+	unsigned char* getBase();
+
+	unsigned char* memory;
+	int nBuffers;
+	int bufferSize;
+	int* refCount;
+	int* freeList;
+	int nFree;
+	std::mutex mutex;
+};
+
+#endif
@@ -7,117 +7,135 @@ using namespace std;
 */
 
 RtpQueueItem::RtpQueueItem() {
-	used = false;
+	packet = 0;
 	size = 0;
+	ssrc = 0;
 	seqNr = 0;
 	timeStamp = 0;
+	ts = 0.0f;
+	isMark = false;
+	isDiscardable = true;
 }
 
 
-RtpQueue::RtpQueue() {
-	for (int n = 0; n < kRtpQueueSize; n++) {
-		items[n] = new RtpQueueItem();
-	}
-	head = -1;
+RtpQueue::RtpQueue(int capacity) {
+	init(capacity);
+	packetPool = 0;
+}
+
+RtpQueue::RtpQueue(int nBuffers, int bufferSize, int capacity) {
+	init(capacity);
+	packetPool = new PacketPool(nBuffers, bufferSize);
+}
+
+void RtpQueue::init(int capacity) {
+	int n = 1;
+	while (n < capacity)
+		n *= 2;
+	items = new RtpQueueItem[n];
+	mask = n - 1;
+	head = 0;
 	tail = 0;
-	nItems = 0;
 	sizeOfLastFrame = 0;
 	bytesInQueue_ = 0;
 	sizeOfQueue_ = 0;
-	sizeOfNextRtp_ = -1;
 }
 
-bool RtpQueue::push(void* rtpPacket, int size, uint32_t ssrc, unsigned short seqNr, bool isMark, float ts, uint32_t timeStamp) {
-	std::unique_lock<std::mutex> lock(queue_operation_mutex_);
-	int ix = head + 1;
-	if (ix == kRtpQueueSize) ix = 0;
-	if (items[ix]->used) {
+RtpQueue::~RtpQueue() {
+	delete[] items;
+	delete packetPool;
+}
+
+void* RtpQueue::allocPacket() {
+	if (packetPool == 0)
+		return NULL;
+	return packetPool->alloc();
+}
+
+bool RtpQueue::push(void* rtpPacket, int size, uint32_t ssrc, unsigned short seqNr, bool isMark, float ts, uint32_t timeStamp, bool isDiscardable) {
+	uint32_t h = head.load(std::memory_order_relaxed);
+	if (h - tail.load(std::memory_order_acquire) > mask) {
 		/*
 		* RTP queue is full, do a drop tail i.e ignore new RTP packets
 		*/
 		return (false);
 	}
-	head = ix;
-	items[head]->seqNr = seqNr;
-	items[head]->timeStamp = timeStamp;
-	items[head]->ssrc = ssrc;
-	items[head]->size = size;
-	items[head]->ts = ts;
-	items[head]->isMark = isMark;
-	items[head]->used = true;
-	bytesInQueue_ += size;
-	sizeOfQueue_ += 1;
+	RtpQueueItem* item = &items[h & mask];
+	item->seqNr = seqNr;
+	item->timeStamp = timeStamp;
+	item->ssrc = ssrc;
+	item->size = size;
+	item->ts = ts;
+	item->isMark = isMark;
+	item->isDiscardable = isDiscardable;
 #ifndef IGNORE_PACKET
-	items[head]->packet = rtpPacket;
+	item->packet = rtpPacket;
 #endif
-	computeSizeOfNextRtp();
+	/*
+	* Publish the item to the consumer
+	*/
+	head.store(h + 1, std::memory_order_release);
+	bytesInQueue_ += size;
+	sizeOfQueue_ += 1;
 	return (true);
 }
+
 bool RtpQueue::pop(void** rtpPacket, int& size, uint32_t& ssrc, unsigned short& seqNr, bool& isMark, uint32_t& timeStamp)
 {
-	std::unique_lock<std::mutex> lock(queue_operation_mutex_);
-	if (items[tail]->used == false) {
-		*rtpPacket = NULL;
-		sizeOfNextRtp_ = -1;
-		return false;
-	}
-	else {
-		size = items[tail]->size;
-
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	for (;;) {
+		if (t == head.load(std::memory_order_acquire)) {
+			*rtpPacket = NULL;
+			return false;
+		}
+		RtpQueueItem* item = &items[t & mask];
+		size = item->size;
 #ifndef IGNORE_PACKET
-		* rtpPacket = items[tail]->packet;
+		*rtpPacket = item->packet;
 #endif
-		seqNr = items[tail]->seqNr;
-		timeStamp = items[tail]->timeStamp;
-		ssrc = items[tail]->ssrc;
-		isMark = items[tail]->isMark;
-		items[tail]->used = false;
+		seqNr = item->seqNr;
+		timeStamp = item->timeStamp;
+		ssrc = item->ssrc;
+		isMark = item->isMark;
 		/*
-		* Thread safe update of tail to avoid that tail points outside
-		*  array, which can cause e.g RtpQueue::getDelay to give a
-		*  segmentation fault.
-		* This should not really be needed because
-		*  we use mutex to make the pop function atomic
+		* The item can't be overwritten before tail is advanced, the compare
+		*  and swap fails only if clear() was called in the meantime
 		*/
-		if (tail == kRtpQueueSize - 1)
-			tail = 0;
-		else
-			tail++;
-		bytesInQueue_ -= size;
-		sizeOfQueue_ -= 1;
-		computeSizeOfNextRtp();
-		return true;
+		if (tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			bytesInQueue_ -= size;
+			sizeOfQueue_ -= 1;
+			return true;
+		}
 	}
 }
 
-void RtpQueue::computeSizeOfNextRtp() {
-	if (!items[tail]->used) {
-		sizeOfNextRtp_ = -1;
+int RtpQueue::sizeOfNextRtp() {
+	uint32_t t = tail.load(std::memory_order_acquire);
+	if (t == head.load(std::memory_order_acquire)) {
+		return -1;
 	}
 	else {
-		sizeOfNextRtp_ = items[tail]->size;
+		return items[t & mask].size;
 	}
 }
 
-int RtpQueue::sizeOfNextRtp() {
-	return sizeOfNextRtp_;
-}
-
 int RtpQueue::seqNrOfNextRtp() {
-	if (!items[tail]->used) {
+	uint32_t t = tail.load(std::memory_order_acquire);
+	if (t == head.load(std::memory_order_acquire)) {
 		return -1;
 	}
 	else {
-		return items[tail]->seqNr;
+		return items[t & mask].seqNr;
 	}
 }
 
 int RtpQueue::seqNrOfLastRtp() {
-	if (!items[head]->used) {
+	uint32_t h = head.load(std::memory_order_acquire);
+	if (h == tail.load(std::memory_order_acquire)) {
 		return -1;
 	}
 	else {
-		return items[head]->seqNr;
+		return items[(h - 1) & mask].seqNr;
 	}
 }
 
@@ -130,18 +148,18 @@ int RtpQueue::sizeOfQueue() {
 }
 
 float RtpQueue::getDelay(float currTs) {
-	if (items[tail]->used == false) {
+	uint32_t t = tail.load(std::memory_order_acquire);
+	if (t == head.load(std::memory_order_acquire)) {
 		return 0;
 	}
 	else {
-		return currTs - items[tail]->ts;
+		return currTs - items[t & mask].ts;
 	}
 }
 
 bool RtpQueue::sendPacket(void** rtpPacket, int& size, uint32_t& ssrc, unsigned short& seqNr, bool& isMark, uint32_t& timeStamp) {
 	if (sizeOfQueue() > 0) {
-		pop(rtpPacket, size, ssrc, seqNr, isMark, timeStamp);
-		return true;
+		return pop(rtpPacket, size, ssrc, seqNr, isMark, timeStamp);
 	}
 	return false;
 }
@@ -149,22 +167,101 @@ bool RtpQueue::sendPacket(void** rtpPacket, int& size, uint32_t& ssrc, unsigned
 #ifndef IGNORE_PACKET
 extern void packet_free(void* buf, uint32_t ssrc);
 #endif
+
+void RtpQueue::freePacket(void* rtpPacket, uint32_t ssrc) {
+	if (packetPool != 0 && packetPool->isFromPool(rtpPacket)) {
+		packetPool->release(rtpPacket);
+		return;
+	}
+#ifndef IGNORE_PACKET
+	packet_free(rtpPacket, ssrc);
+#endif
+}
 int RtpQueue::clear() {
 	uint16_t seqNr;
 	uint32_t timeStamp;
 	uint32_t ssrc;
 	int freed = 0;
 	int size;
-	void* buf;
-	while (sizeOfQueue() > 0) {
+	void* buf = NULL;
+	/*
+	* Pop the items that are in the queue now, each item is either popped here
+	*  or by the consumer if clear() is called from the producer
+	*/
+	uint32_t h = head.load(std::memory_order_acquire);
+	while (int32_t(h - tail.load(std::memory_order_acquire)) > 0) {
 		bool isMark;
-		pop(&buf, size, ssrc, seqNr, isMark, timeStamp);
+		if (!pop(&buf, size, ssrc, seqNr, isMark, timeStamp))
+			break;
+#ifdef IGNORE_PACKET
+		freed++;
+#else
 		if (buf != NULL) {
 			freed++;
+			freePacket(buf, ssrc);
+		}
+#endif
+	}
+	return (freed);
+}
+
+bool RtpQueue::isCompleteFrame(uint32_t t, uint32_t h) {
+	uint32_t timeStamp = items[t & mask].timeStamp;
+	for (; t != h; t++) {
+		RtpQueueItem* item = &items[t & mask];
+		if (item->timeStamp != timeStamp || item->isMark)
+			return true;
+	}
+	return false;
+}
+
+int RtpQueue::discardFrames(float currTs, float maxDelay, uint32_t* timeStamps, int maxTimeStamps, int& nPackets) {
+	int nFrames = 0;
+	nPackets = 0;
+	for (;;) {
+		uint32_t h = head.load(std::memory_order_acquire);
+		uint32_t t = tail.load(std::memory_order_acquire);
+		if (t == h)
+			break;
+		RtpQueueItem* item = &items[t & mask];
+		uint32_t timeStamp = item->timeStamp;
+		if (currTs - item->ts <= maxDelay || !item->isDiscardable || !isCompleteFrame(t, h))
+			break;
+		/*
+		* Pop the packets of the frame one by one, each packet is either popped
+		*  here or by the consumer, the timestamp check stops at the next frame
+		*/
+		int nFramePackets = 0;
+		while (t != head.load(std::memory_order_acquire)) {
+			item = &items[t & mask];
+			if (item->timeStamp != timeStamp)
+				break;
+			int size = item->size;
+			uint32_t ssrc = item->ssrc;
+			bool isMark = item->isMark;
+			void* buf = item->packet;
+			if (!tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+				continue;
+			t++;
+			bytesInQueue_ -= size;
+			sizeOfQueue_ -= 1;
+			nFramePackets++;
 #ifndef IGNORE_PACKET
-			packet_free(buf, ssrc);
+			if (buf != NULL)
+				freePacket(buf, ssrc);
+#else
+			(void)buf;
+			(void)ssrc;
 #endif
+			if (isMark)
+				break;
 		}
+		if (nFramePackets == 0)
+			continue;
+		if (nFrames < maxTimeStamps)
+			timeStamps[nFrames] = timeStamp;
+		nFrames++;
+		nPackets += nFramePackets;
 	}
-	return (freed);
+	return nFrames;
 }
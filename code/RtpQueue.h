@@ -2,7 +2,8 @@
 #define RTP_QUEUE
 
 #include <cstdint>
-#include <mutex>
+#include <atomic>
+#include "PacketPool.h"
 /*
 * Implements a simple RTP packet queue, one RTP queue
 * per stream {SSRC,PT}
@@ -10,6 +11,7 @@
 
 class RtpQueueIface {
 public:
+	virtual ~RtpQueueIface() {}
 	virtual int clear() = 0;
 	virtual int sizeOfNextRtp() = 0;
 	virtual int seqNrOfNextRtp() = 0;
@@ -18,6 +20,14 @@ public:
 	virtual int sizeOfQueue() = 0;  // Number of items in queue
 	virtual float getDelay(float currTs) = 0;
 	virtual int getSizeOfLastFrame() = 0;
+	/*
+	* Discard whole stale frames, see RtpQueue::discardFrames(). RTP queues
+	*  that do not implement it return -1, ScreamV2Tx then clears the queue
+	*/
+	virtual int discardFrames(float /*currTs*/, float /*maxDelay*/, uint32_t* /*timeStamps*/, int /*maxTimeStamps*/, int& nPackets) {
+		nPackets = 0;
+		return -1;
+	}
 };
 
 class RtpQueueItem {
@@ -30,15 +40,50 @@ public:
 	unsigned long timeStamp;
 	float ts;
 	bool isMark;
-	bool used;
+	bool isDiscardable;
 };
 
+/*
+* Default capacity [packets]
+*/
 const int kRtpQueueSize = 1024;
+
+/*
+* Single producer, single consumer ring buffer with inline items.
+* push() is called by the packetizer (producer) and pop() by the transmitter
+*  (consumer), they never block each other. head is only written by the
+*  producer and tail is advanced by the consumer, the two are kept on
+*  separate cache lines. tail is advanced with a compare and swap, this
+*  allows clear() to be called from either the producer or the consumer, which is
+*  needed as ScreamV2Tx discards the RTP queue in newMediaFrame().
+* The capacity is rounded up to a power of two
+*/
 class RtpQueue : public RtpQueueIface {
 public:
-	RtpQueue();
+	RtpQueue(int capacity = kRtpQueueSize);
+	/*
+	* RTP queue with a pool of nBuffers packet buffers of size bufferSize [byte]
+	*  the packetizer writes RTP packets in place in buffers from allocPacket()
+	*  and the packets are returned with freePacket() after they are transmitted
+	*/
+	RtpQueue(int nBuffers, int bufferSize, int capacity = kRtpQueueSize);
+	~RtpQueue();
+
+	/*
+	* Get a packet buffer from the pool, NULL if the pool is empty or not used
+	*/
+	void* allocPacket();
+	/*
+	* Release a packet, pool buffers are returned to the pool, other
+	*  packets are freed with packet_free()
+	*/
+	void freePacket(void* rtpPacket, uint32_t ssrc);
 
-	bool push(void* rtpPacket, int size, uint32_t ssrc, unsigned short seqNr, bool isMark, float ts, uint32_t timeStamp);
+	/*
+	* Push an RTP packet, isDiscardable = false protects the frame from discardFrames(),
+	*  it should be the same for all packets of a frame, e.g false for key frames
+	*/
+	bool push(void* rtpPacket, int size, uint32_t ssrc, unsigned short seqNr, bool isMark, float ts, uint32_t timeStamp, bool isDiscardable = true);
 	bool pop(void** rtpPacket, int& size, uint32_t& ssrc, unsigned short& seqNr, bool& isMark, uint32_t& timeStamp);
 	int sizeOfNextRtp();
 	int seqNrOfNextRtp();
@@ -48,20 +93,43 @@ public:
 	float getDelay(float currTs);
 	bool sendPacket(void** rtpPacket, int& size, uint32_t& ssrc, unsigned short& seqNr, bool& isMark, uint32_t& timeStamp);
 	int clear();
+	/*
+	* Discard whole frames from the head of the queue that have passed their
+	*  deadline, i.e. the first packet of the frame is older than maxDelay [s].
+	* A frame is the packets with the same RTP timestamp, up to and including
+	*  the packet with the marker bit. Discarding stops at the first frame
+	*  that is within its deadline, is not discardable or is not completely
+	*  in the queue yet. The rest of a frame is discarded if the consumer has
+	*  popped a part of it.
+	* The RTP timestamps of the first maxTimeStamps discarded frames are written
+	*  to timeStamps. The number of discarded frames is returned and nPackets is
+	*  set to the number of discarded packets.
+	* Like clear(), this can be called from either the producer or the consumer
+	*/
+	int discardFrames(float currTs, float maxDelay, uint32_t* timeStamps, int maxTimeStamps, int& nPackets);
 	int getSizeOfLastFrame() { return sizeOfLastFrame; };
 	void setSizeOfLastFrame(int sz) { sizeOfLastFrame = sz; };
-	void computeSizeOfNextRtp();
+	int getCapacity() { return int(mask) + 1; };
 
-	RtpQueueItem* items[kRtpQueueSize];
-	int head; // Pointer to last inserted item
-	int tail; // Pointer to the oldest item
-	int nItems;
+	RtpQueueItem* items; // Ring buffer with inline items
+	uint32_t mask;
 	int sizeOfLastFrame;
+	PacketPool* packetPool;
+
+private:
+	void init(int capacity);
+	/*
+	* True if the frame that starts at index t is complete, h is the head index
+	*/
+	bool isCompleteFrame(uint32_t t, uint32_t h);
 
-	int bytesInQueue_;
-	int sizeOfQueue_;
-	int sizeOfNextRtp_;
-	std::mutex queue_operation_mutex_;
+	char pad0[64];
+	std::atomic<uint32_t> head; // Number of pushed items, written by the producer
+	char pad1[64];
+	std::atomic<uint32_t> tail; // Number of popped items, written by the consumer
+	char pad2[64];
+	std::atomic<int> bytesInQueue_;
+	std::atomic<int> sizeOfQueue_;
 };
 
 #endif
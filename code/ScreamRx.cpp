@@ -1,4 +1,5 @@
 #include "ScreamRx.h"
+#include "CcfbCodec.h"
 #ifdef _MSC_VER
 #define NOMINMAX
 #include <WinSock2.h>
@@ -135,6 +136,24 @@ void ScreamRx::Stream::receive(uint32_t time_ntp,
 	}
 }
 
+void ScreamRx::Stream::encodeReports(uint32_t time_ntp,
+	uint16_t sn_lo,
+	int n,
+	unsigned char* buf) {
+	/*
+	* The history is a ring buffer, the report elements are encoded
+	*  in chunks that are contiguous in the history
+	*/
+	int k = 0;
+	while (k < n) {
+		uint16_t sn = sn_lo + k;
+		uint16_t ix = sn % kRxHistorySize;
+		int nChunk = std::min(n - k, kRxHistorySize - ix);
+		CcfbCodec::encodeReports(time_ntp, sn, &seqNrHist[ix], &rxTimeHist[ix], &ceBitsHist[ix], nChunk, buf + 2 * k);
+		k += nChunk;
+	}
+}
+
 bool ScreamRx::Stream::getStandardizedFeedback(uint32_t time_ntp,
 	unsigned char* buf,
 	int& size) {
@@ -186,30 +205,21 @@ bool ScreamRx::Stream::getStandardizedFeedback(uint32_t time_ntp,
 	int ptr = 8;
 
 
+	encodeReports(time_ntp, sn_lo, nReportedRtpPackets, buf + ptr);
+	size += 2 * nReportedRtpPackets;
+	ptr += 2 * nReportedRtpPackets;
+
 	for (uint16_t k = 0; k < nReportedRtpPackets; k++) {
-		uint16_t sn = sn_lo + k;		
+		uint16_t sn = sn_lo + k;
 		uint16_t ix = sn % kRxHistorySize;
-		uint32_t ato = (time_ntp - rxTimeHist[ix]);
-		ato = ato >> 6; // Q16->Q10
-		if (ato > 8189)
-			ato = 0x1FFE;
-		tmp_s = 0x0000;
-		if (seqNrHist[ix] == sn && rxTimeHist[ix] != 0) {
-			tmp_s = 0x8000 | ((ceBitsHist[ix] & 0x03) << 13) | (ato & 0x01FFF);;
-			if (isOooHist[ix]) {
-				/*
-				* Clear OOO flag if set att decrement number of OOO packets as the 
-				* particular OOO packet is indeed ACKed here
-				*/
-				isOooHist[ix] = false;
-				numOooDetected = std::max(0, numOooDetected - 1);
-			}
+		if (isOooHist[ix] && seqNrHist[ix] == sn && rxTimeHist[ix] != 0) {
+			/*
+			* Clear OOO flag if set att decrement number of OOO packets as the 
+			* particular OOO packet is indeed ACKed here
+			*/
+			isOooHist[ix] = false;
+			numOooDetected = std::max(0, numOooDetected - 1);
 		}
-
-		tmp_s = htons(tmp_s);
-		memcpy(buf + ptr, &tmp_s, 2);
-		size += 2;
-		ptr += 2;
 	}
 	/*
 	* Zero pad with two extra octets if the number of reported packets is odd
@@ -309,26 +319,12 @@ bool ScreamRx::Stream::getStandardizedFeedbackOoo(uint32_t time_ntp,
 		*/
 		uint16_t sn_lo = oooLowSeqNr;
 
-		for (uint16_t k = 0; k < nReportedPackets; k++) { // may be oooHighSeqNr-oooLowSeqNr+1 instead
+		encodeReports(time_ntp, sn_lo, nReportedPackets, buf + ptr); // may be oooHighSeqNr-oooLowSeqNr+1 instead
+		size += 2 * nReportedPackets;
+		ptr += 2 * nReportedPackets;
+		for (uint16_t k = 0; k < nReportedPackets; k++) {
 			uint16_t sn = sn_lo + k;
-
-			uint16_t ix = sn % kRxHistorySize;
-			uint32_t ato = (time_ntp - rxTimeHist[ix]);
-			ato = ato >> 6; // Q16->Q10
-			if (ato > 8189)
-				ato = 0x1FFE;
-
-			tmp_s = 0x0000;
-			if (seqNrHist[ix] == sn && rxTimeHist[ix] != 0) {
-				tmp_s = 0x8000 | ((ceBitsHist[ix] & 0x03) << 13) | (ato & 0x01FFF);;
-			}
-
-			tmp_s = htons(tmp_s);
-			memcpy(buf + ptr, &tmp_s, 2);
-			size += 2;
-			ptr += 2;
-			isOooHist[ix] = false;
-
+			isOooHist[sn % kRxHistorySize] = false;
 		}
 
 		/*
@@ -74,6 +74,14 @@ public:
 			int& size);
 
 
+		/*
+		* Encode n report elements, starting with sn_lo, from the history
+		*/
+		void encodeReports(uint32_t time_ntp,
+			uint16_t sn_lo,
+			int n,
+			unsigned char* buf);
+
 		uint32_t ssrc;                       // SSRC of stream (source SSRC)
 		uint32_t receiveTimestamp;           // Wall clock time
 		uint16_t highestSeqNr;               // Highest received sequence number
@@ -32,7 +32,8 @@ ScreamTx::Statistics::Statistics(ScreamTx* parent_) {
 	rateLostAcc = 0.0f;
 	rateCeAcc = 0.0f;
 	rateLostN = 0;
-	nStatisticsItems++;
+	sumQueueDelay = 0.0f;
+	nStatisticsItems = 0;
 	n00 = 0;
 	n10 = 0;
 	n01 = 0;
@@ -43,6 +44,44 @@ ScreamTx::Statistics::Statistics(ScreamTx* parent_) {
 		ceRateHist[n] = 0.0f;
 	}
 	lossRateHistPtr = 0;
+	maxStreamLatency = 4;
+	nStreamLatency = 0;
+	streamLatency = new StreamLatency*[maxStreamLatency];
+}
+
+ScreamTx::Statistics::~Statistics() {
+	for (int n = 0; n < nStreamLatency; n++)
+		delete streamLatency[n];
+	delete[] streamLatency;
+}
+
+int ScreamTx::Statistics::addStream(uint32_t ssrc) {
+	for (int n = 0; n < nStreamLatency; n++) {
+		if (streamLatency[n]->ssrc == ssrc)
+			return n;
+	}
+	if (nStreamLatency == maxStreamLatency) {
+		StreamLatency** tmp = new StreamLatency*[2 * maxStreamLatency];
+		for (int n = 0; n < nStreamLatency; n++)
+			tmp[n] = streamLatency[n];
+		delete[] streamLatency;
+		streamLatency = tmp;
+		maxStreamLatency *= 2;
+	}
+	StreamLatency* tmp = new StreamLatency();
+	tmp->ssrc = ssrc;
+	streamLatency[nStreamLatency] = tmp;
+	return nStreamLatency++;
+}
+
+LatencyHistogram* ScreamTx::Statistics::getLatencyHistogram(LatencyItem item, uint32_t ssrc) {
+	if (ssrc == 0)
+		return &latency[item];
+	for (int n = 0; n < nStreamLatency; n++) {
+		if (streamLatency[n]->ssrc == ssrc)
+			return &streamLatency[n]->latency[item];
+	}
+	return NULL;
 }
 
 void ScreamTx::Statistics::add(uint32_t time_ntp, float rateTx, float rateLost, float rateCe, float rtt, float queueDelay) {
@@ -136,9 +175,30 @@ void ScreamTx::Statistics::printFinalSummary() {
 		100.0f * float(n10) / tmp,
 		100.0f * float(n01) / tmp,
 		100.0f * float(n11) / tmp);
+	printLatency(" RTT", latency[LAT_RTT]);
+	printLatency(" Queue delay", latency[LAT_QUEUE_DELAY]);
+	printLatency(" RTP queue delay", latency[LAT_RTP_QUEUE_DELAY]);
+	printLatency(" Frame delivery", latency[LAT_FRAME_DELIVERY]);
+	if (nStreamLatency > 1) {
+		for (int n = 0; n < nStreamLatency; n++) {
+			StreamLatency* tmp = streamLatency[n];
+			printf(" Stream SSRC %u\n", tmp->ssrc);
+			printLatency("   RTT", tmp->latency[LAT_RTT]);
+			printLatency("   Queue delay", tmp->latency[LAT_QUEUE_DELAY]);
+			printLatency("   RTP queue", tmp->latency[LAT_RTP_QUEUE_DELAY]);
+			printLatency("   Frame delivery", tmp->latency[LAT_FRAME_DELIVERY]);
+		}
+	}
 	printf("===========================================================\n");
 }
 
+void ScreamTx::Statistics::printLatency(const char* name, LatencyHistogram& h) {
+	char s[100];
+	sprintf(s, "%s p50/99/99.9/max [s]", name);
+	printf("%-37s: %2.3f/%2.3f/%2.3f/%2.3f\n", s,
+		h.getPercentile(50.0f), h.getPercentile(99.0f), h.getPercentile(99.9f), h.getMax());
+}
+
 void ScreamTx::Statistics::getSummary(float time, char s[]) {
 	int tmp = std::max(1, nEcn);
 	sprintf(s, "%s summary %5.1f  Transmit rate = %5.0fkbps, PLR = %5.2f%%(%5.2f%%), CE = %5.2f%%(%5.2f%%)[%4.1f%%, %4.1f%%, %4.1f%%, %4.1f%%], RTT = %5.3fs, Queue delay = %5.3fs",
@@ -192,6 +252,15 @@ float ScreamTx::getStatisticsItem(StatisticsItem item) {
 	return statistics->getStatisticsItem(item);
 }
 
+float ScreamTx::getLatencyPercentile(LatencyItem item, float percentile, uint32_t ssrc) {
+	LatencyHistogram* h = statistics->getLatencyHistogram(item, ssrc);
+	return h == NULL ? 0.0f : h->getPercentile(percentile);
+}
+
+LatencyHistogram* ScreamTx::getLatencyHistogram(LatencyItem item, uint32_t ssrc) {
+	return statistics->getLatencyHistogram(item, ssrc);
+}
+
 void ScreamTx::printFinalSummary() {
 	statistics->printFinalSummary();
 }
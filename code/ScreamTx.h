@@ -9,6 +9,10 @@
 #include <math.h>
 #include <cmath>
 #include <cstdint>
+#include "TxList.h"
+#include "EventLog.h"
+#include "StatsShm.h"
+#include "LatencyHistogram.h"
 extern "C" {
 	/*
 	* This module implements the sender side of SCReAM,
@@ -81,16 +85,23 @@ extern "C" {
 
 	static const float ntp2SecScaleFactor = 1.0f / 65536;
 	static const uint32_t sec2NtpScaleFactor = 65536u;
+	/*
+	* The optional 64 bit time base is NTP time in Q32, i.e 1.0sec is represented by
+	*  the value 2^32. The Q16 time is the mid 32 bits, time_ntp = uint32_t(time_q32 >> 16)
+	*/
+	static const float q32ToSecScaleFactor = 1.0f / 4294967296.0f;
+	static const double secToQ32ScaleFactor = 4294967296.0;
 
 	/*
-	* Max number of RTP packets in flight
+	* Min size of the table of RTP packets in flight
 	* With an MSS = 1200 byte and an RTT = 50ms
-	* this is enough to support media bitrates up to ~800Mbps
-	* Note, 65536 % kMaxTxPackets must be zero
+	* this is enough to support media bitrates up to ~800Mbps,
+	* the table is made larger for streams with a higher max bitrate
 	*/
 	static const int kMaxTxPackets = 4096;
 	/*
-	* Max number of streams
+	* Initial capacity of the stream list, the list grows
+	*  when more streams are registered
 	*/
 	static const int kMaxStreams = 10;
 	/*
@@ -106,6 +117,10 @@ extern "C" {
 	static const int kRelFrameSizeHistBins = 50;
 	static const int kMaxBytesInFlightHistSize = 20;
 	static const int kMssListSize = 10;
+	/*
+	* Max number of discarded frames that are listed for getDiscardedFrames()
+	*/
+	static const int kMaxDiscardedFrames = 64;
 
 	enum StatisticsItem {
 		AVG_RATE,          // [bps]
@@ -117,6 +132,17 @@ extern "C" {
 		AVG_QUEUE_DELAY
 	}; // [s]
 
+	/*
+	* Latency histograms, see getLatencyPercentile
+	*/
+	enum LatencyItem {
+		LAT_RTT,             // RTT of ACKed packets [s]
+		LAT_QUEUE_DELAY,     // Estimated network queue delay [s]
+		LAT_RTP_QUEUE_DELAY, // RTP queue delay of ACKed packets [s]
+		LAT_FRAME_DELIVERY   // Frame delivery time [s], RTP queue delay + RTT of the last packet of a frame
+	};
+	static const int kLatencyItems = 4;
+
 	class ScreamTx {
 	public:
 		ScreamTx();
@@ -129,12 +155,42 @@ extern "C" {
 		class Statistics {
 		public:
 			Statistics(ScreamTx* parent);
+			~Statistics();
 			void getSummary(float time, char s[]);
 			void add(uint32_t time_ntp, float rateTx, float rateLost, float rateCe, float rtt, float queueDelay);
 			void addEcn(uint8_t ecn);
 			float getStatisticsItem(StatisticsItem item);
       void printFinalSummary();
+
+			/*
+			* Add a stream to the latency histograms, the returned index is given to
+			*  addLatency. A stream that is registered again with the same SSRC gets
+			*  the same histograms
+			*/
+			int addStream(uint32_t ssrc);
+			/*
+			* Add a value [s] to the histograms of the stream and the aggregate, O(1)
+			*/
+			void addLatency(int streamIx, LatencyItem item, float value) {
+				latency[item].add(value);
+				streamLatency[streamIx]->latency[item].add(value);
+			}
+			/*
+			* Histogram for the stream with the given SSRC, ssrc = 0 gives the
+			*  aggregate over all streams. NULL is returned for an unknown SSRC
+			*/
+			LatencyHistogram* getLatencyHistogram(LatencyItem item, uint32_t ssrc);
     private:
+			void printLatency(const char* name, LatencyHistogram& h);
+
+			struct StreamLatency {
+				uint32_t ssrc;
+				LatencyHistogram latency[kLatencyItems];
+			};
+			LatencyHistogram latency[kLatencyItems];
+			StreamLatency** streamLatency;
+			int nStreamLatency;
+			int maxStreamLatency;
      	float lossRateHist[kLossRateHistSize];
      	float ceRateHist[kLossRateHistSize];
      	float rateLostAcc;
@@ -179,6 +235,18 @@ extern "C" {
 		*/
 		float getStatisticsItem(StatisticsItem item);
 
+		/*
+		* Get the latency [s] at percentile [0..100] (e.g 99.9) for the stream
+		*  with the given SSRC, ssrc = 0 gives the aggregate over all streams
+		*/
+		float getLatencyPercentile(LatencyItem item, float percentile, uint32_t ssrc = 0);
+
+		/*
+		* Get a latency histogram, see getLatencyPercentile, NULL is returned for
+		*  an unknown SSRC
+		*/
+		LatencyHistogram* getLatencyHistogram(LatencyItem item, uint32_t ssrc = 0);
+
 		/*
 		* Print final summary on stdout
 		*/
@@ -236,7 +304,8 @@ extern "C" {
 		*  where 1.0 denotes the highest priority.
 		* It is recommended that at least one stream has prioritity 1.0.
 		* Bitrates are specified in bps
-		* maxRtpQueueDelay sets how long RTP packets can be held in buffer before entire buffer is cleared
+		* maxRtpQueueDelay sets how long RTP packets can be held in buffer before entire buffer is cleared,
+		*  or before the frame is discarded if enableFrameDiscard(true) is called
 		* isAdaptiveTargetRateScale compensates for deviations from target bitrates
 		* hysteresis sets how much the target rate should change for the getTargetBitrate() function to
 		*  return a changed value. hysteresis = 0.1 sets a +10%/-5% hysteresis.
@@ -255,6 +324,13 @@ extern "C" {
 			float hysteresis = 0.0,
 			bool enableFrameSizeOverhead=true);
 
+		/*
+		* Unregister the stream with SSRC, the packets of the stream that are in flight
+		*  are removed from bytes in flight. The RTP queue is owned by the caller and is not deleted
+		* Return false if no stream with SSRC is registered
+		*/
+		bool unregisterStream(uint32_t ssrc);
+
 		/*
 		* Updates the min and max bitrates for an existing stream
 		*/
@@ -300,6 +376,79 @@ extern "C" {
 			uint32_t timeStamp = 0
       );
 
+		/*
+		* Transmit budget for a burst of RTP packets, an alternative to one isOkToTransmit
+		*  and addTransmitted call per packet when RTP packets are sent in bursts,
+		*  for instance with sendmmsg or UDP GSO.
+		* The budget is up to nPackets RTP packets and nBytes bytes, the RTP packets are
+		*  dequeued in the order given by ssrcList[0..nPackets-1] and the burst ends
+		*  before the packet that makes the sum of the packet sizes exceed nBytes,
+		*  the first packet is always within the budget.
+		*  The number of packets is limited by maxPackets, by the congestion window and
+		*  by the packet pacing during interval [s] from time_ntp.
+		*  The scheduling between the streams follows the fair queueing scheduler when it is
+		*  enabled, otherwise the packets are taken from the stream that isOkToTransmit picks.
+		*  The sizes of other than the first RTP packet in each queue are estimated, this
+		*  can make ssrcList a little different from what isOkToTransmit would give.
+		* Return values as for isOkToTransmit, nPackets >= 1 when 0.0 is returned.
+		* addTransmittedBatch must be called for the packets that are transmitted
+		*/
+		float getTransmitBudget(uint32_t time_ntp,
+			float interval,
+			int maxPackets,
+			uint32_t* ssrcList,
+			int& nPackets,
+			int& nBytes);
+
+		/*
+		* Add n transmitted RTP packets, typically the burst given by getTransmitBudget
+		*  rtpQueueDelay and timeStamp may be NULL
+		* Return time until getTransmitBudget or isOkToTransmit can be called again
+		*/
+		float addTransmittedBatch(uint32_t time_ntp,
+			const uint32_t* ssrc,
+			const int* size,
+			const uint16_t* seqNr,
+			const bool* isMark,
+			const float* rtpQueueDelay,
+			const uint32_t* timeStamp,
+			int n);
+
+		/*
+		* Versions of isOkToTransmit, addTransmitted, getTransmitBudget and addTransmittedBatch
+		*  with a 64 bit time in Q32, see q32ToSecScaleFactor. The packet pacing is then
+		*  scheduled with sub-ns resolution and the min pacing interval is lowered to
+		*  kMinPaceIntervalHighRes, instead of the 15us steps of the Q16 time base which
+		*  makes the pacing burst at Gbps rates.
+		* The other functions take the Q16 time uint32_t(time_q32 >> 16) as before.
+		* The high resolution pacing is used once one of these functions is called
+		*/
+		float isOkToTransmitQ32(uint64_t time_q32, uint32_t& ssrc);
+
+		float addTransmittedQ32(uint64_t time_q32,
+			uint32_t ssrc,
+			int size,
+			uint16_t seqNr,
+			bool isMark,
+			float rtpQueueDelay = 0.0f,
+			uint32_t timeStamp = 0);
+
+		float getTransmitBudgetQ32(uint64_t time_q32,
+			float interval,
+			int maxPackets,
+			uint32_t* ssrcList,
+			int& nPackets,
+			int& nBytes);
+
+		float addTransmittedBatchQ32(uint64_t time_q32,
+			const uint32_t* ssrc,
+			const int* size,
+			const uint16_t* seqNr,
+			const bool* isMark,
+			const float* rtpQueueDelay,
+			const uint32_t* timeStamp,
+			int n);
+
 		/* New incoming feedback, this function
 		* triggers a CWND update
 		* The SCReAM timestamp is in jiffies, where the frequency is controlled
@@ -322,6 +471,19 @@ extern "C" {
 			uint16_t seqNr,
 			uint8_t ceBits,
 			bool isLast);
+
+		/*
+		* Incoming feedback for a batch of n received RTP packets of one stream,
+		*  isLast is true if the last packet in the batch is the last
+		*  one in the report block, this triggers the CWND update
+		*/
+		void incomingStandardizedFeedback(uint32_t time_ntp,
+			int streamId,
+			const uint32_t* timestamp,
+			const uint16_t* seqNr,
+			const uint8_t* ceBits,
+			int n,
+			bool isLast);
 		/*
 		* Get the target bitrate for stream with SSRC
 		* NOTE!, Because SCReAM operates on RTP packets, the target bitrate will
@@ -339,6 +501,48 @@ extern "C" {
 		*/
 		void setTargetPriority(uint32_t ssrc, float aPriority);
 
+		/*
+		* Enable/disable the fair queueing scheduler (default disabled)
+		* The streams are served with start time fair queueing, a stream gets a share of the
+		*  transmitted bytes that is proportional to its target priority when it has RTP packets
+		*  in queue. The next stream is picked in O(log n) time from a heap of the backlogged streams.
+		* When disabled, the credit based scheduler is used
+		*/
+		void enableFairQueueing(bool enable);
+
+		/*
+		* Put a stream in the strict priority class, the streams in this class are served
+		*  before the other streams whenever they have RTP packets in queue, the target priority
+		*  sets the shares within the class. Only applies with the fair queueing scheduler,
+		*  intended for low bitrate streams such as audio
+		*/
+		void setStrictPriority(uint32_t ssrc, bool isStrict);
+
+		/*
+		* Enable/disable frame granular RTP queue discard (default disabled)
+		* When enabled, whole frames are discarded from the head of the RTP queue when
+		*  they are older than maxRtpQueueDelay, instead of clearing the entire queue.
+		*  No new key frame is requested, the media coder should instead poll
+		*  getDiscardedFrames() and avoid references to the discarded frames.
+		*  Frames that are pushed to the RTP queue with isDiscardable = false, e.g key
+		*  frames, are not discarded, nor are the frames behind them. The entire queue is
+		*  then cleared only when the RTP queue delay exceeds 2*maxRtpQueueDelay.
+		*  RTP queues that do not implement discardFrames() are cleared at maxRtpQueueDelay
+		*  as when the function is disabled
+		*/
+		void enableFrameDiscard(bool enable) {
+			isEnableFrameDiscard = enable;
+		}
+
+		/*
+		* Get the RTP timestamps of the frames that are discarded from the RTP queue
+		*  since the last call, at most maxFrames are returned and the rest are kept
+		*  for the next call. The number of frames is returned.
+		* If more than kMaxDiscardedFrames frames are discarded without a call, the
+		*  overflowing frames are not listed and getTargetBitrate() signals a loss instead
+		*/
+		int getDiscardedFrames(uint32_t ssrc, uint32_t* timeStamps, int maxFrames);
+
 		/*
 		* Set maxTotalBitrate
 		* This featire is useful if it is known that for instance a cellular modem does not support a higher uplink bitrate
@@ -376,6 +580,13 @@ extern "C" {
 		*/
 		void getVeryShortLog(float time, char* s);
 
+		/*
+		* Get a structured statistics snapshot, this is cheaper than the string
+		*  logs above and does not reset any log state.
+		* At most kStatsMaxStreams streams are included
+		*/
+		void getStatsSnapshot(float time, StatsSnapshot& snapshot);
+
 		/*
 		* Set file pointer for detailed per-ACK log
 		*/
@@ -390,6 +601,14 @@ extern "C" {
 			fp_txrxlog = fp;
 		}
 
+		/*
+		* Set binary event log, the detailed log items and the TX and RX
+		*  timestamps are then also pushed to eventLog
+		*/
+		void setEventLog(EventLog* eventLog_) {
+			eventLog = eventLog_;
+		}
+
 		void setTimeString(char* s) {
 			strcpy(timeString, s);
 		}
@@ -399,12 +618,14 @@ extern "C" {
 		*/
 		void setDetailedLogExtraData(char* s) {
 			strcpy(detailedLogExtraData, s);
+			if (eventLog)
+				logExtraData();
 		}
 
 		/*
 		* Get the list of log items
 		*/
-		const char* getDetailedLogItemList() {
+		static const char* getDetailedLogItemList() {
 			return "\"Time [s]\",\"Estimated queue delay [s]\",\"RTT [s]\",\"Congestion window [byte]\",\"Bytes in flight [byte]\",\"Fast increase mode\",\"Total transmit bitrate [bps]\",\"Stream ID\",\"RTP SN\",\"Bytes newly ACKed\",\"Bytes newly ACKed and CE marked\",\"Media coder bitrate [bps]\",\"Transmitted bitrate [bps]\",\"ACKed bitrate [bps]\",\"Lost bitrate [bps]\",\"CE Marked bitrate [bps]\",\"Marker bit set\"";
 		}
 
@@ -522,21 +743,6 @@ extern "C" {
     } 
 
   private:
-		/*
-		* Struct for list of RTP packets in flight
-		*/
-    struct Transmitted {
-     	uint32_t timeTx_ntp;
-     	int size;
-     	uint16_t seqNr;
-     	uint32_t timeStamp;
-     	float rtpQueueDelay;
-     	bool isMark;
-     	bool isUsed;
-     	bool isAcked;
-     	bool isAfterReceivedEdge;
-   };
-
 		/*
 		* One instance is created for each {SSRC,PT} tuple
 
@@ -563,6 +769,8 @@ extern "C" {
       float hysteresis,
       bool enableFrameSizeOverhead);
 
+     ~Stream();
+
      	float getMaxRate();
 
      	float getTargetBitrate();
@@ -575,6 +783,21 @@ extern "C" {
 
      	bool isRtpQueueDiscard();
 
+			/*
+			* Discard the frames that are older than maxRtpQueueDelay from the head
+			*  of the RTP queue and list them for getDiscardedFrames(), the number
+			*  of discarded frames is returned, -1 if the RTP queue does not
+			*  implement discardFrames()
+			*/
+     	int discardStaleFrames(uint32_t time_ntp);
+
+			/*
+			* Extend an RTP sequence number, that is transmitted already, to 32 bit
+			*/
+     	uint32_t extendSeqNr(uint16_t seqNr) {
+     		return hiSeqTxExt - uint16_t(hiSeqTx - seqNr);
+     	}
+
      	bool isMatch(uint32_t ssrc_) { return ssrc == ssrc_; };
 
      	bool isLossEpoch();
@@ -616,6 +839,11 @@ extern "C" {
 			//  adjustPriorities function
 			float targetPriority;   // Stream target priority
 			float targetPriorityInv;// Stream target priority inverted
+			bool isStrictPriority;  // Strict priority class, see setStrictPriority
+			double fqFinishTag;     // Fair queueing virtual finish time of the last transmitted packet
+			int fqHeapIx;           // Index in the fair queueing heap, -1 = not in heap
+			double budgetFinishTag; // Copy of fqFinishTag and number of RTP packets, used by getTransmitBudget
+			int budgetPackets;
 			int bytesTransmitted;   // Number of bytes transmitted
 			int bytesAcked;         // Number of ACKed bytes
 			int bytesLost;          // Number of lost bytes
@@ -637,7 +865,7 @@ extern "C" {
 			uint32_t lastRateUpdateT_ntp;    // Last time rate estimate was updated
 			uint32_t lastTargetBitrateIUpdateT_ntp;    // Last time rate estimate was updated
 
-			uint32_t timeTxAck_ntp;  // timestamp when higest ACKed SN was transmitted
+			uint32_t timeTxAck_ntp;  // timestamp when the last sent of the ACKed packets was transmitted
 			uint32_t timeStampAckHigh; // Highest ACKed timestamp
 			uint32_t lastTransmitT_ntp;
 
@@ -659,10 +887,22 @@ extern "C" {
 			bool repairLoss;
 			uint32_t lastFullWindowT_ntp;
 
-			Transmitted txPackets[kMaxTxPackets];
-			int txPacketsPtr;
+			TxList* txList;         // RTP packets in flight
+			/*
+			* The packets in flight are in send order from lossSeqNr, the packets
+			*  before ackEdgeSeqNr are removed from bytes in flight and are
+			*  either ACKed or candidates for loss detection.
+			* The sequence numbers are extended to 32 bit, see extendSeqNr()
+			*/
+			bool isSeqNrInit;        // hiSeqTxExt, ackEdgeSeqNr and lossSeqNr are initialized
+			uint32_t hiSeqTxExt;     // Highest sequence number transmitted, extended
+			uint32_t ackEdgeSeqNr;   // Highest ACKed sequence number + 1
+			uint32_t lossSeqNr;      // Oldest packet not yet ACKed or declared lost
+			uint32_t lossTimerT_ntp; // Reorder timer for the packet given by lossSeqNr, 0 = not armed
 			bool lossEpoch;
 			uint64_t cleared;
+			uint32_t discardedFrames[kMaxDiscardedFrames]; // RTP timestamps of discarded frames
+			int nDiscardedFrames;
 
 			int frameSize;
 			int frameSizeAcc;
@@ -681,6 +921,8 @@ extern "C" {
 			bool isMaxrate;
 
 			float rtpQueueDelay;
+
+			int statisticsIx;       // Index of the latency histograms in statistics
 		};
 
 		/*
@@ -688,12 +930,18 @@ extern "C" {
 		*/
 		void initialize(uint32_t time_ntp);
 
+		/*
+		* Extend time_ntp to the 64 bit time base, relative to currTime_q32.
+		*  currTime_q32 is returned as is if it is in the same Q16 tick, this keeps the
+		*  fraction given to the Q32 functions
+		*/
+		uint64_t extendTime(uint32_t time_ntp);
+
 		/*
 		* Mark ACKed RTP packets
 		* Return true if CE
 		*/
 		bool markAcked(uint32_t time_ntp,
-			struct Transmitted* txPackets,
 			uint16_t seqNr,
 			uint32_t timestamp,
 			Stream* stream,
@@ -723,15 +971,43 @@ extern "C" {
 		float getTotalTransmittedBitrate();
 
 
+		/*
+		* Update the congestion state and CWND at the end of a report block
+		*/
+		void updateCongestionState(uint32_t time_ntp);
+
+		/*
+		* Write the detailed log item for an acknowledged packet
+		*/
+		void logFeedback(int streamId, uint16_t seqNr, bool isMark);
+
+		/*
+		* Push the TX and RX time of an ACKed or lost packet to the event log
+		*/
+		void logTxRx(uint16_t seqNr, uint32_t timeTx_ntp, uint32_t timeRx_ntp, uint32_t owd_ntp, bool isLost);
+
+		/*
+		* Push the detailed log extra data to the event log
+		*/
+		void logExtraData();
+
 		/*
 		* Update CWND
 		*/
 		void updateCwnd(uint32_t time_ntp);
 
 		/*
-		* Detect lost RTP packets
+		* Remove the packets up to and including seqNrExt from bytes in flight,
+		*  called when seqNrExt is ACKed
+		*/
+		void advanceAckEdge(Stream* stream, uint32_t seqNrExt);
+
+		/*
+		* Detect lost RTP packets, the packets before the ACK edge are resolved
+		*  in send order until a packet is found that is neither ACKed nor lost
+		*  given the reordering time, the reorder timer is armed for this packet
 		*/
-		void detectLoss(uint32_t time_ntp, struct Transmitted* txPackets, uint16_t highestSeqNr, Stream* stream);
+		void detectLoss(uint32_t time_ntp, Stream* stream);
 
 		/*
 		* Call this function at regular intervals to determine active streams
@@ -764,6 +1040,11 @@ extern "C" {
 		*/
 		Stream* getStream(uint32_t ssrc, int& streamId);
 
+		/*
+		* Rebuild the SSRC hash table from the stream list
+		*/
+		void rebuildSsrcHash();
+
 		/*
 		* Get the prioritized stream
 		*  Return NULL if no stream with
@@ -771,6 +1052,34 @@ extern "C" {
 		*/
 		Stream* getPrioritizedStream(uint32_t time_ntp);
 
+		/*
+		* Fair queueing heap of backlogged streams, ordered by strict priority class
+		*  and virtual finish time
+		*/
+		bool fqIsBefore(Stream* a, Stream* b);
+		void fqPush(Stream* stream);
+		void fqRemove(Stream* stream);
+		void fqSiftUp(int ix);
+		void fqSiftDown(int ix);
+		void fqRebuild();
+
+		/*
+		* Book keeping for one transmitted RTP packet, common to addTransmitted
+		*  and addTransmittedBatch
+		*/
+		void addTransmittedPacket(uint32_t time_ntp,
+			Stream* stream,
+			int size,
+			uint16_t seqNr,
+			bool isMark,
+			float rtpQueueDelay,
+			uint32_t timeStamp);
+
+		/*
+		* Update the virtual time and the finish time of the served stream
+		*/
+		void fqTransmitted(Stream* servedStream, int transmittedBytes);
+
 		/*
 		* Add credit to unserved streams
 		*/
@@ -831,6 +1140,7 @@ extern "C" {
 		bool enableRateUpdate;
 		bool isUseExtraDetailedLog;
 		bool isEnableRelaxedPacing;
+		bool isEnableFrameDiscard;
 
 		float sRtt;
 		float sRttSh;
@@ -923,8 +1233,10 @@ extern "C" {
 		float relFrameSizeHigh;
 		bool isNewFrame;
 
-		uint32_t paceInterval_ntp;
+		uint64_t paceInterval_q32;
 		float paceInterval;
+		bool isHighResolutionTime; // Set when the Q32 functions are used
+		uint64_t currTime_q32;     // Time given to the last isOkToTransmit or addTransmitted call
 		float adaptivePacingRateScale;
 
 		uint32_t baseOwdHist[kBaseOwdHistSize];
@@ -938,12 +1250,33 @@ extern "C" {
 		uint32_t clockDriftCompensation;
 		uint32_t clockDriftCompensationInc;
 
-		Stream* streams[kMaxStreams];
+		/*
+		* Registered streams in registration order, the streams are looked up
+		*  by SSRC in a hash table with linear probing. An entry holds the
+		*  index in streams + 1, 0 is an empty entry
+		*/
+		Stream** streams;
 		int nStreams;
+		int maxStreams;
+		int* ssrcHash;
+		uint32_t ssrcHashMask;
+
+		/*
+		* Fair queueing scheduler state, the virtual time is in byte/priority
+		*  per class, index 1 is the strict priority class
+		*/
+		bool isEnableFairQueueing;
+		Stream** fqHeap;
+		int nFqHeap;
+		double fqVirtualTime[2];
+		uint32_t lastFqRebuildT_ntp;
 
 		FILE* fp_log;
 		FILE* fp_txrxlog;
+		EventLog* eventLog;
 		bool completeLogItem;
+		float logQueueDelay; // Queue delay and RTT [s] of the detailed log item that is completed in logFeedback
+		float logRtt;
 		char timeString[100];
 		char detailedLogExtraData[256];
 
@@ -959,7 +1292,7 @@ extern "C" {
 		uint32_t lastLossEventT_ntp;
 		uint32_t lastCeEventT_ntp;
 		uint32_t lastTransmitT_ntp;
-		uint32_t nextTransmitT_ntp;
+		uint64_t nextTransmitT_q32;
 
 		uint32_t lastRateUpdateT_ntp;
 		uint32_t lastCwndUpdateT_ntp;
@@ -970,6 +1303,13 @@ extern "C" {
 		uint32_t lastBaseDelayRefreshT_ntp;
 		uint32_t lastRateLimitT_ntp;
 		uint32_t lastMssChange_ntp;
+		uint32_t lastFeedbackLogT_ntp;
+
+		/*
+		* Number of acknowledgements in the last feedback
+		*  that did not match a packet in flight
+		*/
+		uint32_t nUnusedAcks;
 	};
 }
 #endif
@@ -1,5 +1,6 @@
 #include "RtpQueue.h"
 #include "ScreamTx.h"
+#include "CcfbCodec.h"
 #ifdef _WIN32
 #define NOMINMAX
 #include <winSock2.h>
@@ -18,6 +19,8 @@ static const uint32_t kRateAdjustInterval_ntp = 1311; // 20ms in NTP domain
 // ==== Less important tuning parameters ====
 // Min pacing interval and min pacing rate
 static const float kMinPaceInterval = 10e-6f;
+// Min pacing interval with the Q32 time base, ~100Gbps with 1200 byte packets
+static const float kMinPaceIntervalHighRes = 0.1e-6f;
 // Initial MSS, this is set quite low in order to make it possible to
 //  use SCReAM with audio only
 static const int kInitMss = 100;
@@ -61,6 +64,8 @@ static const float kSrttVirtual = 0.025f;
 
 // Min congestion backoff interval 1966 = 30ms in NTP time
 static const uint32_t kMinCongestionBackOffInterval_ntp = 1966u;
+// Min interval between rebuilds of an empty fair queueing heap
+static const uint32_t kFqRebuildInterval_ntp = 66; // 1ms in NTP domain
 
 // Time constant for CE dentity averaging
 static const float kCeDensityAlpha = 1.0f / 16;
@@ -92,6 +97,12 @@ static const float kMaxRelaxedPacingFactor = 5.0f;
 
 static const float kMinWindowHeadroom = 1.5f;
 
+// Unacked packets this far behind the highest ACK are lost regardless of the reordering time
+static const int kLossDetectWindow = 512;
+
+// Number of RFC 8888 report elements that are decoded at a time
+static const int kReportChunkSize = 256;
+
 static const int kQueueDelayMinSlowAvgUpdateRtts = 100;
 
 static const float kLatencyDiffAlpha = 1.0f/32;
@@ -138,6 +149,7 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
   enableRateUpdate(true),
   isUseExtraDetailedLog(false),
   isEnableRelaxedPacing(false),
+  isEnableFrameDiscard(false),
 
 	sRtt(0.05f), // Init SRTT to 50ms
 	sRttSh(0.05f),
@@ -228,8 +240,10 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
 	relFrameSizeHigh(1.0f),
 	isNewFrame(false),
 
-	paceInterval_ntp(0),
+	paceInterval_q32(0),
 	paceInterval(0.0f),
+	isHighResolutionTime(false),
+	currTime_q32(0),
 	adaptivePacingRateScale(1.0f),
 
 	baseOwdHistMin(UINT32_MAX),
@@ -240,11 +254,22 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
 	clockDriftCompensation(0),
 	clockDriftCompensationInc(0),
 
+	streams(0),
 	nStreams(0),
+	maxStreams(0),
+	ssrcHash(0),
+	ssrcHashMask(0),
+	isEnableFairQueueing(false),
+	fqHeap(0),
+	nFqHeap(0),
+	lastFqRebuildT_ntp(0),
 
 	fp_log(0),
 	fp_txrxlog(0),
+	eventLog(0),
 	completeLogItem(false),
+	logQueueDelay(0.0f),
+	logRtt(0.0f),
 
 	isInitialized(false),
 	initTime_ntp(0),
@@ -258,7 +283,7 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
 	lastLossEventT_ntp(0),
 	lastCeEventT_ntp(0),
 	lastTransmitT_ntp(0),
-	nextTransmitT_ntp(0),
+	nextTransmitT_q32(0),
 	lastRateUpdateT_ntp(0),
 	lastCwndUpdateT_ntp(0),
 	lastQueueDelayAvgUpdateT_ntp(0),
@@ -266,7 +291,9 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
 	lastL4sAlphaUpdateT_ntp(0),
 	lastBaseDelayRefreshT_ntp(0),
 	lastRateLimitT_ntp(0),
-	lastMssChange_ntp(0)
+	lastMssChange_ntp(0),
+	lastFeedbackLogT_ntp(0),
+	nUnusedAcks(0)
   {
     strcpy(detailedLogExtraData, "");
     strcpy(timeString, "");
@@ -282,8 +309,14 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
       baseOwdHist[n] = UINT32_MAX;
     for (int n = 0; n < kQueueDelayNormHistSize; n++)
       queueDelayNormHist[n] = 0.0f;
-    for (int n = 0; n < kMaxStreams; n++)
+    maxStreams = kMaxStreams;
+    streams = new Stream*[maxStreams];
+    for (int n = 0; n < maxStreams; n++)
       streams[n] = NULL;
+    fqHeap = new Stream*[maxStreams];
+    fqVirtualTime[0] = 0.0;
+    fqVirtualTime[1] = 0.0;
+    rebuildSsrcHash();
     for (int n = 0; n < kMaxBytesInFlightHistSize; n++)
       maxBytesInFlightHist[n] = 0;
 
@@ -293,6 +326,9 @@ ScreamV2Tx::ScreamV2Tx(float lossBeta_,
 ScreamV2Tx::~ScreamV2Tx() {
 	for (int n = 0; n < nStreams; n++)
 		delete streams[n];
+	delete[] streams;
+	delete[] ssrcHash;
+	delete[] fqHeap;
 }
 
 
@@ -309,6 +345,29 @@ void ScreamV2Tx::registerNewStream(RtpQueueIface* rtpQueue,
 	bool isAdaptiveTargetRateScale,
 	float hysteresis,
 	bool enableFrameSizeOverhead) {
+	int id;
+	if (getStream(ssrc, id) != NULL) {
+		std::cerr << "ScreamV2Tx::registerNewStream SSRC " << ssrc << " is already registered" << std::endl;
+		return;
+	}
+	if (nStreams == maxStreams) {
+		/*
+		* Grow the stream list, the streams themselves are not moved
+		*/
+		Stream** tmp = new Stream*[2 * maxStreams];
+		for (int n = 0; n < maxStreams; n++)
+			tmp[n] = streams[n];
+		for (int n = maxStreams; n < 2 * maxStreams; n++)
+			tmp[n] = NULL;
+		delete[] streams;
+		streams = tmp;
+		Stream** tmpHeap = new Stream*[2 * maxStreams];
+		for (int n = 0; n < nFqHeap; n++)
+			tmpHeap[n] = fqHeap[n];
+		delete[] fqHeap;
+		fqHeap = tmpHeap;
+		maxStreams *= 2;
+	}
 	Stream* stream = new Stream(this,
 		rtpQueue,
 		ssrc,
@@ -321,6 +380,41 @@ void ScreamV2Tx::registerNewStream(RtpQueueIface* rtpQueue,
 		hysteresis,
 		enableFrameSizeOverhead);
 	streams[nStreams++] = stream;
+	rebuildSsrcHash();
+}
+
+bool ScreamV2Tx::unregisterStream(uint32_t ssrc) {
+	int id;
+	Stream* stream = getStream(ssrc, id);
+	if (stream == NULL)
+		return false;
+	/*
+	* Remove the packets of the stream that are in flight from bytes in flight
+	*/
+	TxList* txList = stream->txList;
+	if (stream->isSeqNrInit) {
+		uint32_t seqNrExt = stream->ackEdgeSeqNr;
+		if (stream->hiSeqTxExt + 1 - seqNrExt > uint32_t(txList->getSize()))
+			seqNrExt = stream->hiSeqTxExt + 1 - txList->getSize();
+		for (; seqNrExt != stream->hiSeqTxExt + 1; seqNrExt++) {
+			int ix = txList->getIx(seqNrExt);
+			if (txList->isInFlight(ix, seqNrExt) && !txList->isAfterReceivedEdge(ix))
+				bytesInFlight -= txList->packetSize[ix];
+		}
+		bytesInFlight = std::max(0, bytesInFlight);
+	}
+	if (stream->fqHeapIx >= 0)
+		fqRemove(stream);
+	delete stream;
+	/*
+	* The remaining streams keep their order
+	*/
+	for (int n = id; n < nStreams - 1; n++)
+		streams[n] = streams[n + 1];
+	nStreams--;
+	streams[nStreams] = NULL;
+	rebuildSsrcHash();
+	return true;
 }
 
 void ScreamV2Tx::updateBitrateStream(uint32_t ssrc,
@@ -330,6 +424,7 @@ void ScreamV2Tx::updateBitrateStream(uint32_t ssrc,
 	Stream* stream = getStream(ssrc, id);
 	stream->minBitrate = minBitrate;
 	stream->maxBitrate = maxBitrate;
+	stream->txList->resize(TxList::getSizeForBitrate(maxBitrate));
 }
 
 RtpQueueIface* ScreamV2Tx::getStreamQueue(uint32_t ssrc) {
@@ -355,6 +450,8 @@ void ScreamV2Tx::newMediaFrame(uint32_t time_ntp, uint32_t ssrc, int bytesRtp, b
 	Stream* stream = getStream(ssrc, id);
 
 	stream->newMediaFrame(time_ntp, bytesRtp, isMarker);
+	if (isEnableFairQueueing && stream->fqHeapIx < 0 && stream->rtpQueue->sizeOfQueue() > 0)
+		fqPush(stream);
 	stream->updateTargetBitrate(time_ntp);
 
 	if (time_ntp - lastBaseDelayRefreshT_ntp < sRtt_ntp * 2 && time_ntp > sRtt_ntp * 2) {
@@ -393,6 +490,7 @@ void ScreamV2Tx::newMediaFrame(uint32_t time_ntp, uint32_t ssrc, int bytesRtp, b
 * Determine if OK to transmit RTP packet
 */
 float ScreamV2Tx::isOkToTransmit(uint32_t time_ntp, uint32_t& ssrc) {
+	currTime_q32 = extendTime(time_ntp);
 	if (!isInitialized) initialize(time_ntp);
 	/*
 	* Update rate estimated
@@ -421,6 +519,15 @@ float ScreamV2Tx::isOkToTransmit(uint32_t time_ntp, uint32_t& ssrc) {
 
 	}
 
+	/*
+	* Loss detection for the streams where the reorder timer has expired
+	*/
+	for (int n = 0; n < nStreams; n++) {
+		uint32_t timerT_ntp = streams[n]->lossTimerT_ntp;
+		if (timerT_ntp != 0 && int32_t(time_ntp - timerT_ntp) >= 0)
+			detectLoss(time_ntp, streams[n]);
+	}
+
 	/*
 	* Get index to the prioritized RTP queue
 	*/
@@ -470,18 +577,19 @@ float ScreamV2Tx::isOkToTransmit(uint32_t time_ntp, uint32_t& ssrc) {
 	* Enforce packet pacing
 	*/
 	float retVal = 0.0f;
-	uint32_t tmp_l = nextTransmitT_ntp - time_ntp;
-	if (isEnablePacketPacing && (nextTransmitT_ntp > time_ntp) && (tmp_l < 0xFFFF0000)) {
-		retVal = (nextTransmitT_ntp - time_ntp) * ntp2SecScaleFactor;
+	int64_t tmp_l = int64_t(nextTransmitT_q32 - currTime_q32);
+	if (isEnablePacketPacing && tmp_l > 0) {
+		retVal = tmp_l * q32ToSecScaleFactor;
 	}
 
 	/*
 	* A retransmission time out mechanism to avoid deadlock
 	*/
 	if (time_ntp - lastTransmitT_ntp > 32768 && lastTransmitT_ntp < time_ntp) {
-		for (int n = 0; n < kMaxTxPackets; n++) {
-			stream->txPackets[n].isUsed = false;
-		}
+		stream->txList->clear();
+		stream->ackEdgeSeqNr = stream->hiSeqTxExt + 1;
+		stream->lossSeqNr = stream->ackEdgeSeqNr;
+		stream->lossTimerT_ntp = 0;
 		bytesInFlight = 0;
 		exit = false;
 		retVal = 0.0f;
@@ -507,24 +615,152 @@ float ScreamV2Tx::addTransmitted(uint32_t time_ntp,
 	bool isMark,
 	float rtpQueueDelay,
 	uint32_t timeStamp) {
+	currTime_q32 = extendTime(time_ntp);
 	if (!isInitialized)
 		initialize(time_ntp);
 
 	int id;
 	Stream* stream = getStream(ssrc, id);
+	addTransmittedPacket(time_ntp, stream, size, seqNr, isMark, rtpQueueDelay, timeStamp);
+
+	/*
+	* Update MSS and cwndMin
+	*/
+	mss = std::max(mss, size);
+	cwndMin = std::max(cwndMinLow, 2 * getMss());
+	cwnd = std::max(cwnd, cwndMin);
 
-	int ix = seqNr % kMaxTxPackets;
-	Transmitted* txPacket = &(stream->txPackets[ix]);
+	/*
+	* Determine when next RTP packet can be transmitted
+	*/
+	if (isEnablePacketPacing)
+		nextTransmitT_q32 = currTime_q32 + paceInterval_q32;
+	else
+		nextTransmitT_q32 = currTime_q32;
+	return paceInterval;
+}
+
+/*
+* A burst of RTP packets transmitted
+*/
+float ScreamV2Tx::addTransmittedBatch(uint32_t time_ntp,
+	const uint32_t* ssrc,
+	const int* size,
+	const uint16_t* seqNr,
+	const bool* isMark,
+	const float* rtpQueueDelay,
+	const uint32_t* timeStamp,
+	int n) {
+	currTime_q32 = extendTime(time_ntp);
+	if (!isInitialized)
+		initialize(time_ntp);
+	if (n <= 0)
+		return 0.0f;
+
+	int id;
+	Stream* stream = NULL;
+	for (int k = 0; k < n; k++) {
+		if (stream == NULL || stream->ssrc != ssrc[k])
+			stream = getStream(ssrc[k], id);
+		addTransmittedPacket(time_ntp, stream, size[k], seqNr[k], isMark[k],
+			rtpQueueDelay ? rtpQueueDelay[k] : 0.0f,
+			timeStamp ? timeStamp[k] : 0);
+		mss = std::max(mss, size[k]);
+	}
+	cwndMin = std::max(cwndMinLow, 2 * getMss());
+	cwnd = std::max(cwnd, cwndMin);
+
+	/*
+	* The next RTP packet can be transmitted when the pacing intervals of
+	*  the burst have passed
+	*/
+	if (isEnablePacketPacing) {
+		if (isHighResolutionTime)
+			nextTransmitT_q32 = currTime_q32 + uint64_t(n * double(paceInterval) * secToQ32ScaleFactor);
+		else
+			nextTransmitT_q32 = currTime_q32 + (uint64_t(uint32_t(n * paceInterval * 65536)) << 16);
+		return n * paceInterval;
+	}
+	nextTransmitT_q32 = currTime_q32;
+	return 0.0f;
+}
+
+float ScreamV2Tx::isOkToTransmitQ32(uint64_t time_q32, uint32_t& ssrc) {
+	isHighResolutionTime = true;
+	currTime_q32 = time_q32;
+	return isOkToTransmit(uint32_t(time_q32 >> 16), ssrc);
+}
+
+float ScreamV2Tx::addTransmittedQ32(uint64_t time_q32,
+	uint32_t ssrc,
+	int size,
+	uint16_t seqNr,
+	bool isMark,
+	float rtpQueueDelay,
+	uint32_t timeStamp) {
+	isHighResolutionTime = true;
+	currTime_q32 = time_q32;
+	return addTransmitted(uint32_t(time_q32 >> 16), ssrc, size, seqNr, isMark, rtpQueueDelay, timeStamp);
+}
+
+float ScreamV2Tx::getTransmitBudgetQ32(uint64_t time_q32,
+	float interval,
+	int maxPackets,
+	uint32_t* ssrcList,
+	int& nPackets,
+	int& nBytes) {
+	isHighResolutionTime = true;
+	currTime_q32 = time_q32;
+	return getTransmitBudget(uint32_t(time_q32 >> 16), interval, maxPackets, ssrcList, nPackets, nBytes);
+}
+
+float ScreamV2Tx::addTransmittedBatchQ32(uint64_t time_q32,
+	const uint32_t* ssrc,
+	const int* size,
+	const uint16_t* seqNr,
+	const bool* isMark,
+	const float* rtpQueueDelay,
+	const uint32_t* timeStamp,
+	int n) {
+	isHighResolutionTime = true;
+	currTime_q32 = time_q32;
+	return addTransmittedBatch(uint32_t(time_q32 >> 16), ssrc, size, seqNr, isMark, rtpQueueDelay, timeStamp, n);
+}
+
+uint64_t ScreamV2Tx::extendTime(uint32_t time_ntp) {
+	if (currTime_q32 == 0)
+		return uint64_t(time_ntp) << 16;
+	uint32_t currTime_ntp = uint32_t(currTime_q32 >> 16);
+	if (time_ntp == currTime_ntp)
+		return currTime_q32;
+	/*
+	* Wrap-around safe, time_ntp is within +/- 9h from currTime_q32
+	*/
+	int64_t diff = int32_t(time_ntp - currTime_ntp);
+	return uint64_t(int64_t(currTime_q32 >> 16) + diff) << 16;
+}
+
+void ScreamV2Tx::addTransmittedPacket(uint32_t time_ntp,
+	Stream* stream,
+	int size,
+	uint16_t seqNr,
+	bool isMark,
+	float rtpQueueDelay,
+	uint32_t timeStamp) {
+	if (!stream->isSeqNrInit) {
+		/*
+		* Start at 65536 so that sequence numbers before the first can be extended too
+		*/
+		stream->hiSeqTxExt = seqNr + 65536;
+		stream->ackEdgeSeqNr = stream->hiSeqTxExt;
+		stream->lossSeqNr = stream->hiSeqTxExt;
+		stream->isSeqNrInit = true;
+	}
+	else {
+		stream->hiSeqTxExt += int16_t(seqNr - stream->hiSeqTx);
+	}
 	stream->hiSeqTx = seqNr;
-	txPacket->timeTx_ntp = time_ntp;
-	txPacket->rtpQueueDelay = rtpQueueDelay;
-	txPacket->size = size;
-	txPacket->seqNr = seqNr;
-	txPacket->timeStamp = timeStamp;
-	txPacket->isMark = isMark;
-	txPacket->isUsed = true;
-	txPacket->isAcked = false;
-	txPacket->isAfterReceivedEdge = false;
+	stream->txList->add(stream->hiSeqTxExt, time_ntp, size, timeStamp, rtpQueueDelay, isMark);
 
 	/*
 	* Update bytesInFlight
@@ -535,34 +771,119 @@ float ScreamV2Tx::addTransmitted(uint32_t time_ntp,
 	stream->bytesTransmitted += size;
 	lastTransmitT_ntp = time_ntp;
 	stream->lastTransmitT_ntp = time_ntp;
+	if (isEnableFairQueueing) {
+		fqTransmitted(stream, size);
+	}
+	else {
+		/*
+		* Add credit to unserved streams
+		*/
+		addCredit(time_ntp, stream, size);
+		/*
+		* Reduce used credit for served stream
+		*/
+		subtractCredit(time_ntp, stream, size);
+	}
+}
+
+/*
+* Transmit budget for a burst of RTP packets
+*/
+float ScreamV2Tx::getTransmitBudget(uint32_t time_ntp,
+	float interval,
+	int maxPackets,
+	uint32_t* ssrcList,
+	int& nPackets,
+	int& nBytes) {
+	nPackets = 0;
+	nBytes = 0;
+	/*
+	* isOkToTransmit runs the periodic updates and decides if the first RTP packet can be transmitted
+	*/
+	uint32_t ssrc = 0;
+	float retVal = isOkToTransmit(time_ntp, ssrc);
+	if (retVal != 0.0f || maxPackets <= 0)
+		return retVal;
+
 	/*
-	* Add credit to unserved streams
+	* Bytes that the congestion window allows, the same condition as in isOkToTransmit
 	*/
-	addCredit(time_ntp, stream, size);
+	int windowBytes = int(cwnd * windowHeadroom) + getMss() - bytesInFlight;
 	/*
-	* Reduce used credit for served stream
+	* Packets that the packet pacing allows during interval
 	*/
-	subtractCredit(time_ntp, stream, size);
+	if (isEnablePacketPacing && paceInterval > 0.0f)
+		maxPackets = std::min(maxPackets, 1 + int(std::min(interval / paceInterval, 65536.0f)));
 
 	/*
-	* Update MSS and cwndMin
+	* The candidate streams, the stream picked by isOkToTransmit or the
+	*  backlogged streams in the fair queueing heap
 	*/
-	mss = std::max(mss, size);
-	cwndMin = std::max(cwndMinLow, 2 * getMss());
-	cwnd = std::max(cwnd, cwndMin);
+	int id;
+	Stream* first = getStream(ssrc, id);
+	Stream** candidates = &first;
+	int nCandidates = 1;
+	if (isEnableFairQueueing && nStreams > 1) {
+		candidates = fqHeap;
+		nCandidates = nFqHeap;
+	}
+	double virtualTime[2] = { fqVirtualTime[0], fqVirtualTime[1] };
+	int bytes = 0;
+	int firstSize = 0;
+	for (int n = 0; n < nCandidates; n++) {
+		candidates[n]->budgetFinishTag = candidates[n]->fqFinishTag;
+		candidates[n]->budgetPackets = 0;
+	}
 
+	while (nPackets < maxPackets) {
+		/*
+		* Pick the stream as fqTransmitted and getPrioritizedStream would do
+		*/
+		Stream* stream = NULL;
+		double minTag = 0.0;
+		for (int n = 0; n < nCandidates; n++) {
+			Stream* tmp = candidates[n];
+			if (tmp->budgetPackets >= tmp->rtpQueue->sizeOfQueue())
+				continue;
+			double tag = std::max(virtualTime[tmp->isStrictPriority], tmp->budgetFinishTag);
+			bool isBefore = stream == NULL;
+			if (!isBefore && tmp->isStrictPriority != stream->isStrictPriority)
+				isBefore = tmp->isStrictPriority;
+			else if (!isBefore)
+				isBefore = tag < minTag;
+			if (isBefore) {
+				stream = tmp;
+				minTag = tag;
+			}
+		}
+		if (stream == NULL)
+			break;
+		RtpQueueIface* rtpQueue = stream->rtpQueue;
+		int size = rtpQueue->sizeOfNextRtp();
+		if (stream->budgetPackets > 0) {
+			/*
+			* Average size of the RTP packets after the first
+			*/
+			size = (rtpQueue->bytesInQueue() - size) / (rtpQueue->sizeOfQueue() - 1);
+		}
+		if (nPackets > 0 && bytes + size > windowBytes)
+			break;
+		if (nPackets == 0)
+			firstSize = size;
+		ssrcList[nPackets++] = stream->ssrc;
+		bytes += size;
+		stream->budgetPackets++;
+		virtualTime[stream->isStrictPriority] = minTag;
+		stream->budgetFinishTag = minTag + size * stream->targetPriorityInv;
+	}
 	/*
-	* Determine when next RTP packet can be transmitted
+	* The byte budget is what the congestion window allows, the first RTP packet is
+	*  always allowed as isOkToTransmit returned 0.0
 	*/
-	if (isEnablePacketPacing)
-		nextTransmitT_ntp = time_ntp + paceInterval_ntp;
-	else
-		nextTransmitT_ntp = time_ntp;
-	return paceInterval;
+	nBytes = std::max(windowBytes, firstSize);
+	return 0.0f;
 }
 
-static uint32_t    unused;
-static uint32_t time_ntp_prev = 0;
 void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 	unsigned char* buf,
 	int size) {
@@ -621,9 +942,13 @@ void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 		Stream* stream = getStream(ssrc, streamId);
 		if (stream == 0) {
 			/*
-			* Bogus RTCP?, the SSRC is wrong anyway, Skip
+			* Bogus RTCP? or the stream is unregistered, skip the report block
+			*  of this SSRC including the zero padding
 			*/
-			return;
+			ptr += 2 * num_reports + 2 * (num_reports % 2);
+			if (ptr > size - 4)
+				return;
+			continue;
 		}
 
 		uint16_t diff = end_seq - stream->hiSeqAck;
@@ -644,28 +969,74 @@ void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 		uint16_t nRx = 0;
 		uint16_t first = 0;
 		uint16_t last = 0;
-		unused = 0;
-		for (int n = 0; n <= N; n++) {
-			uint16_t sn = begin_seq + n;
-			uint16_t tmp_s;
-			memcpy(&tmp_s, buf + ptr, 2);
-			tmp_s = ntohs(tmp_s);
-			ptr += 2;
-			bool isRx = ((tmp_s & 0x8000) == 0x8000);
-			if (isRx) {
-				if (first == 0) {
-					first = n;
+		nUnusedAcks = 0;
+		/*
+		* The report elements are decoded in chunks of kReportChunkSize
+		*  and the packets that are newly acknowledged are collected in a batch.
+		*  Packets that are already acknowledged, or not in flight, are skipped
+		*  unless they are the last in the report block
+		*/
+		uint8_t isRx[kReportChunkSize];
+		uint8_t ceBits[kReportChunkSize];
+		uint32_t rxTime[kReportChunkSize];
+		uint16_t batchSeqNr[kReportChunkSize];
+		uint8_t batchCeBits[kReportChunkSize];
+		uint32_t batchRxTime[kReportChunkSize];
+		TxList* txList = stream->txList;
+		bool isLast = false;
+		bool isBatched = false;
+		for (int n0 = 0; n0 <= N; n0 += kReportChunkSize) {
+			int nChunk = std::min(N + 1 - n0, kReportChunkSize);
+			CcfbCodec::decodeReports(rts, buf + ptr, nChunk, isRx, ceBits, rxTime);
+			ptr += 2 * nChunk;
+			uint16_t nRxChunk = nRx;
+			int nBatch = 0;
+			for (int k = 0; k < nChunk; k++) {
+				if (isRx[k]) {
+					int n = n0 + k;
+					if (first == 0) {
+						first = n;
+					}
+					last = n;
+					nRx++;
+					/*
+					* packet indicated as being received
+					*/
+					uint16_t sn = begin_seq + n;
+					isLast = n == N;
+					bool isSkip = false;
+					if (!isLast && !isUseExtraDetailedLog) {
+						uint32_t snExt = stream->extendSeqNr(sn);
+						int ix = txList->getIx(snExt);
+						if (!txList->isUsed(ix)) {
+							nUnusedAcks++;
+							isSkip = true;
+						}
+						else if (txList->seqNr[ix] != snExt || txList->isAcked(ix)) {
+							isSkip = true;
+						}
+					}
+					if (isSkip) {
+						if (!isBatched) {
+							/*
+							* The min and max queue delay averages are updated with the current
+							*  queue delay as for the packets in the batch, this has effect only
+							*  before the first packet in the report block is newly acknowledged
+							*/
+							queueDelayMinAvg = std::min(queueDelayMinAvg, queueDelay);
+							queueDelayMaxAvg = std::min(queueDelayTarget, std::max(queueDelayMaxAvg, queueDelay));
+						}
+						continue;
+					}
+					isBatched = true;
+					batchSeqNr[nBatch] = sn;
+					batchCeBits[nBatch] = ceBits[k];
+					batchRxTime[nBatch] = rxTime[k];
+					nBatch++;
 				}
-				last = n;
-				nRx++;
-				/*
-				* packet indicated as being received
-				*/
-				uint8_t ceBits = (tmp_s & 0x6FFF) >> 13;
-				uint32_t rxTime = (tmp_s & 0x1FFF) << 6; // Q10->Q16
-				rxTime = rts - rxTime;
-				incomingStandardizedFeedback(time_ntp, streamId, rxTime, sn, ceBits, n == N);
 			}
+			if (nRx != nRxChunk)
+				incomingStandardizedFeedback(time_ntp, streamId, batchRxTime, batchSeqNr, batchCeBits, nBatch, isLast);
 		}
 		if (isUseExtraDetailedLog) {
 			time_ntp = time_ntp;
@@ -674,10 +1045,10 @@ void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 			int pak_diff = (Last == -1) ? -1 : ((Last >= stream->hiSeqTx) ? (Last - stream->hiSeqTx) : Last + 0xffff - stream->hiSeqTx);
 			printf("%s diff %d %6u %u beg_seq %u num_reps %u end_seq %u nRx %u unused %u sQ %d first %u last %u NrNext %d Last %d hiSeqTx %u hiSeqAck %u packetsRtp %lu rtpQueueDelay %f sRtt %f\n",
 				logTag, pak_diff,
-				time_ntp - time_ntp_prev, time_ntp, begin_seq, num_reports, end_seq, nRx, unused, size_before,
+				time_ntp - lastFeedbackLogT_ntp, time_ntp, begin_seq, num_reports, end_seq, nRx, nUnusedAcks, size_before,
 				first, last, stream->rtpQueue->seqNrOfNextRtp(), Last,
 				stream->hiSeqTx, stream->hiSeqAck, stream->packetsRtp, rtpQueueDelay, sRtt);
-			time_ntp_prev = time_ntp;
+			lastFeedbackLogT_ntp = time_ntp;
 		}
 		/*
 		* Skip zeropadded two octets if odd number of octets reported for this SSRC
@@ -689,7 +1060,7 @@ void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 }
 
 /*
-* New incoming feedback
+* New incoming feedback for one received RTP packet
 */
 void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 	int streamId,
@@ -697,253 +1068,347 @@ void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
 	uint16_t seqNr,
 	uint8_t ceBits,
 	bool isLast) {
+	incomingStandardizedFeedback(time_ntp, streamId, &timestamp, &seqNr, &ceBits, 1, isLast);
+}
+
+/*
+* New incoming feedback for a batch of received RTP packets
+*/
+void ScreamV2Tx::incomingStandardizedFeedback(uint32_t time_ntp,
+	int streamId,
+	const uint32_t* timestamp,
+	const uint16_t* seqNr,
+	const uint8_t* ceBits,
+	int n,
+	bool isLastBatch) {
 
 	Stream* stream = streams[streamId];
-	Transmitted* txPackets = stream->txPackets;
-	completeLogItem = false;
-	prevBytesInFlight = bytesInFlight;
 	maxBytesInFlight = std::max(bytesInFlight, maxBytesInFlight);
 
+	for (int k = 0; k < n; k++) {
+		bool isLast = isLastBatch && k == n - 1;
+		completeLogItem = false;
+		if (isLast)
+			prevBytesInFlight = bytesInFlight;
+		/*
+		* Mark received packets, given by the ACK vector
+		*/
+		bool isMark = false;
+		isCeThisFeedback |= markAcked(time_ntp, seqNr[k], timestamp[k], stream, ceBits[k], ecnCeMarkedBytesLog, isLast, isMark);
+		queueDelayMinAvg = std::min(queueDelayMinAvg, queueDelay);
+		queueDelayMaxAvg = std::min(queueDelayTarget, std::max(queueDelayMaxAvg, queueDelay));
+		if (isLast) {
+			/*
+			* Detect lost packets
+			*/
+			detectLoss(time_ntp, stream);
+			updateCongestionState(time_ntp);
+		}
 
-	/*
-	* Mark received packets, given by the ACK vector
-	*/
-	bool isMark = false;
-	isCeThisFeedback |= markAcked(time_ntp, txPackets, seqNr, timestamp, stream, ceBits, ecnCeMarkedBytesLog, isLast, isMark);
-	/*
-	* Detect lost packets
-	*/
-	if (isUseExtraDetailedLog || isLast || isMark) {
-		detectLoss(time_ntp, txPackets, seqNr, stream);
-	}
-
-	queueDelayMinAvg = std::min(queueDelayMinAvg, queueDelay);
-	queueDelayMaxAvg = std::min(queueDelayTarget, std::max(queueDelayMaxAvg, queueDelay));
-	if (isLast) {
-		if (time_ntp - lastLossEventT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp)) { // CE event at least every 30ms
-			if (isCeThisFeedback) {
-				ecnCeEvent = true;
-				lastLossEventT_ntp = time_ntp;
-				lastCeEventT_ntp = time_ntp;
-			}
+		if (isUseExtraDetailedLog || isLast || isMark) {
+			logFeedback(streamId, seqNr[k], isMark);
 		}
+	}
+	if (!isLastBatch) {
+		detectLoss(time_ntp, stream);
+	}
+}
 
-		if (!isEnablePacketPacing) {
-			/*
-			* The CE density is a metric of the fraction of updated RTCP
-			* feedback that indicates CE marking when congestion occurs
-			* This scales down the CE mark fraction when packet pacing
-			* is disabled
-			*
-			*/
-			if (isCeThisFeedback)
-				ceDensity += kCeDensityAlpha;
-			ceDensity *= 1.0f - kCeDensityAlpha;
-			ceDensity = std::max(0.25f, ceDensity);
+/*
+* Update of the congestion state and CWND, done once per report block
+*/
+void ScreamV2Tx::updateCongestionState(uint32_t time_ntp) {
+	if (time_ntp - lastLossEventT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp)) { // CE event at least every 30ms
+		if (isCeThisFeedback) {
+			ecnCeEvent = true;
+			lastLossEventT_ntp = time_ntp;
+			lastCeEventT_ntp = time_ntp;
 		}
+	}
 
-		isCeThisFeedback = false;
-		if (isL4s) {
-			/*
-			* L4S mode compute a congestion scaling factor that is dependent on the fraction
-			* of ECN marked packets
-			*/
-			if (time_ntp - lastL4sAlphaUpdateT_ntp > std::min(655u, sRtt_ntp)) { // Update at least every 10ms
-				lastL4sAlphaUpdateT_ntp = time_ntp;
-				fractionMarked = 0.0f;
-				if (bytesDeliveredThisRtt > 0) {
-					fractionMarked = float(packetsMarkedThisRtt) / float(packetsDeliveredThisRtt);
-					
-					if (fractionMarked == 1.0f) {
-						/*
-						* Likely a fast reduction in throughput, reset ceDensity
-						* so that CWND is reduced properly
-						*/
-						ceDensity = 1.0;
-					}
+	if (!isEnablePacketPacing) {
+		/*
+		* The CE density is a metric of the fraction of updated RTCP
+		* feedback that indicates CE marking when congestion occurs
+		* This scales down the CE mark fraction when packet pacing
+		* is disabled
+		*
+		*/
+		if (isCeThisFeedback)
+			ceDensity += kCeDensityAlpha;
+		ceDensity *= 1.0f - kCeDensityAlpha;
+		ceDensity = std::max(0.25f, ceDensity);
+	}
 
+	isCeThisFeedback = false;
+	if (isL4s) {
+		/*
+		* L4S mode compute a congestion scaling factor that is dependent on the fraction
+		* of ECN marked packets
+		*/
+		if (time_ntp - lastL4sAlphaUpdateT_ntp > std::min(655u, sRtt_ntp)) { // Update at least every 10ms
+			lastL4sAlphaUpdateT_ntp = time_ntp;
+			fractionMarked = 0.0f;
+			if (bytesDeliveredThisRtt > 0) {
+				fractionMarked = float(packetsMarkedThisRtt) / float(packetsDeliveredThisRtt);
+				
+				if (fractionMarked == 1.0f) {
 					/*
-					* Scale down fractionMarked if packet pacing is disabled
+					* Likely a fast reduction in throughput, reset ceDensity
+					* so that CWND is reduced properly
 					*/
-					fractionMarked *= ceDensity;
+					ceDensity = 1.0;
+				}
 
-					/*
-					* L4S alpha (backoff factor) is averaged and limited
-					* It can make sense to limit the backoff because
-					*   1) source is rate limited
-					*   2) delay estimation algorithm also works in parallel
-					*   3) L4S marking algorithm can lag behind a little and potentially overmark
-					*/
+				/*
+				* Scale down fractionMarked if packet pacing is disabled
+				*/
+				fractionMarked *= ceDensity;
 
-					if (fractionMarked >= l4sAlpha) {
-						l4sAlpha = std::min(kL4sAlphaMax, kL4sGUp * fractionMarked + (1.0f - kL4sGUp) * l4sAlpha);
-					} else {
-						/*
-						* Slow decay
-						*/
-						l4sAlpha *= (1.0 - kL4sGDown);
-					}
-					
+				/*
+				* L4S alpha (backoff factor) is averaged and limited
+				* It can make sense to limit the backoff because
+				*   1) source is rate limited
+				*   2) delay estimation algorithm also works in parallel
+				*   3) L4S marking algorithm can lag behind a little and potentially overmark
+				*/
 
-					bytesDeliveredThisRtt = 0;
-					bytesMarkedThisRtt = 0;
-					packetsDeliveredThisRtt = 0;
-					packetsMarkedThisRtt = 0;
-					lastFractionMarked = fractionMarked;
+				if (fractionMarked >= l4sAlpha) {
+					l4sAlpha = std::min(kL4sAlphaMax, kL4sGUp * fractionMarked + (1.0f - kL4sGUp) * l4sAlpha);
+				} else {
+					/*
+					* Slow decay
+					*/
+					l4sAlpha *= (1.0 - kL4sGDown);
 				}
+				
+
+				bytesDeliveredThisRtt = 0;
+				bytesMarkedThisRtt = 0;
+				packetsDeliveredThisRtt = 0;
+				packetsMarkedThisRtt = 0;
+				lastFractionMarked = fractionMarked;
 			}
-		} else {
-			l4sAlpha = 0.0f;
 		}
+	} else {
+		l4sAlpha = 0.0f;
+	}
 
-		if (time_ntp - lastQueueDelayAvgUpdateT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp)) {
+	if (time_ntp - lastQueueDelayAvgUpdateT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp)) {
 
 
-      /*
-      * Update a long term average of the min queue delay. This is used to take clock drift into account
-      * and also to be able to reset the queue delay history if clock drift becomes too large
-      */
-      if (time_ntp - lastQueueDelayMinSlowAvgUpdateT_ntp > sRtt_ntp*kQueueDelayMinSlowAvgUpdateRtts) {
-        if (queueDelayMin < queueDelayMinSlowAvg) {
-          queueDelayMinSlowAvg = queueDelayMin;
-        } else {
-          queueDelayMinSlowAvg = kQueueDelayMinSlowAvgAlpha * queueDelayMin + (1.0f-kQueueDelayMinSlowAvgAlpha) * queueDelayMinSlowAvg;
-        }
-        queueDelayMin = 1000.0;
-        lastQueueDelayMinSlowAvgUpdateT_ntp = time_ntp;
+    /*
+    * Update a long term average of the min queue delay. This is used to take clock drift into account
+    * and also to be able to reset the queue delay history if clock drift becomes too large
+    */
+    if (time_ntp - lastQueueDelayMinSlowAvgUpdateT_ntp > sRtt_ntp*kQueueDelayMinSlowAvgUpdateRtts) {
+      if (queueDelayMin < queueDelayMinSlowAvg) {
+        queueDelayMinSlowAvg = queueDelayMin;
+      } else {
+        queueDelayMinSlowAvg = kQueueDelayMinSlowAvgAlpha * queueDelayMin + (1.0f-kQueueDelayMinSlowAvgAlpha) * queueDelayMinSlowAvg;
       }
+      queueDelayMin = 1000.0;
+      lastQueueDelayMinSlowAvgUpdateT_ntp = time_ntp;
+    }
 
-			/*
-      * Compute a more slowly varying queue delay estimate
-      */
-      float tmp = queueDelay-queueDelayMinSlowAvg;
-      if (tmp < queueDelayAvg) {
-        queueDelayAvg = tmp;
-      }
-      else {
-        queueDelayAvg = (1.0f - kQueueDelayAvgAlpha) * queueDelayAvg + kQueueDelayAvgAlpha * tmp;
-      }
+		/*
+    * Compute a more slowly varying queue delay estimate
+    */
+    float tmp = queueDelay-queueDelayMinSlowAvg;
+    if (tmp < queueDelayAvg) {
+      queueDelayAvg = tmp;
+    }
+    else {
+      queueDelayAvg = (1.0f - kQueueDelayAvgAlpha) * queueDelayAvg + kQueueDelayAvgAlpha * tmp;
+    }
 
-			/*
-			* Calculate the restriction on bytes in flight and the increase of the cwnd based on
-			* the difference between max and min queue delay.
-			*/
-      float packetLatencyDiff = std::max(0.0f, 
-      	std::min(2.0f * kLatencyDiffThreshold, queueDelayMaxAvg-queueDelayMinAvg));
+		/*
+		* Calculate the restriction on bytes in flight and the increase of the cwnd based on
+		* the difference between max and min queue delay.
+		*/
+    float packetLatencyDiff = std::max(0.0f, 
+    	std::min(2.0f * kLatencyDiffThreshold, queueDelayMaxAvg-queueDelayMinAvg));
 
-      latencyDiffAvg = (1.0f-kLatencyDiffAlpha)*latencyDiffAvg + 
-  			kLatencyDiffAlpha*packetLatencyDiff;
-				
-      latencyDiffCwndScale = std::min(1.0f, std::max(0.0f, 1.0f - latencyDiffAvg/kLatencyDiffThreshold));
+    latencyDiffAvg = (1.0f-kLatencyDiffAlpha)*latencyDiffAvg + 
+			kLatencyDiffAlpha*packetLatencyDiff;
+			
+    latencyDiffCwndScale = std::min(1.0f, std::max(0.0f, 1.0f - latencyDiffAvg/kLatencyDiffThreshold));
+
+    /*
+    * Max average queue delay targets zero while min average queue delay 
+    * targets the max average queue delay. This makes the difference robust against 
+    * clock drift and increases the robustness against scheduling delay jitter somewhat
+    */
+    queueDelayMaxAvg *= (1.0f-kQueueDelayMinMaxAlpha);
+    queueDelayMinAvg = (1.0f-kQueueDelayMinMaxAlpha) * queueDelayMinAvg +
+    kQueueDelayMinMaxAlpha * queueDelayMaxAvg;
 
-      /*
-      * Max average queue delay targets zero while min average queue delay 
-      * targets the max average queue delay. This makes the difference robust against 
-      * clock drift and increases the robustness against scheduling delay jitter somewhat
-      */
-      queueDelayMaxAvg *= (1.0f-kQueueDelayMinMaxAlpha);
-      queueDelayMinAvg = (1.0f-kQueueDelayMinMaxAlpha) * queueDelayMinAvg +
-      kQueueDelayMinMaxAlpha * queueDelayMaxAvg;
 
+    /*
+    * Increase maxPolicedCwnd with a time constant of 1000RTTs
+    */
+    maxPolicedCwnd *= 1.001;
 
-      /*
-      * Increase maxPolicedCwnd with a time constant of 1000RTTs
-      */
-      maxPolicedCwnd *= 1.001;
+    lastQueueDelayAvgUpdateT_ntp = time_ntp;
+  }
 
-      lastQueueDelayAvgUpdateT_ntp = time_ntp;
-    }
+	/*
+	* This code fakes ECN-CE events when either ECN or L4S is not enabled or in case packets are not
+	* marked in the network
+	* The l4sAlphaLim condition is to avoid to use this when we are reasonable sure
+	* that packets are L4S marked. The reason is that the queue delay can sometimes suffer from issues with
+	* clock drift
+	* Use the average queue delay to avoid over reaction to lower later retransmissions
+	*/
 
+  if (queueDelayAvg > queueDelayTarget / 2.0f &&
+    time_ntp - lastLossEventT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp)) {
+    virtualCeEvent = true;
 		/*
-		* This code fakes ECN-CE events when either ECN or L4S is not enabled or in case packets are not
-		* marked in the network
-		* The l4sAlphaLim condition is to avoid to use this when we are reasonable sure
-		* that packets are L4S marked. The reason is that the queue delay can sometimes suffer from issues with
-		* clock drift
-		* Use the average queue delay to avoid over reaction to lower later retransmissions
+		 * A virtual L4S alpha is calculated based on the estimated queue delay
+		 * Virtual L4S marking sets in with increased back-off as soon as the queue delay
+		 * exceeds queueDelayTarget/2. With a queueDelayTarget=60ms this gives a 30ms margin
+		 * against clock drift and clock skipping errors
+		 * Allow up to 4 times higher virtual marking rate than the reference l4sAlphaLim 
+		 */
+    virtualL4sAlpha = std::min(1.0f, std::max(0.0f, (queueDelayAvg - queueDelayTarget / 2.0f) / (queueDelayTarget / 2.0f)));
+		/*
+		* Scale down backoff when sRtt is large as backoff happens every several times per RTT 
 		*/
+    virtualL4sAlpha /= std::max(1.0f, float(sRtt_ntp) / kMinCongestionBackOffInterval_ntp);
+  }
 
-    if (queueDelayAvg > queueDelayTarget / 2.0f &&
-      time_ntp - lastLossEventT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp)) {
-      virtualCeEvent = true;
-			/*
-			 * A virtual L4S alpha is calculated based on the estimated queue delay
-			 * Virtual L4S marking sets in with increased back-off as soon as the queue delay
-			 * exceeds queueDelayTarget/2. With a queueDelayTarget=60ms this gives a 30ms margin
-			 * against clock drift and clock skipping errors
-			 * Allow up to 4 times higher virtual marking rate than the reference l4sAlphaLim 
-			 */
-      virtualL4sAlpha = std::min(1.0f, std::max(0.0f, (queueDelayAvg - queueDelayTarget / 2.0f) / (queueDelayTarget / 2.0f)));
-			/*
-			* Scale down backoff when sRtt is large as backoff happens every several times per RTT 
-			*/
-      virtualL4sAlpha /= std::max(1.0f, float(sRtt_ntp) / kMinCongestionBackOffInterval_ntp);
-    }
-
-    if (sRttShPrev_ntp > sRttSh_ntp && fractionMarked == 1.0f) {
-			/*
-			* L4S marking may have too high marking thresholds, the result is that queues
-			* can become large that CE marking stays too long. This inhibits CE marking if the RTT reduces, which 
-			* is a reasonably safe sign that queues begin to deplete
-			*/
-      ecnCeEvent = false;
-    }
+  if (sRttShPrev_ntp > sRttSh_ntp && fractionMarked == 1.0f) {
+		/*
+		* L4S marking may have too high marking thresholds, the result is that queues
+		* can become large that CE marking stays too long. This inhibits CE marking if the RTT reduces, which 
+		* is a reasonably safe sign that queues begin to deplete
+		*/
+    ecnCeEvent = false;
+  }
 
-    if (lossEvent || ecnCeEvent || virtualCeEvent) {
-      lastLossEventT_ntp = time_ntp;
-    }
+  if (lossEvent || ecnCeEvent || virtualCeEvent) {
+    lastLossEventT_ntp = time_ntp;
+  }
 
-    if (lastCwndUpdateT_ntp == 0)
-      lastCwndUpdateT_ntp = time_ntp;
+  if (lastCwndUpdateT_ntp == 0)
+    lastCwndUpdateT_ntp = time_ntp;
 
-    if (time_ntp - lastCwndUpdateT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp) ||
-        lossEvent || ecnCeEvent || virtualCeEvent || isNewFrame) {
-			/*
-			* There is no gain with a too frequent CWND update
-			* An update every 10ms is fast enough even at very high high bitrates
-			* Expections are loss or CE events
-			* or when a new frame arrives, in which case the packet pacing rate needs an update
-			*/
-      bytesInFlightRatio = std::min(1.0f, float(prevBytesInFlight) / cwnd);
+  if (time_ntp - lastCwndUpdateT_ntp > std::min(kMinCongestionBackOffInterval_ntp, sRtt_ntp) ||
+      lossEvent || ecnCeEvent || virtualCeEvent || isNewFrame) {
+		/*
+		* There is no gain with a too frequent CWND update
+		* An update every 10ms is fast enough even at very high high bitrates
+		* Expections are loss or CE events
+		* or when a new frame arrives, in which case the packet pacing rate needs an update
+		*/
+    bytesInFlightRatio = std::min(1.0f, float(prevBytesInFlight) / cwnd);
 
-      updateCwnd(time_ntp);
-      for (int n = 0; n < nStreams; n++) {
-        Stream* tmp = streams[n];
-        tmp->updateTargetBitrate(time_ntp);
-      }
-      ecnCeEvent = false;
-      virtualCeEvent = false;
-      lastCwndUpdateT_ntp = time_ntp;
-      isNewFrame = false;
+    updateCwnd(time_ntp);
+    for (int n = 0; n < nStreams; n++) {
+      Stream* tmp = streams[n];
+      tmp->updateTargetBitrate(time_ntp);
     }
-
+    ecnCeEvent = false;
+    virtualCeEvent = false;
+    lastCwndUpdateT_ntp = time_ntp;
+    isNewFrame = false;
   }
 
-  float time = time_ntp * ntp2SecScaleFactor;
+}
 
-  if (isUseExtraDetailedLog || isLast || isMark) {
-    if (fp_log && completeLogItem) {			
-      fprintf(fp_log, " %d,%d,%d,%1.0f,%d,%d,%d,%d,%1.0f,%1.0f,%1.0f,%1.0f,%1.0f,%d,%1.0f,%3.3f, %d",
-        cwnd, bytesInFlight, 0, rateTransmittedAvg, streamId, seqNr, bytesNewlyAckedLog, ecnCeMarkedBytesLog,
-        stream->rateRtpAvg, stream->rateTransmittedAvg, stream->rateAcked, stream->rateLost, stream->rateCe,
+/*
+* Write the detailed log item for an acknowledged packet
+*/
+void ScreamV2Tx::logFeedback(int streamId, uint16_t seqNr, bool isMark) {
+	Stream* stream = streams[streamId];
+	if ((fp_log || eventLog) && completeLogItem) {
+		if (fp_log) {
+			fprintf(fp_log, " %d,%d,%d,%1.0f,%d,%d,%d,%d,%1.0f,%1.0f,%1.0f,%1.0f,%1.0f,%d,%1.0f,%3.3f, %d",
+				cwnd, bytesInFlight, 0, rateTransmittedAvg, streamId, seqNr, bytesNewlyAckedLog, ecnCeMarkedBytesLog,
+				stream->rateRtpAvg, stream->rateTransmittedAvg, stream->rateAcked, stream->rateLost, stream->rateCe,
 				isMark, stream->targetBitrate, stream->rtpQueueDelay, cwndI); //rtpQueue->getDelay(time));
-      if (strlen(detailedLogExtraData) > 0) {
-        fprintf(fp_log, ",%s", detailedLogExtraData);
-      }
-      bytesNewlyAckedLog = 0;
-      ecnCeMarkedBytesLog = 0;
-    }
-    if (fp_log && completeLogItem) {
-      fprintf(fp_log, "\n");
-    }
-  }
+			if (strlen(detailedLogExtraData) > 0) {
+				fprintf(fp_log, ",%s", detailedLogExtraData);
+			}
+			fprintf(fp_log, "\n");
+		}
+		if (eventLog) {
+			EventLogRecord record;
+			memset(&record, 0, sizeof(record));
+			record.type = kEventLogDetailed;
+			record.isMark = isMark;
+			record.seqNr = seqNr;
+			strncpy(record.timeString, timeString, kEventLogTimeStringSize - 1);
+			record.timeString[kEventLogTimeStringSize - 1] = 0;
+			EventLogDetailed& d = record.u.detailed;
+			d.queueDelay = logQueueDelay;
+			d.rtt = logRtt;
+			d.cwnd = cwnd;
+			d.bytesInFlight = bytesInFlight;
+			d.rateTransmittedAvg = rateTransmittedAvg;
+			d.streamId = streamId;
+			d.bytesNewlyAcked = bytesNewlyAckedLog;
+			d.ecnCeMarkedBytes = ecnCeMarkedBytesLog;
+			d.rateRtp = stream->rateRtpAvg;
+			d.rateTransmitted = stream->rateTransmittedAvg;
+			d.rateAcked = stream->rateAcked;
+			d.rateLost = stream->rateLost;
+			d.rateCe = stream->rateCe;
+			d.targetBitrate = stream->targetBitrate;
+			d.rtpQueueDelay = stream->rtpQueueDelay;
+			d.cwndI = cwndI;
+			eventLog->push(record);
+		}
+		bytesNewlyAckedLog = 0;
+		ecnCeMarkedBytesLog = 0;
+	}
+}
+
+void ScreamV2Tx::logTxRx(uint16_t seqNr, uint32_t timeTx_ntp, uint32_t timeRx_ntp, uint32_t owd_ntp, bool isLost) {
+	EventLogRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = isLost ? kEventLogTxRxLost : kEventLogTxRx;
+	record.seqNr = seqNr;
+	strncpy(record.timeString, timeString, kEventLogTimeStringSize - 1);
+	record.timeString[kEventLogTimeStringSize - 1] = 0;
+	record.u.txRx.timeTx_ntp = timeTx_ntp;
+	record.u.txRx.timeRx_ntp = timeRx_ntp;
+	record.u.txRx.owd_ntp = owd_ntp;
+	eventLog->push(record);
+}
+
+void ScreamV2Tx::logExtraData() {
+	/*
+	* The extra data is split over as many records as needed, the last
+	*  record is never full so that the end of the string is seen, an empty
+	*  string gives one record. The records are pushed together so that
+	*  a full ring never leaves a part of the string in the log
+	*/
+	const int kMaxRecords = sizeof(detailedLogExtraData) / (kEventLogExtraDataSize - 1) + 1;
+	EventLogRecord records[kMaxRecords];
+	memset(records, 0, sizeof(records));
+	int len = strlen(detailedLogExtraData);
+	int offset = 0;
+	int nRecords = 0;
+	int n;
+	do {
+		EventLogRecord& record = records[nRecords];
+		n = std::min(len - offset, kEventLogExtraDataSize - 1);
+		record.type = kEventLogExtraData;
+		record.seqNr = nRecords;
+		memcpy(record.u.extraData, detailedLogExtraData + offset, n);
+		record.u.extraData[n] = 0;
+		nRecords++;
+		offset += n;
+	} while (n == kEventLogExtraDataSize - 1 && nRecords < kMaxRecords);
+	eventLog->push(records, nRecords);
 }
 
 /*
 *  Mark ACKed RTP packets
 */
 bool ScreamV2Tx::markAcked(uint32_t time_ntp,
-	struct Transmitted* txPackets,
 	uint16_t seqNr,
 	uint32_t timestamp,
 	Stream* stream,
@@ -953,44 +1418,48 @@ bool ScreamV2Tx::markAcked(uint32_t time_ntp,
 	bool& isMark) {
 
 	bool isCe = false;
-	int ix = seqNr % kMaxTxPackets;
-	if (txPackets[ix].isUsed) {
+	TxList* txList = stream->txList;
+	uint32_t seqNrExt = stream->extendSeqNr(seqNr);
+	int ix = txList->getIx(seqNrExt);
+	if (txList->isUsed(ix)) {
 		/*
 		* RTP packet is in flight
 		*/
-		Transmitted* tmp = &txPackets[ix];
+		int size = txList->packetSize[ix];
+		uint32_t timeTx_ntp = txList->timeTx_ntp[ix];
 
 		/*
 		* Receiption of packet given by seqNr
 		*/
-		if ((tmp->seqNr == seqNr) && !tmp->isAcked) {
-			bytesDeliveredThisRtt += tmp->size;
+		if ((txList->seqNr[ix] == seqNrExt) && !txList->isAcked(ix)) {
+			bytesDeliveredThisRtt += size;
 			packetsDeliveredThisRtt += 1;
-			isMark = tmp->isMark;
+			isMark = txList->isMark(ix);
 			statistics->addEcn(ceBits);
 			if (ceBits == 0x03) {
 				/*
 				* Packet was CE marked, increase counter
 				*/
-				bytesNewlyAckedCe += tmp->size;
-				encCeMarkedBytesLog += tmp->size;
-				bytesMarkedThisRtt += tmp->size;
+				bytesNewlyAckedCe += size;
+				encCeMarkedBytesLog += size;
+				bytesMarkedThisRtt += size;
 				packetsMarkedThisRtt += 1;
-				stream->bytesCe += tmp->size;
+				stream->bytesCe += size;
 				stream->packetsCe++;
 				isCe = true;
 			}
 			/*
 			* Wrap-around safe update of timeStampAckHigh 
 			*/
-			uint32_t diff = tmp->timeStamp - stream->timeStampAckHigh;
+			uint32_t diff = txList->timeStamp[ix] - stream->timeStampAckHigh;
 			if (diff < 50000) {
-				stream->timeStampAckHigh = tmp->timeStamp;
+				stream->timeStampAckHigh = txList->timeStamp[ix];
 			}
 
-			stream->rtpQueueDelay = tmp->rtpQueueDelay;
-			tmp->isAcked = true;
-			ackedOwd = timestamp - tmp->timeTx_ntp;
+			stream->rtpQueueDelay = txList->rtpQueueDelay[ix];
+			txList->setAcked(ix, true);
+			advanceAckEdge(stream, seqNrExt);
+			ackedOwd = timestamp - timeTx_ntp;
 
 			if (fp_txrxlog) {
 				/*
@@ -998,13 +1467,15 @@ bool ScreamV2Tx::markAcked(uint32_t time_ntp,
 				* single precision (float) issues
 				*/ 
 				fprintf(fp_txrxlog, "%s, %d, %d.%04d, %d.%04d, %d.%04d\n", timeString, seqNr,
-         tmp->timeTx_ntp >> 16,
-         uint32_t((tmp->timeTx_ntp & 0xFFFF)*ntp2SecScaleFactor*10000+0.5),
+         timeTx_ntp >> 16,
+         uint32_t((timeTx_ntp & 0xFFFF)*ntp2SecScaleFactor*10000+0.5),
          timestamp >> 16, 
          uint32_t((timestamp & 0xFFFF)*ntp2SecScaleFactor*10000+0.5),
          ackedOwd >> 16,
          uint32_t((ackedOwd & 0xFFFF)*ntp2SecScaleFactor*10000+0.5));
       }
+			if (eventLog)
+				logTxRx(seqNr, timeTx_ntp, timestamp, ackedOwd, false);
 
 			/*
 			* Compute the queue delay i NTP domain (Q16)
@@ -1057,11 +1528,25 @@ bool ScreamV2Tx::markAcked(uint32_t time_ntp,
       }
 
 
-      uint32_t rtt = time_ntp - tmp->timeTx_ntp;
+      uint32_t rtt = time_ntp - timeTx_ntp;
       currRtt = rtt*ntp2SecScaleFactor;
 
-      if (fp_log && (isUseExtraDetailedLog || isLast || isMark)) {
-        fprintf(fp_log, "%s,%1.4f,%1.4f,", timeString, queueDelay, rtt * ntp2SecScaleFactor);
+			/*
+			* Latency histograms, the frame delivery time is the time from the last
+			*  packet of a frame is enqueued until it is ACKed
+			*/
+			float rtpQueueDelay = txList->rtpQueueDelay[ix];
+			statistics->addLatency(stream->statisticsIx, LAT_RTT, currRtt);
+			statistics->addLatency(stream->statisticsIx, LAT_QUEUE_DELAY, queueDelay);
+			statistics->addLatency(stream->statisticsIx, LAT_RTP_QUEUE_DELAY, rtpQueueDelay);
+			if (isMark)
+				statistics->addLatency(stream->statisticsIx, LAT_FRAME_DELIVERY, rtpQueueDelay + currRtt);
+
+      if ((fp_log || eventLog) && (isUseExtraDetailedLog || isLast || isMark)) {
+        if (fp_log)
+          fprintf(fp_log, "%s,%1.4f,%1.4f,", timeString, queueDelay, rtt * ntp2SecScaleFactor);
+        logQueueDelay = queueDelay;
+        logRtt = rtt * ntp2SecScaleFactor;
         completeLogItem = true;
       }
 
@@ -1087,137 +1572,130 @@ bool ScreamV2Tx::markAcked(uint32_t time_ntp,
           lastSRttUpdateT_ntp = time_ntp;
         }
       }
-      stream->timeTxAck_ntp = tmp->timeTx_ntp;
+      if (stream->timeTxAck_ntp == 0 || int32_t(timeTx_ntp - stream->timeTxAck_ntp) > 0)
+        stream->timeTxAck_ntp = timeTx_ntp;
     }
   }
   else {
-    unused++;
+    nUnusedAcks++;
   }
   return isCe;
 }
 
 
 /*
-* Detect lost RTP packets
+* Remove ACKed packets from bytes in flight
 */
-void ScreamV2Tx::detectLoss(uint32_t time_ntp, struct Transmitted* txPackets, uint16_t highestSeqNr, Stream* stream) {
-	/*
-	* Loop only through the packets that are covered by the last highest ACK - 512, this saves complexity
-	* There is a faint possibility that we miss to detect large bursts of lost packets with this fix
-	*/
-	int ix1 = highestSeqNr; 
-	ix1 = ix1 % kMaxTxPackets;
-	int ix0 = stream->hiSeqAck;
-	ix0 = ix0 % kMaxTxPackets;
-	ix0 -= 512;
-	int diff = std::min(uint16_t(32),uint16_t(highestSeqNr - stream->hiSeqAck));
-
-	if (ix0 < 0) ix0 += kMaxTxPackets;
-	int ixL0 = ix0-diff;
-	if (ixL0 < 0) {
-		ixL0 += kMaxTxPackets;
-		ix0 += kMaxTxPackets;
+void ScreamV2Tx::advanceAckEdge(Stream* stream, uint32_t seqNrExt) {
+	int32_t n = seqNrExt + 1 - stream->ackEdgeSeqNr;
+	if (n < 0) {
+		/*
+		* seqNrExt is behind the ACK edge, i.e an out of order ACK
+		*/
+		return;
 	}
-	while (ix1 < ix0) {
-		ix1 += kMaxTxPackets;
+	TxList* txList = stream->txList;
+	if (n > txList->getSize()) {
+		stream->ackEdgeSeqNr = seqNrExt + 1 - txList->getSize();
 	}
-	stream->hiSeqAck = highestSeqNr;
-
-	/*
-	* Mark unacked packets outside window as lost forever
-	*/
-	for (int m = ixL0; m < ix0; m++) {
-		int n = m % kMaxTxPackets;
-		if (txPackets[n].isUsed) {
-			Transmitted* tmp = &txPackets[n];
-			if (!tmp->isAcked) {
-				if (time_ntp - lastLossEventT_ntp > sRtt_ntp && lossBeta < 1.0f) {
-					setLossEvent();
-				}
-				if (fp_txrxlog) {
-         fprintf(fp_txrxlog, "%s, %d, %d.%04d, -1.0, -1.0\n", timeString, tmp->seqNr,
-           tmp->timeTx_ntp >> 16,
-           uint32_t((tmp->timeTx_ntp & 0xFFFF)*ntp2SecScaleFactor*10000+0.5));
-        }
-
-        stream->bytesLost += tmp->size;
-        stream->packetLost++;
-        tmp->isUsed = false;
-        stream->repairLoss = true;
-        calculateLossRate(true);
-      }
-      tmp->isUsed = false;
-    }
-  }
-
-	/*
-	* Mark late packets as lost
-	*/
-  for (int m = ix0; m <= ix1; m++) {
-    int n = m % kMaxTxPackets;
+	while (stream->ackEdgeSeqNr != seqNrExt + 1) {
+		int ix = txList->getIx(stream->ackEdgeSeqNr);
 		/*
-		* Loop through TX packets
+		* RTP packets with a sequence number lower
+		* than or equal to the highest received sequence number
+		* are treated as received even though they are not
+		* This advances the send window, similar to what
+		* SACK does in TCP
 		*/
-    if (txPackets[n].isUsed) {
-      Transmitted* tmp = &txPackets[n];
-			/*
-			* RTP packet is in flight
-			*/
-			/*
-			* Wrap-around safety net
-			*/
-      uint32_t seqNrExt = tmp->seqNr;
-      uint32_t highestSeqNrExt = highestSeqNr;
-      if (seqNrExt < highestSeqNrExt && highestSeqNrExt - seqNrExt > 20000)
-        seqNrExt += 65536;
-      else if (seqNrExt > highestSeqNrExt && seqNrExt - highestSeqNrExt > 20000)
-        highestSeqNrExt += 65536;
+		if (txList->isInFlight(ix, stream->ackEdgeSeqNr) && !txList->isAfterReceivedEdge(ix)) {
+			int size = txList->packetSize[ix];
+			bytesNewlyAcked += size;
+			bytesNewlyAckedLog += size;
+			bytesInFlight -= size;
+			if (bytesInFlight < 0)
+				bytesInFlight = 0;
+			stream->bytesAcked += size;
+			txList->setAfterReceivedEdge(ix, true);
+		}
+		stream->ackEdgeSeqNr++;
+	}
+	stream->hiSeqAck = uint16_t(seqNrExt);
+}
 
-			/*
-			* RTP packets with a sequence number lower
-			* than or equal to the highest received sequence number
-			* are treated as received even though they are not
-			* This advances the send window, similar to what
-			* SACK does in TCP
-			*/
-      if (seqNrExt <= highestSeqNrExt && tmp->isAfterReceivedEdge == false) {
-        bytesNewlyAcked += tmp->size;
-        bytesNewlyAckedLog += tmp->size;
-        bytesInFlight -= tmp->size;
-        if (bytesInFlight < 0)
-          bytesInFlight = 0;
-        stream->bytesAcked += tmp->size;
-        tmp->isAfterReceivedEdge = true;
-      }
+/*
+* Detect lost RTP packets
+*/
+void ScreamV2Tx::detectLoss(uint32_t time_ntp, Stream* stream) {
+	TxList* txList = stream->txList;
+	stream->lossTimerT_ntp = 0;
+	if (stream->ackEdgeSeqNr - stream->lossSeqNr > uint32_t(txList->getSize())) {
+		/*
+		* The slots of older packets are reused already
+		*/
+		stream->lossSeqNr = stream->ackEdgeSeqNr - txList->getSize();
+	}
 
-			/*
-			* Determine if RTP packet is ACKed beyond the allowed reording delay, or just lost
-			* It is necessary to compensate for that the transmission events jump because of periodic video frames
-			* the tsDiffCorrection makes a reference to transmission of earlier frames with same timestamp
-			* to determine if a packet is lost.
-			*/
-      uint32_t tsDiffCorrection = (uint32_t)(65536.0f * (stream->timeStampAckHigh - tmp->timeStamp) / stream->timeStampClockRate);
-      if (tmp->timeTx_ntp + reorderTime_ntp + tsDiffCorrection < stream->timeTxAck_ntp && !tmp->isAcked) {
+	while (stream->lossSeqNr != stream->ackEdgeSeqNr) {
+		int ix = txList->getIx(stream->lossSeqNr);
+		if (txList->isInFlight(ix, stream->lossSeqNr)) {
+			if (txList->isAcked(ix)) {
+				txList->setUsed(ix, false);
+				calculateLossRate(false);
+			}
+			else {
+				/*
+				* Determine if RTP packet is ACKed beyond the allowed reording delay, or just lost
+				* It is necessary to compensate for that the transmission events jump because of periodic video frames
+				* the tsDiffCorrection makes a reference to transmission of earlier frames with same timestamp
+				* to determine if a packet is lost.
+				*/
+				uint32_t tsDiff = stream->timeStampAckHigh - txList->timeStamp[ix];
+				uint32_t tsDiffCorrection = 0;
+				if (tsDiff < 0x80000000)
+					tsDiffCorrection = (uint32_t)(65536.0f * tsDiff / stream->timeStampClockRate);
+				uint32_t lossT_ntp = txList->timeTx_ntp[ix] + reorderTime_ntp + tsDiffCorrection;
 				/*
-				* Packet ACK is delayed more than reorderTime_ntp after an ACK of a higher SN packet, 
+				* Packet ACK is delayed more than reorderTime_ntp after an ACK of a later transmitted packet,
 				* compensated for timestamp jumps for new frames.
+				*/
+				bool isLost = int32_t(stream->timeTxAck_ntp - lossT_ntp) > 0;
+				/*
+				* Reorder timer, the ACK of a packet transmitted after lossT_ntp should
+				* have arrived within an RTT, an extra reordering time is allowed for the feedback interval
+				*/
+				uint32_t timerT_ntp = lossT_ntp + sRtt_ntp + reorderTime_ntp;
+				isLost |= int32_t(time_ntp - timerT_ntp) >= 0;
+				/*
+				* Packets far behind the highest ACK are lost regardless
+				*/
+				isLost |= stream->ackEdgeSeqNr - stream->lossSeqNr > uint32_t(kLossDetectWindow);
+				if (!isLost) {
+					stream->lossTimerT_ntp = std::max(1u, timerT_ntp);
+					break;
+				}
+				/*
 				* Raise a loss event and remove from TX list
 				*/
-        if (time_ntp - lastLossEventT_ntp > sRtt_ntp && lossBeta < 1.0f) {
-          setLossEvent();
-        }
-        stream->bytesLost += tmp->size;
-        stream->packetLost++;
-        tmp->isUsed = false;
-        stream->repairLoss = true;
-        calculateLossRate(true);
-      }
-      else if (tmp->isAcked) {
-        tmp->isUsed = false;
-        calculateLossRate(false);
-      }
-    }
-  }
+				if (time_ntp - lastLossEventT_ntp > sRtt_ntp && lossBeta < 1.0f) {
+					setLossEvent();
+				}
+				if (fp_txrxlog) {
+					uint32_t timeTx_ntp = txList->timeTx_ntp[ix];
+					fprintf(fp_txrxlog, "%s, %d, %d.%04d, -1.0, -1.0\n", timeString, uint16_t(txList->seqNr[ix]),
+						timeTx_ntp >> 16,
+						uint32_t((timeTx_ntp & 0xFFFF)*ntp2SecScaleFactor*10000+0.5));
+				}
+				if (eventLog)
+					logTxRx(uint16_t(txList->seqNr[ix]), txList->timeTx_ntp[ix], 0, 0, true);
+				stream->bytesLost += txList->packetSize[ix];
+				stream->packetLost++;
+				txList->setUsed(ix, false);
+				stream->repairLoss = true;
+				calculateLossRate(true);
+			}
+		}
+		stream->lossSeqNr++;
+	}
 }
 
 float ScreamV2Tx::getTargetBitrate(uint32_t time_ntp, uint32_t ssrc) {
@@ -1270,6 +1748,40 @@ void ScreamV2Tx::setTargetPriority(uint32_t ssrc, float priority) {
 	stream->targetPriorityInv = 1.0f / priority;
 }
 
+void ScreamV2Tx::enableFairQueueing(bool enable) {
+	isEnableFairQueueing = enable;
+	fqRebuild();
+}
+
+/*
+* The heap is rebuilt from the streams that have RTP packets in queue
+*/
+void ScreamV2Tx::fqRebuild() {
+	for (int n = 0; n < nStreams; n++)
+		streams[n]->fqHeapIx = -1;
+	nFqHeap = 0;
+	if (isEnableFairQueueing) {
+		for (int n = 0; n < nStreams; n++) {
+			if (streams[n]->rtpQueue->sizeOfQueue() > 0)
+				fqPush(streams[n]);
+		}
+	}
+}
+
+void ScreamV2Tx::setStrictPriority(uint32_t ssrc, bool isStrict) {
+	int id;
+	Stream* stream = getStream(ssrc, id);
+	if (stream == NULL || stream->isStrictPriority == isStrict)
+		return;
+	bool isInHeap = stream->fqHeapIx >= 0;
+	if (isInHeap)
+		fqRemove(stream);
+	stream->isStrictPriority = isStrict;
+	stream->fqFinishTag = fqVirtualTime[isStrict];
+	if (isInHeap)
+		fqPush(stream);
+}
+
 void ScreamV2Tx::getLogHeader(char* s) {
 	sprintf(s,
 		"LogName,queueDelay,queueDelayMax,queueDelayMinSlowAvg,sRtt,cwnd,bytesInFlightLog,rateTransmitted,isInFastStart,curMss,rtpQueueDelay,rtpQueueBytes,rtpQueueSize,targetBitrate,rateRtp,packetsRtp,rateTransmittedStream,rateAcked,rateLost,rateCe,packetsCe,hiSeqTx,hiSeqAck,SeqDiff,packetetsRtpCleared,packetsLost");
@@ -1347,6 +1859,37 @@ void ScreamV2Tx::getVeryShortLog(float time, char* s) {
 	}
 }
 
+void ScreamV2Tx::getStatsSnapshot(float time, StatsSnapshot& snapshot) {
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.time = time;
+	snapshot.cwnd = cwnd;
+	snapshot.bytesInFlight = bytesInFlight;
+	snapshot.sRtt = sRtt;
+	snapshot.queueDelay = queueDelay;
+	snapshot.queueDelayTarget = queueDelayTarget;
+	snapshot.l4sAlpha = l4sAlpha;
+	snapshot.rateTransmitted = rateTransmittedAvg;
+	snapshot.isL4s = isL4s;
+	snapshot.nStreams = std::min(nStreams, kStatsMaxStreams);
+	for (int n = 0; n < snapshot.nStreams; n++) {
+		Stream* tmp = streams[n];
+		StatsSnapshotStream& s = snapshot.streams[n];
+		s.ssrc = tmp->ssrc;
+		s.targetBitrate = tmp->targetBitrate;
+		s.rateRtp = tmp->rateRtpAvg;
+		s.rateTransmitted = tmp->rateTransmittedAvg;
+		s.rateAcked = tmp->rateAcked;
+		s.rateLost = tmp->rateLost;
+		s.rateCe = tmp->rateCe;
+		s.rtpQueueDelay = std::max(0.0f, tmp->rtpQueueDelay);
+		s.rtpQueueBytes = tmp->rtpQueue->bytesInQueue();
+		s.rtpQueueSize = tmp->rtpQueue->sizeOfQueue();
+		s.packetsRtp = tmp->packetsRtp;
+		s.packetsLost = tmp->packetLost;
+		s.packetsCe = tmp->packetsCe;
+	}
+}
+
 float ScreamV2Tx::getQualityIndex(float time, float thresholdRate, float rttMin) {
 	/*
 	* The quality index is an approximate value of the streaming quality and takes the bitrate
@@ -1366,6 +1909,16 @@ bool ScreamV2Tx::isLossEpoch(uint32_t ssrc) {
 	return  getStream(ssrc, id)->isLossEpoch();
 }
 
+int ScreamV2Tx::getDiscardedFrames(uint32_t ssrc, uint32_t* timeStamps, int maxFrames) {
+	int id;
+	Stream* stream = getStream(ssrc, id);
+	int n = std::min(maxFrames, stream->nDiscardedFrames);
+	memcpy(timeStamps, stream->discardedFrames, n * sizeof(uint32_t));
+	stream->nDiscardedFrames -= n;
+	memmove(stream->discardedFrames, stream->discardedFrames + n, stream->nDiscardedFrames * sizeof(uint32_t));
+	return n;
+}
+
 void ScreamV2Tx::initialize(uint32_t time_ntp) {
 	isInitialized = true;
 	lastSRttUpdateT_ntp = time_ntp;
@@ -1375,7 +1928,7 @@ void ScreamV2Tx::initialize(uint32_t time_ntp) {
 	lastLossEventT_ntp = time_ntp;
 	lastCeEventT_ntp = 0;
 	lastTransmitT_ntp = time_ntp;
-	nextTransmitT_ntp = time_ntp;
+	nextTransmitT_q32 = extendTime(time_ntp);
 	lastRateUpdateT_ntp = time_ntp;
 	lastRttT_ntp = time_ntp;
 	lastBaseDelayRefreshT_ntp = time_ntp - 1;
@@ -1459,7 +2012,8 @@ void ScreamV2Tx::updateCwnd(uint32_t time_ntp) {
 	/*
 	* Compute paceInterval
 	*/
-  paceInterval = kMinPaceInterval;
+  float minPaceInterval = isHighResolutionTime ? kMinPaceIntervalHighRes : kMinPaceInterval;
+  paceInterval = minPaceInterval;
   adaptivePacingRateScale = 1.0;
   if (isEnablePacketPacing) {
 		/*
@@ -1505,9 +2059,12 @@ void ScreamV2Tx::updateCwnd(uint32_t time_ntp) {
 
 
     float tp = (getMss() * 8.0f) / pacingBitrate;
-    paceInterval = std::max(kMinPaceInterval, tp);
+    paceInterval = std::max(minPaceInterval, tp);
   }
-	paceInterval_ntp = (uint32_t)(paceInterval * 65536); // paceinterval converted to NTP domain (Q16)
+	if (isHighResolutionTime)
+		paceInterval_q32 = uint64_t(double(paceInterval) * secToQ32ScaleFactor);
+	else
+		paceInterval_q32 = uint64_t((uint32_t)(paceInterval * 65536)) << 16; // paceinterval rounded to the NTP domain (Q16)
 
 
 	/*
@@ -2131,6 +2688,29 @@ ScreamV2Tx::Stream* ScreamV2Tx::getPrioritizedStream(uint32_t time_ntp) {
 		*/
 		return streams[0];
 
+	if (isEnableFairQueueing) {
+		/*
+		* Serve the backlogged stream with the lowest finish time, streams
+		*  that have run out of RTP packets are removed from the heap
+		*/
+		while (nFqHeap > 0) {
+			Stream* tmp = fqHeap[0];
+			if (tmp->rtpQueue->sizeOfQueue() > 0)
+				return tmp;
+			fqRemove(tmp);
+		}
+		/*
+		* RTP packets can be queued without a call to newMediaFrame, pick these up
+		*  with a heap rebuild. The rebuild is rate limited as an idle sender
+		*  calls isOkToTransmit often with an empty heap
+		*/
+		if (time_ntp - lastFqRebuildT_ntp < kFqRebuildInterval_ntp)
+			return NULL;
+		fqRebuild();
+		lastFqRebuildT_ntp = time_ntp;
+		return nFqHeap > 0 ? fqHeap[0] : NULL;
+	}
+
 	int maxCredit = 1;
 	Stream* stream = NULL;
 	/*
@@ -2177,6 +2757,83 @@ ScreamV2Tx::Stream* ScreamV2Tx::getPrioritizedStream(uint32_t time_ntp) {
 	return stream;
 }
 
+/*
+* Start time fair queueing, a packet of size L that is transmitted by stream i
+*  gets the virtual start time S = max(V, F_i) and finish time F_i = S + L/priority_i,
+*  and the virtual time V is set to S. A stream that was idle thus restarts at
+*  the current virtual time and does not get a burst of accumulated credit
+*/
+void ScreamV2Tx::fqTransmitted(Stream* servedStream, int transmittedBytes) {
+	double& virtualTime = fqVirtualTime[servedStream->isStrictPriority];
+	double startTag = std::max(virtualTime, servedStream->fqFinishTag);
+	servedStream->fqFinishTag = startTag + transmittedBytes * servedStream->targetPriorityInv;
+	virtualTime = startTag;
+	if (servedStream->fqHeapIx >= 0)
+		fqSiftDown(servedStream->fqHeapIx);
+	else if (servedStream->rtpQueue->sizeOfQueue() > 0)
+		fqPush(servedStream);
+}
+
+bool ScreamV2Tx::fqIsBefore(Stream* a, Stream* b) {
+	if (a->isStrictPriority != b->isStrictPriority)
+		return a->isStrictPriority;
+	/*
+	* A stream that is behind the virtual time has the start time V for its next packet
+	*/
+	double virtualTime = fqVirtualTime[a->isStrictPriority];
+	return std::max(virtualTime, a->fqFinishTag) < std::max(virtualTime, b->fqFinishTag);
+}
+
+void ScreamV2Tx::fqPush(Stream* stream) {
+	stream->fqHeapIx = nFqHeap;
+	fqHeap[nFqHeap++] = stream;
+	fqSiftUp(stream->fqHeapIx);
+}
+
+void ScreamV2Tx::fqRemove(Stream* stream) {
+	int ix = stream->fqHeapIx;
+	stream->fqHeapIx = -1;
+	nFqHeap--;
+	if (ix == nFqHeap)
+		return;
+	fqHeap[ix] = fqHeap[nFqHeap];
+	fqHeap[ix]->fqHeapIx = ix;
+	fqSiftUp(ix);
+	fqSiftDown(fqHeap[ix]->fqHeapIx);
+}
+
+void ScreamV2Tx::fqSiftUp(int ix) {
+	Stream* stream = fqHeap[ix];
+	while (ix > 0) {
+		int parentIx = (ix - 1) / 2;
+		if (!fqIsBefore(stream, fqHeap[parentIx]))
+			break;
+		fqHeap[ix] = fqHeap[parentIx];
+		fqHeap[ix]->fqHeapIx = ix;
+		ix = parentIx;
+	}
+	fqHeap[ix] = stream;
+	stream->fqHeapIx = ix;
+}
+
+void ScreamV2Tx::fqSiftDown(int ix) {
+	Stream* stream = fqHeap[ix];
+	while (true) {
+		int childIx = 2 * ix + 1;
+		if (childIx >= nFqHeap)
+			break;
+		if (childIx + 1 < nFqHeap && fqIsBefore(fqHeap[childIx + 1], fqHeap[childIx]))
+			childIx++;
+		if (!fqIsBefore(fqHeap[childIx], stream))
+			break;
+		fqHeap[ix] = fqHeap[childIx];
+		fqHeap[ix]->fqHeapIx = ix;
+		ix = childIx;
+	}
+	fqHeap[ix] = stream;
+	stream->fqHeapIx = ix;
+}
+
 int ScreamV2Tx::getMss() {
 	return std::max(mss, prevMss);
 }
@@ -4,6 +4,8 @@
 
 
 static const uint32_t kMinRtpQueueDiscardInterval_ntp = 16384; // 0.25s in NTP doain
+// The RTP queue is cleared at this times maxRtpQueueDelay when stale frames are discarded instead
+static const float kFrameDiscardClearScale = 2.0f;
 static const float kRelFrameSizeHistDecay = 1.0f / 1024;
 static const float kRelFrameSizeHighPercentile = 0.8f;
 static const int kRelFrameSizeHistPreamble = 50;
@@ -28,6 +30,11 @@ ScreamV2Tx::Stream::Stream(ScreamV2Tx* parent_,
 	ssrc = ssrc_;
 	targetPriority = priority_;
 	targetPriorityInv = 1.0f / targetPriority;
+	isStrictPriority = false;
+	fqFinishTag = 0.0;
+	fqHeapIx = -1;
+	budgetFinishTag = 0.0;
+	budgetPackets = 0;
 	minBitrate = minBitrate_;
 	maxBitrate = maxBitrate_;
 	targetBitrate = std::min(maxBitrate, std::max(minBitrate, startBitrate_));
@@ -61,6 +68,7 @@ ScreamV2Tx::Stream::Stream(ScreamV2Tx* parent_,
 	lastTransmitT_ntp = 0;
 	numberOfUpdateRate = 0;
 	cleared = 0;
+	nDiscardedFrames = 0;
 	packetLost = 0;
 	packetsCe = 0;
 	packetsCe = 0;
@@ -79,9 +87,12 @@ ScreamV2Tx::Stream::Stream(ScreamV2Tx* parent_,
 	bytesCe = 0;
 	wasRepairLoss = false;
 	repairLoss = false;
-	for (int n = 0; n < kMaxTxPackets; n++)
-		txPackets[n].isUsed = false;
-	txPacketsPtr = 0;
+	txList = new TxList(std::max(kMaxTxPackets, TxList::getSizeForBitrate(maxBitrate)));
+	isSeqNrInit = false;
+	hiSeqTxExt = 0;
+	ackEdgeSeqNr = 0;
+	lossSeqNr = 0;
+	lossTimerT_ntp = 0;
 	lossEpoch = false;
 	frameSize = 0;
 	frameSizeAcc = 0;
@@ -101,6 +112,12 @@ ScreamV2Tx::Stream::Stream(ScreamV2Tx* parent_,
 	isMaxrate = false;
 
 	rtpQueueDelay = 0.0f;
+
+	statisticsIx = parent->statistics->addStream(ssrc);
+}
+
+ScreamV2Tx::Stream::~Stream() {
+	delete txList;
 }
 
 /*
@@ -158,20 +175,54 @@ float ScreamV2Tx::Stream::getMaxRate() {
 	return std::max(rateTransmitted, rateAcked);
 }
 
+/*
+* Hash of an SSRC for the SSRC hash table, SSRCs are often consecutive numbers
+*  so the bits are mixed
+*/
+static uint32_t hashSsrc(uint32_t ssrc) {
+	return (ssrc * 2654435761u) >> 8;
+}
+
 /*
 * Get the stream that matches SSRC
 */
 ScreamV2Tx::Stream* ScreamV2Tx::getStream(uint32_t ssrc, int& streamId) {
-	for (int n = 0; n < nStreams; n++) {
-		if (streams[n]->isMatch(ssrc)) {
-			streamId = n;
-			return streams[n];
+	uint32_t ix = hashSsrc(ssrc) & ssrcHashMask;
+	while (ssrcHash[ix] != 0) {
+		Stream* stream = streams[ssrcHash[ix] - 1];
+		if (stream->isMatch(ssrc)) {
+			streamId = ssrcHash[ix] - 1;
+			return stream;
 		}
+		ix = (ix + 1) & ssrcHashMask;
 	}
 	streamId = -1;
 	return NULL;
 }
 
+void ScreamV2Tx::rebuildSsrcHash() {
+	/*
+	* The table is at least twice the capacity of the stream list
+	*  to keep the probe sequences short
+	*/
+	uint32_t size = 16;
+	while (size < uint32_t(2 * maxStreams))
+		size *= 2;
+	if (size != ssrcHashMask + 1 || ssrcHash == 0) {
+		delete[] ssrcHash;
+		ssrcHash = new int[size];
+		ssrcHashMask = size - 1;
+	}
+	for (uint32_t n = 0; n < size; n++)
+		ssrcHash[n] = 0;
+	for (int n = 0; n < nStreams; n++) {
+		uint32_t ix = hashSsrc(streams[n]->ssrc) & ssrcHashMask;
+		while (ssrcHash[ix] != 0)
+			ix = (ix + 1) & ssrcHashMask;
+		ssrcHash[ix] = n + 1;
+	}
+}
+
 void ScreamV2Tx::Stream::newMediaFrame(uint32_t time_ntp, int bytesRtp, bool isMarker) {
 	frameSizeAcc += bytesRtp;
 	/*
@@ -291,7 +342,20 @@ void ScreamV2Tx::Stream::updateTargetBitrate(uint32_t time_ntp) {
 	}
 
 	float rtpQueueDelay = rtpQueue->getDelay(time_ntp * ntp2SecScaleFactor);
-	if (rtpQueueDelay > maxRtpQueueDelay &&
+	float clearRtpQueueDelay = maxRtpQueueDelay;
+	if (parent->isEnableFrameDiscard && rtpQueueDelay > maxRtpQueueDelay) {
+		/*
+		* A stale frame that cannot be discarded, e.g. a key frame, stays at the head
+		*  of the RTP queue. The queue is then cleared only if it grows to
+		*  kFrameDiscardClearScale*maxRtpQueueDelay, so that the protected frame
+		*  is not flushed when it is merely late.
+		*  RTP queues that do not implement discardFrames() are cleared as usual
+		*/
+		if (discardStaleFrames(time_ntp) >= 0)
+			clearRtpQueueDelay = kFrameDiscardClearScale * maxRtpQueueDelay;
+		rtpQueueDelay = rtpQueue->getDelay(time_ntp * ntp2SecScaleFactor);
+	}
+	if (rtpQueueDelay > clearRtpQueueDelay &&
 		(time_ntp - lastRtpQueueDiscardT_ntp > kMinRtpQueueDiscardInterval_ntp)) {
 		/*
 		* RTP queue is cleared as it is becoming too large,
@@ -337,6 +401,30 @@ void ScreamV2Tx::Stream::updateTargetBitrate(uint32_t time_ntp) {
 	}
 }
 
+int ScreamV2Tx::Stream::discardStaleFrames(uint32_t time_ntp) {
+	int nPackets = 0;
+	int nFrames = rtpQueue->discardFrames(time_ntp * ntp2SecScaleFactor, maxRtpQueueDelay,
+		discardedFrames + nDiscardedFrames, kMaxDiscardedFrames - nDiscardedFrames, nPackets);
+	if (nFrames <= 0)
+		return nFrames;
+	std::cerr << parent->logTag << " RTP queue " << nFrames << " frames (" << nPackets << " packets) discarded for SSRC " << ssrc <<
+		" at " << time_ntp / 65536.0f << std::endl;
+	cleared += nPackets;
+	if (nDiscardedFrames + nFrames > kMaxDiscardedFrames) {
+		/*
+		* The discarded frames are not collected by the media coder, a loss
+		*  is signaled so that a key frame is requested instead
+		*/
+		nDiscardedFrames = kMaxDiscardedFrames;
+		rtpQueueDiscard = true;
+		lossEpoch = true;
+	}
+	else {
+		nDiscardedFrames += nFrames;
+	}
+	return nFrames;
+}
+
 bool ScreamV2Tx::Stream::isRtpQueueDiscard() {
 	bool tmp = rtpQueueDiscard;
 	rtpQueueDiscard = false;
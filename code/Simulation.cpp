@@ -0,0 +1,857 @@
+#include "Simulation.h"
+#include "VideoEnc.h"
+#include "RtpQueue.h"
+#include "NetQueue.h"
+#include "NetQueueAqm.h"
+#include "LinkTrace.h"
+#include "OooQueue.h"
+#include "EventQueue.h"
+#include "ScreamRx.h"
+#include "ScreamTx.h"
+#include "TcpFlow.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+
+/*
+* Implements one run of the SCReAM simulator
+*/
+
+SimulationParams::SimulationParams() {
+	Tmax = 20;
+	isChRate = true;
+	printLog = false;
+	ecnCapable = true;
+	isL4s = true && ecnCapable;
+	aqm = 0;
+	FR = 50.0f;
+	FR_DIV = 1;
+	enablePacing = true;
+	isFairQueueing = false;
+	isFrameDiscard = false;
+	swprio = -1;
+	traceFile = "./traces/trace_no_key.txt";
+	mode = 0x1;
+	RTT = 0.025f;
+	linkRate = 10000e3;
+	linkRateLow = 5000e3;
+	linkTrace = 0;
+	mss = 1000;
+	bufferSize = 0;
+	nScreamFlows = 1;
+	tcpFlows = 0;
+	flowStartInterval = 0.0f;
+	tcpMss = 1500;
+	lossBeta = 0.7f;
+	ecnCeBeta = 0.8f;
+	queueDelayTarget = 0.06f;
+	cwnd = 10000;
+	packetPacingHeadroom = 1.5f;
+	maxAdaptivePacingRateScale = 1.5f;
+	bytesInFlightHeadroom = 2.0f;
+	multiplicativeIncreaseScalefactor = 0.05f;
+	maxWindowHeadroom = 3.0f;
+	seed = 1;
+	logFp = 0;
+}
+
+SimulationKpi::SimulationKpi() {
+	throughput = 0.0f;
+	utilization = 0.0f;
+	queueDelayP50 = 0.0f;
+	queueDelayP95 = 0.0f;
+	queueDelayP99 = 0.0f;
+	rtpQueueDelayP50 = 0.0f;
+	rtpQueueDelayP95 = 0.0f;
+	rtpQueueDelayP99 = 0.0f;
+	ceRate = 0.0f;
+	nDelivered = 0;
+	nDropped = 0;
+	nEvents = 0;
+	fairness = 1.0f;
+	for (int n = 0; n < 4; n++)
+		streamShare[n] = 0.0f;
+}
+
+FlowKpi::FlowKpi() {
+	type = "";
+	tStart = 0.0f;
+	throughput = 0.0f;
+	queueDelayP50 = 0.0f;
+	queueDelayP95 = 0.0f;
+	queueDelayP99 = 0.0f;
+	rtpQueueDelayP50 = 0.0f;
+	rtpQueueDelayP95 = 0.0f;
+	rtpQueueDelayP99 = 0.0f;
+	ceRate = 0.0f;
+	nDelivered = 0;
+	nDropped = 0;
+}
+
+/*
+* Event sources for the discrete event simulation, the simulation
+*  time only advances to the next pending event rather than stepping
+*  through every Q16 tick.
+* The bottleneck, control and log events are common, each flow has
+*  its own set of events that follow after the common events
+*/
+enum SimEvent {
+	kEvNetQueueRate,   // Release of the oldest packet in the bottleneck queue
+	kEvControl,        // Scripted changes in link rate or priorities
+	kEvLog,            // Periodic log printout
+	kNumSimEvents
+};
+
+enum ScreamFlowEvent {
+	kEvFrame,          // Video frame timer
+	kEvPace,           // Packet pacing timer, given by isOkToTransmit/addTransmitted
+	kEvNetQueueDelay,  // Release of the oldest packet in the delay queue
+	kEvOooQueue,       // Release of delayed (out of order) packets
+	kEvFeedback,       // RTCP feedback interval expires
+	kNumScreamFlowEvents
+};
+
+enum TcpFlowEvent {
+	kEvTcpSend,        // Pacing or retransmission timer
+	kEvTcpNetQueueDelay,
+	kNumTcpFlowEvents
+};
+
+/*
+* SSRC of SCReAM flow k stream s is 10+16*k+s,
+*  SSRC of TCP flow k is kTcpSsrcBase+k
+*/
+static const uint32_t kScreamSsrcBase = 10;
+static const uint32_t kScreamSsrcStride = 16;
+static const uint32_t kTcpSsrcBase = 0x10000;
+
+/*
+* Get the first Q16 tick n for which n/65536 >= t [s]
+*  or n/65536 > t if isAfter is true
+*/
+static uint64_t timeToTick(float t, bool isAfter = false) {
+	if (t <= 0.0f)
+		return isAfter ? 1 : 0;
+	uint64_t n = (uint64_t)(t * 65536.0f);
+	while (n > 0 && (isAfter ? (n - 1) / 65536.0f > t : (n - 1) / 65536.0f >= t))
+		n--;
+	while (isAfter ? n / 65536.0f <= t : n / 65536.0f < t)
+		n++;
+	return n;
+}
+
+/*
+* ECN bits of a received packet
+*/
+static uint8_t ecnBitsRx(bool ecnCapable, bool isL4s, bool isCe) {
+	if (!ecnCapable)
+		return 0x00;
+	if (isCe)
+		return 0x03;
+	return isL4s ? 0x01 : 0x02;
+}
+
+/*
+* KPI samples for one flow
+*/
+class FlowStats {
+public:
+	FlowStats() {
+		type = "";
+		tStart = 0.0f;
+		bitsDelivered = 0.0;
+		nCe = 0;
+		nDropped = 0;
+	};
+
+	const char* type;
+	float tStart;
+	std::vector<float> queueDelaySamples;
+	std::vector<float> rtpQueueDelaySamples;
+	double bitsDelivered;
+	int nCe;
+	int nDropped;
+};
+
+/*
+* One SCReAM sender and receiver pair, with the media sources
+*  and the forward path to the bottleneck
+*/
+class ScreamFlow {
+public:
+	ScreamFlow() {
+		screamTx = 0;
+		screamRx = 0;
+		for (int k = 0; k < 4; k++) {
+			rtpQueue[k] = 0;
+			videoEnc[k] = 0;
+			bitsTransmitted[k] = 0.0;
+		}
+		netQueueDelay = 0;
+		oooQueue = 0;
+		ssrcBase = 0;
+		ssrc = 0;
+		nFirstFrame = 0;
+		nextCallN = -1;
+		retVal = -1.0f;
+		evBase = 0;
+	};
+
+	~ScreamFlow() {
+		delete screamTx;
+		delete screamRx;
+		for (int k = 0; k < 4; k++) {
+			delete videoEnc[k];
+			delete rtpQueue[k];
+		}
+		delete netQueueDelay;
+		delete oooQueue;
+	};
+
+	ScreamV2Tx* screamTx;
+	ScreamRx* screamRx;
+	RtpQueue* rtpQueue[4];
+	VideoEnc* videoEnc[4];
+	NetQueue* netQueueDelay;
+	OooQueue* oooQueue;
+	uint32_t ssrcBase;     // SSRC of stream 0, streams 1..3 follow
+	uint32_t ssrc;         // SSRC given by isOkToTransmit
+	uint64_t nFirstFrame;  // Tick of the first video frame
+	int64_t nextCallN;
+	float retVal;
+	int evBase;            // First event source of the flow
+	double bitsTransmitted[4]; // Per stream
+	FlowStats stats;
+};
+
+/*
+* One TCP sender with the forward path to the bottleneck,
+*  the acknowledgements are returned without delay
+*/
+class TcpCrossFlow {
+public:
+	TcpCrossFlow() {
+		tcp = 0;
+		netQueueDelay = 0;
+		ssrc = 0;
+		evBase = 0;
+	};
+
+	~TcpCrossFlow() {
+		delete tcp;
+		delete netQueueDelay;
+	};
+
+	TcpFlow* tcp;
+	NetQueue* netQueueDelay;
+	uint32_t ssrc;
+	int evBase;
+	FlowStats stats;
+};
+
+/*
+* Parse a '+' separated list of TCP flow types
+*/
+static bool parseTcpFlows(const char* s, std::vector<TcpFlow::Type>& types) {
+	types.clear();
+	std::string str(s);
+	size_t pos = 0;
+	while (pos < str.size()) {
+		size_t end = str.find('+', pos);
+		if (end == std::string::npos)
+			end = str.size();
+		if (end > pos) {
+			TcpFlow::Type type;
+			if (!TcpFlow::parseType(str.substr(pos, end - pos).c_str(), type))
+				return false;
+			types.push_back(type);
+		}
+		pos = end + 1;
+	}
+	return true;
+}
+
+/*
+* Schedule the release of the oldest packet in a queue
+*/
+static void scheduleRelease(EventQueue* eventQueue, int source, uint64_t n, float tRelease, bool isAfter = false) {
+	if (tRelease >= 0.0f)
+		eventQueue->schedule(source, max(n + 1, timeToTick(tRelease, isAfter)));
+	else
+		eventQueue->cancel(source);
+}
+
+float Simulation::percentile(std::vector<float>& samples, float p) {
+	if (samples.empty())
+		return 0.0f;
+	size_t ix = std::min(samples.size() - 1, size_t(p * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + ix, samples.end());
+	return samples[ix];
+}
+
+float Simulation::jainFairness(const std::vector<FlowKpi>& flows) {
+	double sum = 0.0;
+	double sumSquares = 0.0;
+	for (size_t k = 0; k < flows.size(); k++) {
+		sum += flows[k].throughput;
+		sumSquares += double(flows[k].throughput) * flows[k].throughput;
+	}
+	if (sumSquares == 0.0)
+		return 1.0f;
+	return float(sum * sum / (flows.size() * sumSquares));
+}
+
+Simulation::Simulation(const SimulationParams& params_) {
+	params = params_;
+}
+
+bool Simulation::run(SimulationKpi& kpi) {
+	FILE* fpTrace = fopen(params.traceFile, "r");
+	if (fpTrace == 0) {
+		cerr << "Cannot open trace file " << params.traceFile << endl;
+		return false;
+	}
+	fclose(fpTrace);
+	std::vector<TcpFlow::Type> tcpTypes;
+	if (params.tcpFlows && !parseTcpFlows(params.tcpFlows, tcpTypes)) {
+		cerr << "Unknown TCP flow type in " << params.tcpFlows << ", use reno, cubic or prague" << endl;
+		return false;
+	}
+	const int nScreamFlows = std::max(0, params.nScreamFlows);
+	const int nTcpFlows = int(tcpTypes.size());
+	if (nScreamFlows + nTcpFlows == 0) {
+		cerr << "No flows to simulate" << endl;
+		return false;
+	}
+	LinkTrace* linkTrace = 0;
+	if (params.linkTrace) {
+		linkTrace = new LinkTrace(params.linkTrace);
+		if (!linkTrace->isOpen()) {
+			delete linkTrace;
+			return false;
+		}
+	}
+	NetQueueAqm* aqm = 0;
+	if (params.aqm) {
+		aqm = createAqm(params.aqm);
+		if (aqm == 0) {
+			cerr << "Unknown AQM " << params.aqm << endl;
+			delete linkTrace;
+			return false;
+		}
+	}
+
+	const float FR = params.FR;
+	const int FR_DIV = params.FR_DIV;
+	const int mode = params.mode;
+	const bool isL4s = params.isL4s && params.ecnCapable;
+	int swprio = params.swprio;
+	int tick = (int)(65536.0f / FR);
+
+	NetQueue* netQueueRate = new NetQueue(0.0f, params.linkRate, 0.0f, true && isL4s);
+	if (aqm)
+		netQueueRate->setAqm(aqm);
+	if (linkTrace)
+		netQueueRate->setLinkTrace(linkTrace);
+	netQueueRate->setSeed(params.seed * 2654435761u + 1);
+	netQueueRate->maxBytes = params.bufferSize;
+	/*
+	* ECN codepoint of the transmitted packets
+	*/
+	const unsigned char ecnBits = params.ecnCapable ? (isL4s ? 0x01 : 0x02) : 0x00;
+
+	/*
+	* SCReAM flows, the frames of flow k are delayed k/nScreamFlows
+	*  frame intervals to spread the frames of the flows in time
+	*/
+	std::vector<ScreamFlow*> screamFlows;
+	for (int k = 0; k < nScreamFlows; k++) {
+		ScreamFlow* flow = new ScreamFlow();
+		flow->screamTx = new ScreamV2Tx(params.lossBeta, params.ecnCeBeta, params.queueDelayTarget, params.cwnd,
+			params.packetPacingHeadroom, params.maxAdaptivePacingRateScale, params.bytesInFlightHeadroom,
+			params.multiplicativeIncreaseScalefactor, isL4s, params.maxWindowHeadroom, false, false);
+		ScreamV2Tx* screamTx = flow->screamTx;
+
+		int mssList[1] = { params.mss };
+		screamTx->setCwndMinLow(2000);
+		screamTx->enablePacketPacing(params.enablePacing);
+		screamTx->enableRelaxedPacing(true);
+		screamTx->setMssListMinPacketsInFlight(mssList, 1, 5);
+		//screamTx->autoTuneMinCwnd(true);
+		//screamTx->setMaxTotalBitrate(40e6);
+		screamTx->isEnableAdaptiveWindowHeadroom(true);
+		screamTx->enableFairQueueing(params.isFairQueueing);
+		screamTx->enableFrameDiscard(params.isFrameDiscard);
+		if (k == 0)
+			screamTx->setDetailedLogFp(params.logFp);
+
+		flow->screamRx = new ScreamRx(0, -1);
+		for (int s = 0; s < 4; s++)
+			flow->rtpQueue[s] = new RtpQueue();
+		flow->netQueueDelay = new NetQueue(params.RTT, 0.0f, 0.0f);
+		flow->netQueueDelay->setSeed(params.seed + k * 0x9e3779b9u);
+		flow->oooQueue = new OooQueue(0.0f);
+		flow->videoEnc[0] = new VideoEnc(flow->rtpQueue[0], FR, (char*)params.traceFile, 0, 0.0);
+		flow->videoEnc[1] = new VideoEnc(flow->rtpQueue[1], FR / FR_DIV, (char*)params.traceFile);
+		flow->videoEnc[2] = new VideoEnc(flow->rtpQueue[2], FR / FR_DIV, (char*)params.traceFile);
+		flow->videoEnc[3] = new VideoEnc(flow->rtpQueue[3], FR / FR_DIV, (char*)params.traceFile);
+		for (int s = 0; s < 4; s++) {
+			/*
+			* Each stream starts at a different position in the frame size trace
+			*/
+			VideoEnc* videoEnc = flow->videoEnc[s];
+			if (videoEnc->nFrames > 0)
+				videoEnc->ix = (s * 50 + k * 211) % videoEnc->nFrames;
+		}
+
+		uint32_t ssrcBase = kScreamSsrcBase + k * kScreamSsrcStride;
+		flow->ssrcBase = ssrcBase;
+		if (mode & 0x01)
+			//screamTx->registerNewStream(flow->rtpQueue[0], ssrcBase, 1.0f, 1e6f, 1e6f, 10e6f, 0.1f, false, 0.05f);
+			screamTx->registerNewStream(flow->rtpQueue[0], ssrcBase, 1.0f, 0.1e6f, 1e6f, 20e6f, 1.0f, false, 0.0f, false);
+		if (mode & 0x02)
+			screamTx->registerNewStream(flow->rtpQueue[1], ssrcBase + 1, 0.1f, 1.0e6f, 5e6f, 50e6f, 0.1f, false, 0.1f);
+		if (mode & 0x04)
+			screamTx->registerNewStream(flow->rtpQueue[2], ssrcBase + 2, 0.3f, 1.0e6f, 5e6f, 50e6f, 0.1f, false, 0.1f);
+		if (mode & 0x08)
+			screamTx->registerNewStream(flow->rtpQueue[3], ssrcBase + 3, 0.2f, 0.8e6f, 5e6f, 30e6f, 0.1f, false, 0.1f);
+
+		flow->stats.type = "scream";
+		flow->stats.tStart = k * params.flowStartInterval;
+		flow->nFirstFrame = timeToTick(flow->stats.tStart) + uint64_t(k) * tick / nScreamFlows;
+		flow->evBase = kNumSimEvents + k * kNumScreamFlowEvents;
+		screamFlows.push_back(flow);
+	}
+
+	std::vector<TcpCrossFlow*> tcpFlows;
+	for (int k = 0; k < nTcpFlows; k++) {
+		TcpCrossFlow* flow = new TcpCrossFlow();
+		flow->tcp = new TcpFlow(tcpTypes[k], params.tcpMss, params.ecnCapable);
+		flow->netQueueDelay = new NetQueue(params.RTT, 0.0f, 0.0f);
+		flow->netQueueDelay->setSeed(params.seed + (nScreamFlows + k) * 0x9e3779b9u);
+		flow->ssrc = kTcpSsrcBase + k;
+		flow->stats.type = TcpFlow::getTypeName(tcpTypes[k]);
+		flow->stats.tStart = (nScreamFlows + k) * params.flowStartInterval;
+		flow->evBase = kNumSimEvents + nScreamFlows * kNumScreamFlowEvents + k * kNumTcpFlowEvents;
+		tcpFlows.push_back(flow);
+	}
+
+	float time = 0.0f;
+	uint32_t time_ntp = 0;
+	uint32_t time_ntp_rx = 0;
+	uint32_t time_ntp_rx_plus = 0;
+	uint64_t n = 0;
+	uint32_t ssrc;
+	char rtpPacket[2000];
+	int size;
+	uint16_t seqNr;
+	uint32_t timeStamp;
+	double lastLogT = -1.0;
+	time = 0;
+
+	/*
+	* KPI samples for all flows
+	*/
+	std::vector<float> queueDelaySamples;
+	std::vector<float> rtpQueueDelaySamples;
+	double bitsDelivered = 0.0;
+	double bitsCapacity = 0.0;
+	float prevTime = 0.0f;
+	int nCe = 0;
+
+	/*
+	* Scripted changes in link rate and stream priorities
+	*/
+	uint64_t controlN[4];
+	int nControlN = 0;
+	if (params.isChRate && !linkTrace) {
+		controlN[nControlN++] = timeToTick(3.0f, true);
+		controlN[nControlN++] = timeToTick(6.0f);
+	}
+	if (swprio == 0) {
+		controlN[nControlN++] = timeToTick(20.0f, true);
+		controlN[nControlN++] = timeToTick(25.0f, true);
+	}
+
+	EventQueue* eventQueue = new EventQueue(kNumSimEvents +
+		nScreamFlows * kNumScreamFlowEvents + nTcpFlows * kNumTcpFlowEvents);
+	for (int k = 0; k < nScreamFlows; k++)
+		eventQueue->schedule(screamFlows[k]->evBase + kEvFrame, screamFlows[k]->nFirstFrame);
+	for (int k = 0; k < nTcpFlows; k++)
+		eventQueue->schedule(tcpFlows[k]->evBase + kEvTcpSend, timeToTick(tcpFlows[k]->stats.tStart));
+	for (int k = 0; k < nControlN; k++) {
+		if (controlN[k] > 0) {
+			eventQueue->schedule(kEvControl, controlN[k]);
+			break;
+		}
+	}
+	if (params.printLog)
+		eventQueue->schedule(kEvLog, 0);
+
+	uint64_t nextN = 0;
+	while (eventQueue->peek(nextN) && nextN / 65536.0f <= params.Tmax) {
+		/*
+		* Advance time to the next event
+		*/
+		eventQueue->popAll(nextN);
+		n = nextN;
+		time = n / 65536.0f;
+		bitsCapacity += netQueueRate->rate * (time - prevTime);
+		prevTime = time;
+
+		if (params.logFp && nScreamFlows > 0) {
+			char s[100];
+			sprintf(s, "%3.4f", time);
+			screamFlows[0]->screamTx->setTimeString(s);
+		}
+
+		time_ntp = uint32_t(n) + 0;
+		time_ntp_rx = uint32_t(n) + time_ntp_rx_plus + 0*uint32_t(n)/16384;
+
+		netQueueRate->updateRate(time);
+
+		for (int k = 0; k < nScreamFlows; k++) {
+			ScreamFlow* flow = screamFlows[k];
+			ScreamV2Tx* screamTx = flow->screamTx;
+			flow->retVal = -1.0f;
+			if (n < flow->nFirstFrame)
+				continue;
+			uint64_t nFrame = n - flow->nFirstFrame;
+			uint32_t ssrcBase = flow->ssrcBase;
+
+			bool isFrame = false;
+			int recommendedMss = screamTx->getRecommendedMss(time_ntp);
+			if (nFrame % tick == 0) {
+				// "Encode" audio + video frame
+				if (mode & 0x01) {
+					float br = screamTx->getTargetBitrate(time_ntp, ssrcBase);
+					flow->videoEnc[0]->setMss(recommendedMss);
+					flow->videoEnc[0]->setTargetBitrate(br);
+					int bytes = flow->videoEnc[0]->encode(time);
+					screamTx->newMediaFrame(time_ntp, ssrcBase, bytes, true);
+					isFrame = true;
+				}
+			}
+
+			if (nFrame % (tick * FR_DIV) == 0) {
+				for (int s = 1; s < 4; s++) {
+					if (mode & (1 << s)) {
+						flow->videoEnc[s]->setMss(recommendedMss);
+						flow->videoEnc[s]->setTargetBitrate(screamTx->getTargetBitrate(time_ntp, ssrcBase + s));
+						int bytes = flow->videoEnc[s]->encode(time);
+						screamTx->newMediaFrame(time_ntp, ssrcBase + s, bytes, true);
+						isFrame = true;
+					}
+				}
+			}
+
+			if (isFrame && params.isFrameDiscard) {
+				/*
+				* The simulated video coder has no references to avoid, the discarded
+				*  frames are collected so that the list does not overflow
+				*/
+				uint32_t timeStamps[kMaxDiscardedFrames];
+				for (int s = 0; s < 4; s++) {
+					if (mode & (1 << s))
+						screamTx->getDiscardedFrames(ssrcBase + s, timeStamps, kMaxDiscardedFrames);
+				}
+			}
+
+			if (isFrame) {
+				/*
+				* New RTP packets added, try if OK to transmit
+				*/
+				flow->retVal = screamTx->isOkToTransmit(time_ntp, flow->ssrc);
+				if (flow->retVal > 0) {
+					flow->nextCallN = int64_t(n) + max(1, (int)(65536.0f * flow->retVal));
+				}
+			}
+		}
+
+		/*
+		* Forward path to the bottleneck
+		*/
+		bool isCe = false;
+		bool isMark = false;
+		for (int k = 0; k < nScreamFlows; k++) {
+			ScreamFlow* flow = screamFlows[k];
+			if (flow->netQueueDelay->extract(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp)) {
+				if (!netQueueRate->insert(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp, ecnBits))
+					flow->stats.nDropped++;
+			}
+		}
+		for (int k = 0; k < nTcpFlows; k++) {
+			TcpCrossFlow* flow = tcpFlows[k];
+			while (flow->netQueueDelay->extract(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp)) {
+				if (!netQueueRate->insert(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp, flow->tcp->getEcn()))
+					flow->stats.nDropped++;
+			}
+		}
+
+		netQueueRate->addBytes(time);
+		while (netQueueRate->canExtract()) {
+			int nDropped = netQueueRate->nDropped;
+			bool isDelivered = netQueueRate->extract(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp);
+			ScreamFlow* screamFlow = 0;
+			TcpCrossFlow* tcpFlow = 0;
+			if (ssrc >= kTcpSsrcBase && ssrc - kTcpSsrcBase < uint32_t(nTcpFlows))
+				tcpFlow = tcpFlows[ssrc - kTcpSsrcBase];
+			else if (ssrc >= kScreamSsrcBase && (ssrc - kScreamSsrcBase) / kScreamSsrcStride < uint32_t(nScreamFlows))
+				screamFlow = screamFlows[(ssrc - kScreamSsrcBase) / kScreamSsrcStride];
+			FlowStats* stats = tcpFlow ? &tcpFlow->stats : (screamFlow ? &screamFlow->stats : 0);
+			if (!isDelivered) {
+				if (stats && netQueueRate->nDropped > nDropped)
+					stats->nDropped++;
+				continue;
+			}
+			if ((tcpFlow ? tcpFlow->tcp->getEcn() : ecnBits) == 0x00) {
+				/*
+				* The step and ramp AQMs mark Not-ECT packets too,
+				*  the mark is ignored by the receiver
+				*/
+				isCe = false;
+			}
+			bitsDelivered += size * 8;
+			queueDelaySamples.push_back(netQueueRate->lastQueueDelay);
+			if (isCe)
+				nCe++;
+			if (stats) {
+				stats->bitsDelivered += size * 8;
+				stats->queueDelaySamples.push_back(netQueueRate->lastQueueDelay);
+				if (isCe)
+					stats->nCe++;
+			}
+			if (tcpFlow) {
+				/*
+				* The TCP sequence number is carried in the timestamp
+				*/
+				tcpFlow->tcp->ack(time, timeStamp, isCe);
+			}
+			else if (screamFlow) {
+				if (!screamFlow->oooQueue->insert(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp)) {
+					screamFlow->screamRx->receive(time_ntp_rx, 0, ssrc, size, seqNr, ecnBitsRx(params.ecnCapable, isL4s, isCe), isMark, timeStamp);
+				}
+			}
+		}
+
+		for (int k = 0; k < nScreamFlows; k++) {
+			ScreamFlow* flow = screamFlows[k];
+			ScreamV2Tx* screamTx = flow->screamTx;
+			ScreamRx* screamRx = flow->screamRx;
+			while (flow->oooQueue->extract(time, rtpPacket, ssrc, size, seqNr, isCe, isMark, timeStamp)) {
+				screamRx->receive(time_ntp_rx, 0, ssrc, size, seqNr, ecnBitsRx(params.ecnCapable, isL4s, isCe), isMark, timeStamp);
+			}
+
+			unsigned char buf[2000];
+			int fb_size = -1;
+			bool isFeedback = screamRx->isFeedback(time_ntp_rx) &&
+				(time_ntp_rx - screamRx->getLastFeedbackT() > screamRx->getRtcpFbInterval() || screamRx->checkIfFlushAck());
+
+			if (isFeedback && screamRx->createStandardizedFeedback(time_ntp_rx, false, buf, fb_size)) {
+				screamTx->incomingStandardizedFeedback(time_ntp, buf, fb_size);
+				while (screamRx->isOooDetected()) {
+					/*
+					* OOO RTP detected, additional "transmission" of RTCP
+					*/
+					screamRx->createStandardizedFeedbackOoo(time_ntp_rx, false, buf, fb_size);
+					screamTx->incomingStandardizedFeedback(time_ntp, buf, fb_size);
+				}
+				flow->retVal = screamTx->isOkToTransmit(time_ntp, flow->ssrc);
+			}
+
+			if (int64_t(n) == flow->nextCallN && flow->retVal != 0.0f) {
+				flow->retVal = screamTx->isOkToTransmit(time_ntp, flow->ssrc);
+				if (flow->retVal > 0) {
+					flow->nextCallN = int64_t(n) + max(1, (int)(65536.0f * flow->retVal));
+				}
+			}
+
+			if (flow->retVal == 0) {
+				/*
+				* RTP packet can be transmitted
+				*/
+				void** rtpPacket = 0;
+				uint32_t ssrc_tmp;
+				float rtpQueueDelay = 0.0f;
+				uint32_t stream = flow->ssrc - flow->ssrcBase;
+				if (stream < 4) {
+					RtpQueue* q = flow->rtpQueue[stream];
+					rtpQueueDelay = q->getDelay(time);
+					q->sendPacket(rtpPacket, size, ssrc_tmp, seqNr, isMark, timeStamp);
+					flow->bitsTransmitted[stream] += size * 8;
+				}
+				rtpQueueDelaySamples.push_back(rtpQueueDelay);
+				flow->stats.rtpQueueDelaySamples.push_back(rtpQueueDelay);
+
+				flow->netQueueDelay->insert(time, rtpPacket, flow->ssrc, size, seqNr, false, isMark, timeStamp, ecnBits);
+
+				flow->retVal = screamTx->addTransmitted(time_ntp, flow->ssrc, size, seqNr, isMark, rtpQueueDelay, timeStamp);
+				flow->nextCallN = int64_t(n) + max(1, (int)(65536.0f * flow->retVal));
+			}
+		}
+
+		for (int k = 0; k < nTcpFlows; k++) {
+			TcpCrossFlow* flow = tcpFlows[k];
+			if (time < flow->stats.tStart)
+				continue;
+			uint32_t tcpSeqNr;
+			while (flow->tcp->send(time, tcpSeqNr)) {
+				flow->netQueueDelay->insert(time, 0, flow->ssrc, params.tcpMss, 0, false, false, tcpSeqNr, flow->tcp->getEcn());
+			}
+		}
+
+		if (params.printLog && time - lastLogT > 0.05) {
+			cout << time << " ";
+			if (nScreamFlows > 0) {
+				char s[500];
+				screamFlows[0]->screamTx->getShortLog(time, s);
+				cout << " " << s;
+			}
+			for (int k = 0; k < nTcpFlows; k++)
+				cout << " " << tcpFlows[k]->stats.type << " cwnd " << int(tcpFlows[k]->tcp->cwnd);
+			cout << endl;
+			lastLogT = time;
+		}
+
+		if (params.isChRate && !linkTrace) {
+			if (time > 3.0 && time < 6) {
+				netQueueRate->rate = params.linkRateLow;
+			}
+			else {
+				netQueueRate->rate = params.linkRate;
+			}
+		}
+
+		if (nScreamFlows > 0) {
+			ScreamV2Tx* screamTx = screamFlows[0]->screamTx;
+			if (time > 20 && swprio == 0) {
+				swprio = 1;
+				screamTx->setTargetPriority(10, 0.2);
+				screamTx->setTargetPriority(11, 1.0);
+			}
+			if (time > 25 && swprio == 1) {
+				swprio = 2;
+				screamTx->setTargetPriority(10, 1.0);
+				screamTx->setTargetPriority(11, 0.2);
+			}
+		}
+
+
+		/*
+		* Schedule the next events, a component that has
+		* nothing pending does not need to be visited until its state changes
+		*/
+		for (int k = 0; k < nScreamFlows; k++) {
+			ScreamFlow* flow = screamFlows[k];
+			ScreamRx* screamRx = flow->screamRx;
+			if (n >= flow->nFirstFrame)
+				eventQueue->schedule(flow->evBase + kEvFrame, flow->nFirstFrame + ((n - flow->nFirstFrame) / tick + 1) * tick);
+
+			if (flow->nextCallN > int64_t(n))
+				eventQueue->schedule(flow->evBase + kEvPace, flow->nextCallN);
+
+			scheduleRelease(eventQueue, flow->evBase + kEvNetQueueDelay, n, flow->netQueueDelay->nextReleaseTime());
+			scheduleRelease(eventQueue, flow->evBase + kEvOooQueue, n, flow->oooQueue->nextReleaseTime(), true);
+
+			if (screamRx->isFeedback(time_ntp_rx)) {
+				/*
+				* Feedback is pending, it is transmitted at the latest when
+				* the RTCP feedback interval expires
+				*/
+				uint32_t elapsed = time_ntp_rx - screamRx->getLastFeedbackT();
+				uint32_t interval = screamRx->getRtcpFbInterval();
+				uint64_t nFb = n + 1;
+				if (elapsed <= interval)
+					nFb = n + (interval - elapsed) + 1;
+				eventQueue->schedule(flow->evBase + kEvFeedback, nFb);
+			}
+			else {
+				eventQueue->cancel(flow->evBase + kEvFeedback);
+			}
+		}
+
+		for (int k = 0; k < nTcpFlows; k++) {
+			TcpCrossFlow* flow = tcpFlows[k];
+			if (time >= flow->stats.tStart)
+				scheduleRelease(eventQueue, flow->evBase + kEvTcpSend, n, flow->tcp->nextSendTime());
+			scheduleRelease(eventQueue, flow->evBase + kEvTcpNetQueueDelay, n, flow->netQueueDelay->nextReleaseTime());
+		}
+
+		scheduleRelease(eventQueue, kEvNetQueueRate, n, netQueueRate->nextReleaseTime());
+
+		if (eventQueue->isPopped(kEvControl)) {
+			for (int k = 0; k < nControlN; k++) {
+				if (controlN[k] > n) {
+					eventQueue->schedule(kEvControl, controlN[k]);
+					break;
+				}
+			}
+		}
+
+		if (params.printLog && !eventQueue->isScheduled(kEvLog))
+			eventQueue->schedule(kEvLog, max(n + 1, timeToTick(float(lastLogT) + 0.05f, true)));
+	}
+	bitsCapacity += netQueueRate->rate * std::max(0.0f, params.Tmax - prevTime);
+	if (linkTrace) {
+		/*
+		* The capacity is given by the delivery opportunities up to Tmax
+		*/
+		netQueueRate->addBytes(params.Tmax);
+		bitsCapacity = linkTrace->getBytesOffered() * 8;
+	}
+
+	kpi.throughput = float(bitsDelivered / params.Tmax);
+	kpi.utilization = bitsCapacity > 0.0 ? float(bitsDelivered / bitsCapacity) : 0.0f;
+	kpi.queueDelayP50 = percentile(queueDelaySamples, 0.50f);
+	kpi.queueDelayP95 = percentile(queueDelaySamples, 0.95f);
+	kpi.queueDelayP99 = percentile(queueDelaySamples, 0.99f);
+	kpi.rtpQueueDelayP50 = percentile(rtpQueueDelaySamples, 0.50f);
+	kpi.rtpQueueDelayP95 = percentile(rtpQueueDelaySamples, 0.95f);
+	kpi.rtpQueueDelayP99 = percentile(rtpQueueDelaySamples, 0.99f);
+	kpi.nDelivered = int(queueDelaySamples.size());
+	kpi.ceRate = kpi.nDelivered > 0 ? float(nCe) / kpi.nDelivered : 0.0f;
+	kpi.nDropped = netQueueRate->nDropped;
+	kpi.nEvents = eventQueue->getNumberOfEvents();
+
+	/*
+	* Per flow KPIs, the throughput of a flow is counted from its start
+	*/
+	kpi.flows.clear();
+	for (int k = 0; k < nScreamFlows + nTcpFlows; k++) {
+		FlowStats& stats = k < nScreamFlows ? screamFlows[k]->stats : tcpFlows[k - nScreamFlows]->stats;
+		FlowKpi flowKpi;
+		flowKpi.type = stats.type;
+		flowKpi.tStart = stats.tStart;
+		if (params.Tmax > stats.tStart)
+			flowKpi.throughput = float(stats.bitsDelivered / (params.Tmax - stats.tStart));
+		flowKpi.queueDelayP50 = percentile(stats.queueDelaySamples, 0.50f);
+		flowKpi.queueDelayP95 = percentile(stats.queueDelaySamples, 0.95f);
+		flowKpi.queueDelayP99 = percentile(stats.queueDelaySamples, 0.99f);
+		flowKpi.rtpQueueDelayP50 = percentile(stats.rtpQueueDelaySamples, 0.50f);
+		flowKpi.rtpQueueDelayP95 = percentile(stats.rtpQueueDelaySamples, 0.95f);
+		flowKpi.rtpQueueDelayP99 = percentile(stats.rtpQueueDelaySamples, 0.99f);
+		flowKpi.nDelivered = int(stats.queueDelaySamples.size());
+		flowKpi.ceRate = flowKpi.nDelivered > 0 ? float(stats.nCe) / flowKpi.nDelivered : 0.0f;
+		flowKpi.nDropped = stats.nDropped;
+		kpi.flows.push_back(flowKpi);
+	}
+	kpi.fairness = jainFairness(kpi.flows);
+	if (nScreamFlows > 0) {
+		double bitsTransmitted = 0.0;
+		for (int n = 0; n < 4; n++)
+			bitsTransmitted += screamFlows[0]->bitsTransmitted[n];
+		for (int n = 0; n < 4 && bitsTransmitted > 0.0; n++)
+			kpi.streamShare[n] = float(screamFlows[0]->bitsTransmitted[n] / bitsTransmitted);
+	}
+
+	delete eventQueue;
+	for (int k = 0; k < nScreamFlows; k++)
+		delete screamFlows[k];
+	for (int k = 0; k < nTcpFlows; k++)
+		delete tcpFlows[k];
+	delete netQueueRate;
+	return true;
+}
@@ -0,0 +1,145 @@
+#ifndef SIMULATION
+#define SIMULATION
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+* Parameters for one simulation run, the defaults give the
+*  reference scenario of scream_sim
+*/
+class SimulationParams {
+public:
+	SimulationParams();
+
+	float Tmax;               // Simulation time [s]
+	bool isChRate;            // Link rate is linkRateLow between 3s and 6s
+	bool printLog;            // Print a short log on stdout every 50ms
+	bool ecnCapable;
+	bool isL4s;
+	const char* aqm;          // Bottleneck AQM, see NetQueueAqm.h, 0 = default ramp/step marker
+	float FR;                 // Frame rate for stream 0
+	int FR_DIV;               // Divisor for framerate for streams 1...N
+	bool enablePacing;
+	bool isFairQueueing;      // Fair queueing scheduler between the streams, see ScreamV2Tx::enableFairQueueing
+	bool isFrameDiscard;      // Discard stale frames instead of clearing the RTP queue, see ScreamV2Tx::enableFrameDiscard
+	int swprio;               // 0 = swap stream priorities at 20s and 25s
+	const char* traceFile;    // Video frame size trace
+	/*
+	* Mode determines how many streams should be run
+	* 0x1 = stream 0, 0x2 = stream 1, 0x3 = 1+2
+	*/
+	int mode;
+	float RTT;                // Two way propagation delay [s]
+	float linkRate;           // Bottleneck rate [bps]
+	float linkRateLow;        // Bottleneck rate [bps] between 3s and 6s if isChRate is true
+	const char* linkTrace;    // Bottleneck capacity trace (Mahimahi format), 0 = linkRate and isChRate apply
+	int mss;
+	int bufferSize;           // Bottleneck buffer size [byte], 0 = unlimited
+
+	/*
+	* Competing flows on the bottleneck. Each SCReAM flow is a ScreamV2Tx/ScreamRx
+	*  pair with the streams given by mode, the frames of the flows are evenly
+	*  spread in time. TCP flows are greedy TCP senders, see TcpFlow.h,
+	*  ECN capable if ecnCapable is true.
+	* All flows have the propagation delay RTT. Flow k starts at
+	*  k*flowStartInterval, the SCReAM flows come first.
+	*/
+	int nScreamFlows;
+	const char* tcpFlows;     // '+' separated list of reno, cubic and prague, 0 = no TCP flows
+	float flowStartInterval;  // [s]
+	int tcpMss;               // TCP segment size [byte]
+
+	/*
+	* ScreamV2Tx constructor parameters, see ScreamTx.h
+	*/
+	float lossBeta;
+	float ecnCeBeta;
+	float queueDelayTarget;
+	int cwnd;
+	float packetPacingHeadroom;
+	float maxAdaptivePacingRateScale;
+	float bytesInFlightHeadroom;
+	float multiplicativeIncreaseScalefactor;
+	float maxWindowHeadroom;
+
+	uint32_t seed;            // Seed for all random generators in the run
+	FILE* logFp;              // Detailed ScreamV2Tx log, 0 = no log
+};
+
+/*
+* KPIs for one flow
+*/
+class FlowKpi {
+public:
+	FlowKpi();
+
+	const char* type;         // "scream", "reno", "cubic" or "prague"
+	float tStart;             // Start time of the flow [s]
+	float throughput;         // Bitrate over the bottleneck from tStart [bps]
+	float queueDelayP50;      // Bottleneck queue delay percentiles [s]
+	float queueDelayP95;
+	float queueDelayP99;
+	float rtpQueueDelayP50;   // RTP queue delay percentiles [s], SCReAM flows only
+	float rtpQueueDelayP95;
+	float rtpQueueDelayP99;
+	float ceRate;             // Fraction of delivered packets that are CE marked
+	int nDelivered;
+	int nDropped;
+};
+
+/*
+* KPIs for one simulation run
+*/
+class SimulationKpi {
+public:
+	SimulationKpi();
+
+	float throughput;         // Bitrate over the bottleneck [bps]
+	float utilization;        // Fraction of the bottleneck capacity
+	float queueDelayP50;      // Bottleneck queue delay percentiles [s]
+	float queueDelayP95;
+	float queueDelayP99;
+	float rtpQueueDelayP50;   // RTP queue delay percentiles [s]
+	float rtpQueueDelayP95;
+	float rtpQueueDelayP99;
+	float ceRate;             // Fraction of delivered packets that are CE marked
+	int nDelivered;
+	int nDropped;
+	uint64_t nEvents;
+	float fairness;           // Jain's fairness index of the flow throughputs
+	float streamShare[4];     // Share of the transmitted bits per stream of the first SCReAM flow
+	std::vector<FlowKpi> flows; // SCReAM flows first, then TCP flows
+};
+
+/*
+* One run of the event driven SCReAM simulator.
+* All state is owned by the object, i.e several simulations
+*  can run in parallel in different threads
+*/
+class Simulation {
+public:
+	Simulation(const SimulationParams& params);
+
+	/*
+	* Run the simulation, return false if it could not be set up
+	*/
+	bool run(SimulationKpi& kpi);
+
+	/*
+	* Get the p:th percentile (0.0..1.0) of the samples,
+	*  the samples are reordered
+	*/
+	static float percentile(std::vector<float>& samples, float p);
+
+	/*
+	* Jain's fairness index (sum x)^2/(n*sum x^2) of the flow throughputs,
+	*  1.0 means equal throughput
+	*/
+	static float jainFairness(const std::vector<FlowKpi>& flows);
+
+	SimulationParams params;
+};
+
+#endif
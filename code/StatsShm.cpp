@@ -0,0 +1,103 @@
+#include "StatsShm.h"
+#include <iostream>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+using namespace std;
+
+/*
+* Shared memory statistics snapshot
+*/
+
+static const uint32_t kStatsShmMagic = 0x5343524d; // "SCRM"
+
+/*
+* A reader gives up after this many attempts if the writer keeps updating
+*  the snapshot, this does not happen in practice as publish() is fast
+*  compared to the publish interval
+*/
+static const int kMaxReadRetries = 1000;
+
+StatsShm::StatsShm(const char* name_, bool isWriter_) {
+	segment = 0;
+	isWriter = isWriter_;
+	strncpy(name, name_, sizeof(name) - 1);
+	name[sizeof(name) - 1] = 0;
+
+#ifdef _WIN32
+	cerr << "StatsShm: shared memory statistics are not supported on Windows" << endl;
+#else
+	int fd = shm_open(name, isWriter ? (O_CREAT | O_RDWR) : O_RDONLY, 0644);
+	if (fd < 0) {
+		perror("shm_open failed");
+		return;
+	}
+	if (isWriter && ftruncate(fd, sizeof(Segment)) < 0) {
+		perror("ftruncate failed");
+		close(fd);
+		return;
+	}
+	void* p = mmap(0, sizeof(Segment), isWriter ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		perror("mmap failed");
+		return;
+	}
+	segment = (Segment*)p;
+	if (isWriter) {
+		segment->seq.store(0, std::memory_order_relaxed);
+		memset(&segment->snapshot, 0, sizeof(StatsSnapshot));
+		segment->size = sizeof(StatsSnapshot);
+		segment->magic = kStatsShmMagic;
+	}
+	else if (segment->magic != kStatsShmMagic || segment->size != sizeof(StatsSnapshot)) {
+		cerr << "StatsShm: " << name << " is not a SCReAM statistics segment or has another version" << endl;
+		munmap(segment, sizeof(Segment));
+		segment = 0;
+	}
+#endif
+}
+
+StatsShm::~StatsShm() {
+	if (segment == 0)
+		return;
+#ifndef _WIN32
+	munmap(segment, sizeof(Segment));
+	if (isWriter)
+		shm_unlink(name);
+#endif
+}
+
+void StatsShm::publish(const StatsSnapshot& snapshot) {
+	if (segment == 0)
+		return;
+	uint32_t seq = segment->seq.load(std::memory_order_relaxed);
+	segment->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&segment->snapshot, &snapshot, sizeof(StatsSnapshot));
+	segment->seq.store(seq + 2, std::memory_order_release);
+}
+
+bool StatsShm::read(StatsSnapshot& snapshot) {
+	if (segment == 0)
+		return false;
+	for (int n = 0; n < kMaxReadRetries; n++) {
+		uint32_t seq = segment->seq.load(std::memory_order_acquire);
+		if (seq & 1)
+			continue;
+		memcpy(&snapshot, &segment->snapshot, sizeof(StatsSnapshot));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (segment->seq.load(std::memory_order_relaxed) == seq)
+			return seq != 0;
+	}
+	return false;
+}
+
+uint32_t StatsShm::getPublishCount() {
+	if (segment == 0)
+		return 0;
+	return segment->seq.load(std::memory_order_acquire) / 2;
+}
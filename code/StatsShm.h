@@ -0,0 +1,95 @@
+#ifndef STATS_SHM
+#define STATS_SHM
+
+#include <cstdint>
+#include <atomic>
+
+/*
+* Structured statistics snapshot of ScreamV2Tx, see ScreamV2Tx::getStatsSnapshot().
+* The snapshot is plain data with no pointers, it can be copied as is to
+*  shared memory or a file
+*/
+
+/*
+* Max number of streams in a snapshot, streams beyond this are not included
+*/
+const int kStatsMaxStreams = 16;
+
+struct StatsSnapshotStream {
+	uint32_t ssrc;
+	float targetBitrate;      // Target bitrate [bps]
+	float rateRtp;            // Media coder bitrate [bps]
+	float rateTransmitted;    // Transmitted bitrate [bps]
+	float rateAcked;          // ACKed bitrate [bps]
+	float rateLost;           // Lost bitrate [bps]
+	float rateCe;             // CE marked bitrate [bps]
+	float rtpQueueDelay;      // RTP queue delay [s]
+	int32_t rtpQueueBytes;    // RTP queue size [byte]
+	int32_t rtpQueueSize;     // RTP queue size [packets]
+	/*
+	* Packet counters, these are reset by ScreamV2Tx::getLog(.., clear = true)
+	*/
+	uint64_t packetsRtp;      // Number of RTP packets from the media coder
+	uint64_t packetsLost;     // Number of lost packets
+	uint64_t packetsCe;       // Number of CE marked packets
+};
+
+struct StatsSnapshot {
+	float time;               // [s]
+	int32_t cwnd;             // Congestion window [byte]
+	int32_t bytesInFlight;    // [byte]
+	float sRtt;               // Smoothed RTT [s]
+	float queueDelay;         // Estimated queue delay [s]
+	float queueDelayTarget;   // [s]
+	float l4sAlpha;           // Fraction of CE marked packets
+	float rateTransmitted;    // Total transmitted bitrate [bps]
+	int32_t isL4s;
+	int32_t nStreams;
+	StatsSnapshotStream streams[kStatsMaxStreams];
+};
+
+/*
+* A snapshot in a POSIX shared memory segment, protected by a seqlock.
+* The sender creates the segment and calls publish(), which never blocks.
+*  Any number of other processes can open the segment and call read() at
+*  any rate without touching the sender's threads, read() retries if the
+*  snapshot is updated while it is copied.
+* publish() must not be called concurrently from several threads
+*/
+class StatsShm {
+public:
+	/*
+	* Segment name, e.g /scream_stats, isWriter = true creates the segment
+	*/
+	StatsShm(const char* name, bool isWriter);
+	~StatsShm();
+
+	bool isOpen() { return segment != 0; }
+
+	void publish(const StatsSnapshot& snapshot);
+
+	/*
+	* Copy the last published snapshot, false is returned if nothing is published yet
+	*/
+	bool read(StatsSnapshot& snapshot);
+
+	/*
+	* Number of published snapshots
+	*/
+	uint32_t getPublishCount();
+
+private:
+	struct Segment {
+		uint32_t magic;
+		uint32_t size;  // sizeof(StatsSnapshot), guards against mismatching builds
+		std::atomic<uint32_t> seq; // Odd while the snapshot is written
+		char pad[52];
+		StatsSnapshot snapshot;
+	};
+
+	Segment* segment;
+	char name[64];
+	bool isWriter;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "TcpFlow.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+/*
+* Implements a model of a greedy TCP sender
+*/
+
+static const int kDupThresh = 3;
+static const int kInitialWindow = 10; // [segments]
+static const float kRenoBeta = 0.5f;
+static const float kCubicBeta = 0.7f;
+static const float kCubicC = 0.4f; // [segments/s^3]
+static const float kCubicAlphaAimd = 3.0f * (1.0f - kCubicBeta) / (1.0f + kCubicBeta);
+static const float kPragueG = 1.0f / 16;
+static const float kMinRto = 0.2f; // As Linux, RFC 6298 gives 1s
+static const float kInitialRto = 1.0f;
+static const float kPacingGainSlowStart = 2.0f;
+static const float kPacingGainCongestionAvoidance = 1.2f;
+
+TcpFlow::TcpFlow(Type type_, int mss_, bool ecnCapable) {
+	type = type_;
+	mss = mss_;
+	cwnd = float(kInitialWindow * mss);
+	ssthresh = 1e9f;
+	srtt = 0.0f;
+	rttVar = 0.0f;
+	alpha = 1.0f;
+	bytesInFlight = 0;
+	nLost = 0;
+	nCe = 0;
+	ecn = 0x00;
+	if (ecnCapable)
+		ecn = type == kPrague ? 0x01 : 0x02;
+	nextSeqNr = 0;
+	recoverSeqNr = 0;
+	isLossRecovery = false;
+	tNextSend = 0.0f;
+	wMax = 0.0f;
+	wEst = 0.0f;
+	k = 0.0f;
+	tEpoch = -1.0f;
+	alphaEndSeqNr = 0;
+	bytesAckedAlpha = 0;
+	bytesCeAlpha = 0;
+}
+
+bool TcpFlow::parseType(const char* name, Type& type) {
+	if (strcmp(name, "reno") == 0)
+		type = kReno;
+	else if (strcmp(name, "cubic") == 0)
+		type = kCubic;
+	else if (strcmp(name, "prague") == 0)
+		type = kPrague;
+	else
+		return false;
+	return true;
+}
+
+const char* TcpFlow::getTypeName(Type type) {
+	switch (type) {
+	case kReno: return "reno";
+	case kCubic: return "cubic";
+	case kPrague: return "prague";
+	}
+	return "";
+}
+
+float TcpFlow::retransmissionTimeout() {
+	if (srtt == 0.0f)
+		return kInitialRto;
+	return max(kMinRto, srtt + 4 * rttVar);
+}
+
+bool TcpFlow::send(float time, uint32_t& seqNr) {
+	if (!segments.empty() && time - segments.front().tSent >= retransmissionTimeout()) {
+		/*
+		* Retransmission timeout, all segments in flight are deemed lost
+		*  and the flow restarts in slow start
+		*/
+		for (size_t n = 0; n < segments.size(); n++) {
+			if (!segments[n].isAcked)
+				nLost++;
+		}
+		segments.clear();
+		bytesInFlight = 0;
+		wMax = cwnd;
+		ssthresh = max(cwnd * (type == kCubic ? kCubicBeta : kRenoBeta), float(2 * mss));
+		cwnd = float(mss);
+		tEpoch = -1.0f;
+		recoverSeqNr = nextSeqNr;
+		isLossRecovery = false;
+		tNextSend = time;
+	}
+
+	if (bytesInFlight >= cwnd || time < tNextSend)
+		return false;
+
+	seqNr = nextSeqNr++;
+	Segment segment;
+	segment.seqNr = seqNr;
+	segment.tSent = time;
+	segment.isAcked = false;
+	segments.push_back(segment);
+	bytesInFlight += mss;
+
+	if (srtt > 0.0f) {
+		float gain = cwnd < ssthresh ? kPacingGainSlowStart : kPacingGainCongestionAvoidance;
+		float pacingRate = gain * cwnd / srtt;
+		tNextSend = max(tNextSend, time) + mss / pacingRate;
+	}
+	return true;
+}
+
+void TcpFlow::ack(float time, uint32_t seqNr, bool isCe) {
+	if (segments.empty() || seqNr < segments.front().seqNr)
+		return; // Already deemed lost
+	size_t ix = seqNr - segments.front().seqNr;
+	if (ix >= segments.size() || segments[ix].isAcked)
+		return;
+	Segment& segment = segments[ix];
+	segment.isAcked = true;
+	bytesInFlight -= mss;
+
+	float rtt = time - segment.tSent;
+	if (srtt == 0.0f) {
+		srtt = rtt;
+		rttVar = rtt / 2;
+	}
+	else {
+		rttVar = 0.75f * rttVar + 0.25f * fabs(srtt - rtt);
+		srtt = 0.875f * srtt + 0.125f * rtt;
+	}
+
+	if (isCe)
+		nCe++;
+	if (type == kPrague) {
+		/*
+		* Update the fraction of CE marked bytes once per RTT
+		*/
+		bytesAckedAlpha += mss;
+		if (isCe)
+			bytesCeAlpha += mss;
+		if (seqNr >= alphaEndSeqNr) {
+			alpha += kPragueG * (float(bytesCeAlpha) / bytesAckedAlpha - alpha);
+			bytesAckedAlpha = 0;
+			bytesCeAlpha = 0;
+			alphaEndSeqNr = nextSeqNr;
+		}
+	}
+
+	if (isLossRecovery && seqNr >= recoverSeqNr)
+		isLossRecovery = false;
+
+	/*
+	* Segments that are kDupThresh or more behind the acknowledged segment are lost
+	*/
+	while (!segments.empty() && (segments.front().isAcked || segments.front().seqNr + kDupThresh <= seqNr)) {
+		if (!segments.front().isAcked) {
+			nLost++;
+			bytesInFlight -= mss;
+			congestion(time, segments.front().seqNr, true);
+		}
+		segments.pop_front();
+	}
+
+	if (isCe) {
+		/*
+		* Classic ECN, CE is handled like a loss (RFC 3168)
+		*/
+		congestion(time, seqNr, type != kPrague);
+	}
+
+	if (!isLossRecovery)
+		increase(time);
+}
+
+void TcpFlow::congestion(float time, uint32_t seqNr, bool isLoss) {
+	if (seqNr < recoverSeqNr)
+		return;
+	recoverSeqNr = nextSeqNr;
+	if (isLoss)
+		isLossRecovery = true;
+	switch (type) {
+	case kReno:
+		cwnd *= kRenoBeta;
+		break;
+	case kCubic:
+		/*
+		* Fast convergence, release bandwidth to new flows
+		*/
+		if (cwnd < wMax)
+			wMax = cwnd * (1.0f + kCubicBeta) / 2;
+		else
+			wMax = cwnd;
+		cwnd *= kCubicBeta;
+		tEpoch = -1.0f;
+		break;
+	case kPrague:
+		if (isLoss)
+			cwnd *= kRenoBeta;
+		else
+			cwnd *= 1.0f - alpha / 2;
+		break;
+	}
+	cwnd = max(cwnd, float(2 * mss));
+	ssthresh = cwnd;
+}
+
+void TcpFlow::increase(float time) {
+	if (cwnd < ssthresh) {
+		/*
+		* Slow start
+		*/
+		cwnd += mss;
+		return;
+	}
+	if (type != kCubic) {
+		cwnd += float(mss) * mss / cwnd;
+		return;
+	}
+
+	if (tEpoch < 0.0f) {
+		tEpoch = time;
+		if (cwnd < wMax) {
+			k = cbrtf((wMax - cwnd) / mss / kCubicC);
+		}
+		else {
+			k = 0.0f;
+			wMax = cwnd;
+		}
+		wEst = cwnd;
+	}
+	/*
+	* Window one RTT ahead, limited to 1.5 times the current window
+	*/
+	float t = time - tEpoch + srtt;
+	float wCubic = (kCubicC * (t - k) * (t - k) * (t - k)) * mss + wMax;
+	float target = min(max(wCubic, cwnd), 1.5f * cwnd);
+	cwnd += (target - cwnd) * mss / cwnd;
+	/*
+	* Reno friendly region
+	*/
+	wEst += kCubicAlphaAimd * mss * mss / cwnd;
+	cwnd = max(cwnd, wEst);
+}
+
+float TcpFlow::nextSendTime() {
+	float t = -1.0f;
+	if (!segments.empty())
+		t = segments.front().tSent + retransmissionTimeout();
+	if (bytesInFlight < cwnd)
+		t = t < 0.0f ? tNextSend : min(t, tNextSend);
+	return t;
+}
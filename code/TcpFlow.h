@@ -0,0 +1,119 @@
+#ifndef TCP_FLOW
+#define TCP_FLOW
+
+#include <cstdint>
+#include <deque>
+
+/*
+* Model of a greedy TCP sender for cross traffic in the simulator.
+* The congestion window follows Reno, Cubic (RFC 9438) or Prague
+*  (DCTCP style scalable ECN response), slow start is the same for all.
+* Every segment is acknowledged, a segment is deemed lost when
+*  kDupThresh later segments are acknowledged or when the
+*  retransmission timer expires. Lost segments are not retransmitted,
+*  new data is sent instead, i.e the flow models the throughput and
+*  the window dynamics rather than a reliable transfer.
+* Segments are paced at a rate given by cwnd and the smoothed RTT,
+*  as done by Linux.
+* Time is in seconds, sizes are in bytes
+*/
+class TcpFlow {
+public:
+	enum Type {
+		kReno,
+		kCubic,
+		kPrague
+	};
+
+	/*
+	* ecnCapable: Prague segments are ECT(1), Reno and Cubic segments
+	*  are ECT(0), CE marks are then handled like losses by Reno and Cubic.
+	*  Segments are Not-ECT otherwise
+	*/
+	TcpFlow(Type type, int mss = 1500, bool ecnCapable = true);
+
+	/*
+	* Get the type given by a name "reno", "cubic" or "prague",
+	*  return false if the name is unknown
+	*/
+	static bool parseType(const char* name, Type& type);
+
+	static const char* getTypeName(Type type);
+
+	/*
+	* Get a new segment to send, return false if the congestion window
+	*  or the pacing does not allow a transmission at this time.
+	*  Expired retransmission timers are handled here as well
+	*/
+	bool send(float time, uint32_t& seqNr);
+
+	/*
+	* Acknowledgement of the given segment, isCe is true
+	*  if the segment was CE marked
+	*/
+	void ack(float time, uint32_t seqNr, bool isCe);
+
+	/*
+	* Time [s] when send() should be called next,
+	*  -1.0 if the flow waits for acknowledgements only
+	*/
+	float nextSendTime();
+
+	/*
+	* ECN codepoint of the transmitted segments
+	*/
+	unsigned char getEcn() { return ecn; };
+
+	Type type;
+	int mss;
+	float cwnd;
+	float ssthresh;
+	float srtt;            // Smoothed RTT [s], 0 until the first RTT sample
+	float rttVar;
+	float alpha;           // Prague, fraction of CE marked bytes
+	int bytesInFlight;
+	int nLost;             // Number of segments deemed lost
+	int nCe;               // Number of CE marked segments acknowledged
+
+private:
+	class Segment {
+	public:
+		uint32_t seqNr;
+		float tSent;
+		bool isAcked;
+	};
+
+	/*
+	* Reduce the window, at most once per RTT
+	*/
+	void congestion(float time, uint32_t seqNr, bool isLoss);
+
+	/*
+	* Increase the window for one acknowledged segment
+	*/
+	void increase(float time);
+
+	float retransmissionTimeout();
+
+	unsigned char ecn;
+	std::deque<Segment> segments; // Segments in flight, ordered by seqNr
+	uint32_t nextSeqNr;
+	uint32_t recoverSeqNr;  // Segments sent before the last reduction are sent below this
+	bool isLossRecovery;    // The window is not increased until recoverSeqNr is acknowledged
+	float tNextSend;        // Earliest time of the next segment, given by the pacing
+	/*
+	* Cubic state
+	*/
+	float wMax;             // Window before the last reduction [byte]
+	float wEst;             // Reno friendly window estimate [byte]
+	float k;                // Time to reach wMax [s]
+	float tEpoch;           // Start of the congestion avoidance epoch, -1 = not started
+	/*
+	* Prague state, alpha is updated once per RTT
+	*/
+	uint32_t alphaEndSeqNr;
+	int bytesAckedAlpha;
+	int bytesCeAlpha;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef TX_LIST
+#define TX_LIST
+
+#include <cstdint>
+#include <cstring>
+
+/*
+* Table of the RTP packets in flight for one stream.
+* Packets are indexed by the extended (32 bit) RTP sequence number modulo
+*  the table size, which is a power of two. The packet data is stored as a
+*  structure of arrays and the used, ACKed, marker and received edge flags
+*  are stored as bitmaps, this keeps the loss detection and ACK scans compact.
+* A slot is reused when a packet that is getSize() sequence numbers later is
+*  added, the extended sequence number tells if a slot still holds a given packet.
+* The table is sized from the bandwidth delay product of the stream, see getSizeForBitrate()
+*/
+class TxList {
+public:
+	TxList(int size) {
+		mask = 0;
+		seqNr = 0;
+		timeTx_ntp = 0;
+		timeStamp = 0;
+		packetSize = 0;
+		rtpQueueDelay = 0;
+		used = 0;
+		acked = 0;
+		mark = 0;
+		afterReceivedEdge = 0;
+		resize(size);
+	}
+
+	~TxList() {
+		deleteArrays();
+	}
+
+	/*
+	* Table size needed for a stream with the given max bitrate [bps], the table holds the
+	*  packets sent during kRtt with an average packet size kPacketSize.
+	* The size is limited to kMaxSize as the ACKs carry 16 bit RTP sequence numbers
+	*  and more packets in flight than that can't be told apart
+	*/
+	static int getSizeForBitrate(float maxBitrate) {
+		const float kRtt = 0.25f;
+		const float kPacketSize = 1000.0f;
+		const int kMaxSize = 32768;
+		float n = maxBitrate / 8 * kRtt / kPacketSize;
+		int size = 64;
+		while (size < n && size < kMaxSize)
+			size *= 2;
+		return size;
+	}
+
+	int getSize() { return mask + 1; }
+
+	/*
+	* Grow the table to at least size entries (rounded up to a power of two),
+	*  the packets in the table are kept. The table is never made smaller
+	*/
+	void resize(int size) {
+		int n = 64;
+		while (n < size)
+			n *= 2;
+		if (seqNr != 0 && n <= getSize())
+			return;
+		uint32_t mask_ = n - 1;
+		uint32_t* seqNr_ = new uint32_t[n];
+		uint32_t* timeTx_ntp_ = new uint32_t[n];
+		uint32_t* timeStamp_ = new uint32_t[n];
+		int* packetSize_ = new int[n];
+		float* rtpQueueDelay_ = new float[n];
+		uint64_t* used_ = new uint64_t[n / 64];
+		uint64_t* acked_ = new uint64_t[n / 64];
+		uint64_t* mark_ = new uint64_t[n / 64];
+		uint64_t* afterReceivedEdge_ = new uint64_t[n / 64];
+		memset(used_, 0, n / 8);
+		memset(acked_, 0, n / 8);
+		memset(mark_, 0, n / 8);
+		memset(afterReceivedEdge_, 0, n / 8);
+		if (seqNr != 0) {
+			for (int ix = 0; ix <= int(mask); ix++) {
+				if (!getBit(used, ix))
+					continue;
+				int ixNew = seqNr[ix] & mask_;
+				seqNr_[ixNew] = seqNr[ix];
+				timeTx_ntp_[ixNew] = timeTx_ntp[ix];
+				timeStamp_[ixNew] = timeStamp[ix];
+				packetSize_[ixNew] = packetSize[ix];
+				rtpQueueDelay_[ixNew] = rtpQueueDelay[ix];
+				setBit(used_, ixNew, true);
+				setBit(acked_, ixNew, getBit(acked, ix));
+				setBit(mark_, ixNew, getBit(mark, ix));
+				setBit(afterReceivedEdge_, ixNew, getBit(afterReceivedEdge, ix));
+			}
+		}
+		deleteArrays();
+		mask = mask_;
+		seqNr = seqNr_;
+		timeTx_ntp = timeTx_ntp_;
+		timeStamp = timeStamp_;
+		packetSize = packetSize_;
+		rtpQueueDelay = rtpQueueDelay_;
+		used = used_;
+		acked = acked_;
+		mark = mark_;
+		afterReceivedEdge = afterReceivedEdge_;
+	}
+
+	/*
+	* Add a transmitted packet
+	*/
+	void add(uint32_t seqNrExt, uint32_t timeTx, int size, uint32_t timeStamp_, float rtpQueueDelay_, bool isMark) {
+		int ix = getIx(seqNrExt);
+		seqNr[ix] = seqNrExt;
+		timeTx_ntp[ix] = timeTx;
+		packetSize[ix] = size;
+		timeStamp[ix] = timeStamp_;
+		rtpQueueDelay[ix] = rtpQueueDelay_;
+		setBit(used, ix, true);
+		setBit(acked, ix, false);
+		setBit(mark, ix, isMark);
+		setBit(afterReceivedEdge, ix, false);
+	}
+
+	/*
+	* Remove all packets
+	*/
+	void clear() {
+		memset(used, 0, getSize() / 8);
+	}
+
+	int getIx(uint32_t seqNrExt) { return seqNrExt & mask; }
+
+	/*
+	* Return true if the slot ix holds the packet seqNrExt
+	*/
+	bool isInFlight(int ix, uint32_t seqNrExt) { return getBit(used, ix) && seqNr[ix] == seqNrExt; }
+
+	bool isUsed(int ix) { return getBit(used, ix); }
+	bool isAcked(int ix) { return getBit(acked, ix); }
+	bool isMark(int ix) { return getBit(mark, ix); }
+	bool isAfterReceivedEdge(int ix) { return getBit(afterReceivedEdge, ix); }
+
+	void setUsed(int ix, bool val) { setBit(used, ix, val); }
+	void setAcked(int ix, bool val) { setBit(acked, ix, val); }
+	void setAfterReceivedEdge(int ix, bool val) { setBit(afterReceivedEdge, ix, val); }
+
+	uint32_t mask;
+	uint32_t* seqNr;         // Extended RTP sequence number
+	uint32_t* timeTx_ntp;    // Transmit time
+	uint32_t* timeStamp;     // RTP timestamp
+	int* packetSize;          // Packet size [byte]
+	float* rtpQueueDelay;    // RTP queue delay when the packet was transmitted [s]
+
+private:
+	static bool getBit(const uint64_t* bits, int ix) {
+		return (bits[ix >> 6] >> (ix & 63)) & 1;
+	}
+
+	static void setBit(uint64_t* bits, int ix, bool val) {
+		uint64_t m = uint64_t(1) << (ix & 63);
+		if (val)
+			bits[ix >> 6] |= m;
+		else
+			bits[ix >> 6] &= ~m;
+	}
+
+	void deleteArrays() {
+		delete[] seqNr;
+		delete[] timeTx_ntp;
+		delete[] timeStamp;
+		delete[] packetSize;
+		delete[] rtpQueueDelay;
+		delete[] used;
+		delete[] acked;
+		delete[] mark;
+		delete[] afterReceivedEdge;
+	}
+
+	uint64_t* used;
+	uint64_t* acked;
+	uint64_t* mark;
+	uint64_t* afterReceivedEdge;
+};
+
+#endif
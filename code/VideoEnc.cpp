@@ -10,9 +10,9 @@ using namespace std;
 
 
 
-uint32_t SSRC = 1;
 VideoEnc::VideoEnc(RtpQueue* rtpQueue_, float frameRate_, char *fname, int ixOffset_, float sluggishness_) {
     rtpQueue = rtpQueue_;
+    ssrc = 1;
     frameRate = frameRate_;
     ix = ixOffset_;
     nFrames = 0;
@@ -60,7 +60,7 @@ int VideoEnc::encode(float time) {
         tmp2 -= rtpSize;
         rtpSize += kRtpOverHead;
         rtpBytes += rtpSize;
-        rtpQueue->push(rtpPacket, rtpSize, SSRC, seqNr, isMarker, time, timeStamp);
+        rtpQueue->push(rtpPacket, rtpSize, ssrc, seqNr, isMarker, time, timeStamp);
         seqNr++;
         timeStamp = (unsigned long)(time * 90000);
     }
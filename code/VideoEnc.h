@@ -16,6 +16,7 @@ public:
     }
 
     RtpQueue* rtpQueue;
+    unsigned int ssrc;
     float frameSize[MAX_FRAMES];
     int nFrames;
     float targetBitrate;
@@ -0,0 +1,497 @@
+// Microbenchmark for the ScreamV2Tx per packet hot path
+//
+
+#include "stdafx.h"
+#include "ScreamTx.h"
+#include "RtpQueue.h"
+#include <vector>
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <time.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+/*
+* ScreamV2Tx is driven by a synthetic sender and receiver:
+*  - Video frames of size targetBitrate/frameRate are packetized into the RTP queues
+*  - The packets pass a FIFO bottleneck with the given rate and a fixed one way delay,
+*     packets are CE marked (L4S) when the queue delay exceeds kCeThreshold
+*  - Loss bursts of lossBurst packets occur every lossInterval packets
+*  - RFC 8888 feedback with nReportedRtpPackets reports per stream is generated when
+*     nReportedRtpPackets/2 new packets are received or kFeedbackInterval expires
+* Only the time spent in the ScreamV2Tx calls is measured, each call is timed
+*  individually so that tail latencies can be given
+*/
+
+static const int kMss = 1200;
+static const float kFrameRate = 50.0f;
+static const float kOwd = 0.01f;                  // One way propagation delay [s]
+static const float kCeThreshold = 0.001f;         // L4S marking threshold [s]
+static const uint32_t kFeedbackInterval = 655;    // [Q16], 10ms
+static const int kMaxBenchStreams = 256;
+static const int kMaxBurst = 64;
+static const float kBurstInterval = 0.001f;      // Transmit budget interval [s]
+
+/*
+* Per call time samples for one function
+*/
+class CallStats {
+public:
+	CallStats() {
+		totalNs = 0;
+	};
+
+	void add(int64_t ns) {
+		ns = max(int64_t(0), ns);
+		samples.push_back(uint32_t(min(ns, int64_t(0xFFFFFFFF))));
+		totalNs += ns;
+	};
+
+	/*
+	* p:th percentile (0.0..1.0) [ns], the samples are reordered
+	*/
+	uint32_t percentile(float p) {
+		if (samples.empty())
+			return 0;
+		size_t ix = min(samples.size() - 1, size_t(p * samples.size()));
+		nth_element(samples.begin(), samples.begin() + ix, samples.end());
+		return samples[ix];
+	};
+
+	vector<uint32_t> samples;
+	uint64_t totalNs;
+};
+
+static inline int64_t nowNs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/*
+* Cost of a pair of nowNs() calls, subtracted from each sample
+*/
+static int64_t timerOverhead = 0;
+
+static void calibrateTimer() {
+	CallStats stats;
+	for (int n = 0; n < 100000; n++) {
+		int64_t t0 = nowNs();
+		int64_t t1 = nowNs();
+		stats.add(t1 - t0);
+	}
+	timerOverhead = stats.percentile(0.5f);
+}
+
+/*
+* Transmitted packet, indexed by stream and sequence number
+*/
+class TxRecord {
+public:
+	uint32_t rxTime_ntp;
+	uint8_t ceBits;
+	bool isSent;
+	bool isLost;
+};
+
+class BenchStream {
+public:
+	BenchStream() : tx(65536) {
+		rtpQueue = 0;
+		seqNr = 0;
+		nRx = 0;
+		hiSeqRx = 0;
+		nRxSinceFb = 0;
+		lastFbT_ntp = 0;
+	};
+
+	RtpQueue* rtpQueue;
+	uint32_t ssrc;
+	uint16_t seqNr;       // Next sequence number to packetize
+	vector<TxRecord> tx;
+	std::deque<uint16_t> inFlight; // Sequence numbers of the packets in the bottleneck
+	uint32_t nRx;         // Sequence number span that has passed the bottleneck
+	uint16_t hiSeqRx;     // Highest sequence number that has passed the bottleneck
+	int nRxSinceFb;
+	uint32_t lastFbT_ntp;
+};
+
+enum BenchFunction {
+	kNewMediaFrame,
+	kIsOkToTransmit,
+	kAddTransmitted,
+	kIncomingFeedback,
+	kNumBenchFunctions
+};
+
+static const char* kFunctionNames[kNumBenchFunctions] = {
+	"newMediaFrame",
+	"isOkToTransmit",
+	"addTransmitted",
+	"incomingStandardizedFeedback"
+};
+
+/*
+* Write an RFC 8888 feedback message for all streams with new received packets
+*/
+static int createFeedback(uint32_t time_ntp, vector<BenchStream*>& streams, int nReports, unsigned char* buf) {
+	buf[0] = 0x8B; // FMT = CCFB
+	buf[1] = 205;
+	uint32_t tmp_l = htonl(1);
+	memcpy(buf + 4, &tmp_l, 4);
+	int ptr = 8;
+	for (size_t k = 0; k < streams.size(); k++) {
+		BenchStream* stream = streams[k];
+		if (stream->nRxSinceFb == 0)
+			continue;
+		tmp_l = htonl(stream->ssrc);
+		memcpy(buf + ptr, &tmp_l, 4);
+		uint16_t beginSeq = stream->hiSeqRx - uint16_t(nReports - 1);
+		uint16_t tmp_s = htons(beginSeq);
+		memcpy(buf + ptr + 4, &tmp_s, 2);
+		tmp_s = htons(uint16_t(nReports - 1));
+		memcpy(buf + ptr + 6, &tmp_s, 2);
+		ptr += 8;
+		for (int n = 0; n < nReports; n++) {
+			uint16_t sn = beginSeq + n;
+			/*
+			* Sequence numbers before the first packet are not received,
+			*  nor are packets discarded from the RTP queue
+			*/
+			bool isRx = uint16_t(stream->hiSeqRx - sn) < stream->nRx;
+			const TxRecord& record = stream->tx[sn];
+			tmp_s = 0x0000;
+			if (isRx && record.isSent && !record.isLost) {
+				uint32_t ato = (time_ntp - record.rxTime_ntp) >> 6; // Q16->Q10
+				ato = min(ato, 0x1FFEu);
+				tmp_s = 0x8000 | ((record.ceBits & 0x03) << 13) | ato;
+			}
+			tmp_s = htons(tmp_s);
+			memcpy(buf + ptr, &tmp_s, 2);
+			ptr += 2;
+		}
+		if (nReports % 2 == 1) {
+			memset(buf + ptr, 0, 2);
+			ptr += 2;
+		}
+		stream->nRxSinceFb = 0;
+		stream->lastFbT_ntp = time_ntp;
+	}
+	tmp_l = htonl(time_ntp);
+	memcpy(buf + ptr, &tmp_l, 4);
+	ptr += 4;
+	uint16_t length = htons(uint16_t(ptr / 4 - 1));
+	memcpy(buf + 2, &length, 2);
+	return ptr;
+}
+
+/*
+* Run one configuration and print one CSV row per function
+*/
+static void runBench(int nStreams, int nReports, int lossBurst, int lossInterval, bool isL4s,
+	float rate, float duration, int burst) {
+	ScreamV2Tx* screamTx = new ScreamV2Tx(0.7f, 0.8f, 0.06f, 10000, 1.5f, 1.5f, 2.0f, 0.05f, isL4s, 3.0f, false, false);
+	int mssList[1] = { kMss };
+	screamTx->setCwndMinLow(2000);
+	screamTx->enablePacketPacing(true);
+	screamTx->enableRelaxedPacing(true);
+	screamTx->setMssListMinPacketsInFlight(mssList, 1, 5);
+	screamTx->isEnableAdaptiveWindowHeadroom(true);
+
+	vector<BenchStream*> streams;
+	for (int k = 0; k < nStreams; k++) {
+		BenchStream* stream = new BenchStream();
+		stream->rtpQueue = new RtpQueue();
+		stream->ssrc = 10 + k;
+		screamTx->registerNewStream(stream->rtpQueue, stream->ssrc, k == 0 ? 1.0f : 0.5f,
+			0.1e6f, 1e6f, rate / nStreams, 1.0f, false, 0.0f, false);
+		streams.push_back(stream);
+	}
+	vector<unsigned char> buf(16 + nStreams * (8 + 2 * (nReports + 1)));
+	uint32_t burstSsrc[kMaxBurst];
+	int burstSize[kMaxBurst];
+	uint16_t burstSeqNr[kMaxBurst];
+	bool burstIsMark[kMaxBurst];
+	float burstRtpQueueDelay[kMaxBurst];
+	uint32_t burstTimeStamp[kMaxBurst];
+	CallStats stats[kNumBenchFunctions];
+
+	const uint32_t frameInterval_ntp = uint32_t(65536 / kFrameRate);
+	const uint32_t end_ntp = uint32_t(duration * 65536);
+	uint32_t nextFrameT_ntp = 0;
+	int64_t nextCallT_ntp = -1;
+	double tLinkFree = 0.0;
+	uint64_t nPackets = 0;
+	uint64_t bytesTx = 0;
+	char rtpPacket[2000];
+
+	for (uint32_t time_ntp = 0; time_ntp < end_ntp; time_ntp++) {
+		bool isCall = int64_t(time_ntp) == nextCallT_ntp;
+		float time = time_ntp / 65536.0f;
+
+		if (time_ntp == nextFrameT_ntp) {
+			nextFrameT_ntp += frameInterval_ntp;
+			for (int k = 0; k < nStreams; k++) {
+				BenchStream* stream = streams[k];
+				int bytes = int(screamTx->getTargetBitrate(time_ntp, stream->ssrc) / kFrameRate / 8);
+				int bytesRtp = 0;
+				while (bytes > 0) {
+					int size = min(kMss, bytes);
+					bytes -= size;
+					if (!stream->rtpQueue->push(rtpPacket, size, stream->ssrc, stream->seqNr, bytes == 0, time, 0))
+						break;
+					stream->tx[stream->seqNr].isSent = false;
+					stream->seqNr++;
+					bytesRtp += size;
+				}
+				int64_t t0 = nowNs();
+				screamTx->newMediaFrame(time_ntp, stream->ssrc, bytesRtp, true);
+				stats[kNewMediaFrame].add(nowNs() - t0 - timerOverhead);
+			}
+			isCall = true;
+		}
+
+		/*
+		* Packets that have passed the bottleneck, feedback
+		*/
+		bool isFeedback = false;
+		for (int k = 0; k < nStreams; k++) {
+			BenchStream* stream = streams[k];
+			while (!stream->inFlight.empty() && stream->tx[stream->inFlight.front()].rxTime_ntp <= time_ntp) {
+				uint16_t sn = stream->inFlight.front();
+				stream->inFlight.pop_front();
+				stream->nRx += stream->nRx > 0 ? uint16_t(sn - stream->hiSeqRx) : sn + 1;
+				stream->hiSeqRx = sn;
+				stream->nRxSinceFb++;
+			}
+			if (stream->nRxSinceFb >= max(1, nReports / 2) ||
+				(stream->nRxSinceFb > 0 && time_ntp - stream->lastFbT_ntp > kFeedbackInterval))
+				isFeedback = true;
+		}
+		if (isFeedback) {
+			int size = createFeedback(time_ntp, streams, nReports, &buf[0]);
+			int64_t t0 = nowNs();
+			screamTx->incomingStandardizedFeedback(time_ntp, &buf[0], size);
+			stats[kIncomingFeedback].add(nowNs() - t0 - timerOverhead);
+			isCall = true;
+		}
+
+		while (isCall) {
+			isCall = false;
+			/*
+			* One RTP packet per isOkToTransmit call, or a burst given by getTransmitBudget
+			*/
+			uint32_t ssrc = 0;
+			int nBurst = 1;
+			int nBytes = 0;
+			int64_t t0 = nowNs();
+			float retVal;
+			if (burst > 1)
+				retVal = screamTx->getTransmitBudget(time_ntp, kBurstInterval, burst, burstSsrc, nBurst, nBytes);
+			else
+				retVal = screamTx->isOkToTransmit(time_ntp, ssrc);
+			stats[kIsOkToTransmit].add(nowNs() - t0 - timerOverhead);
+			if (retVal > 0)
+				nextCallT_ntp = int64_t(time_ntp) + max(1, int(retVal * 65536));
+			if (retVal != 0.0f)
+				break;
+			if (burst == 1)
+				burstSsrc[0] = ssrc;
+
+			int n = 0;
+			for (int k = 0; k < nBurst; k++) {
+				BenchStream* stream = streams[burstSsrc[k] - 10];
+				int size = stream->rtpQueue->sizeOfNextRtp();
+				if (size <= 0 || (burst > 1 && n > 0 && nBytes < size))
+					break;
+				nBytes -= size;
+				void* packet;
+				uint32_t ssrc_tmp, timeStamp;
+				uint16_t seqNr;
+				bool isMark;
+				float rtpQueueDelay = stream->rtpQueue->getDelay(time);
+				stream->rtpQueue->sendPacket(&packet, size, ssrc_tmp, seqNr, isMark, timeStamp);
+
+				/*
+				* FIFO bottleneck
+				*/
+				double tSerialization = size * 8 / rate;
+				double qDelay = max(0.0, tLinkFree - time);
+				tLinkFree = max(tLinkFree, double(time)) + tSerialization;
+				TxRecord& record = stream->tx[seqNr];
+				record.rxTime_ntp = uint32_t((tLinkFree + kOwd) * 65536);
+				record.ceBits = isL4s ? (qDelay > kCeThreshold ? 0x03 : 0x01) : 0x02;
+				record.isSent = true;
+				record.isLost = lossBurst > 0 && int(nPackets % lossInterval) < lossBurst;
+				stream->inFlight.push_back(seqNr);
+				nPackets++;
+				bytesTx += size;
+
+				burstSize[n] = size;
+				burstSeqNr[n] = seqNr;
+				burstIsMark[n] = isMark;
+				burstRtpQueueDelay[n] = rtpQueueDelay;
+				burstTimeStamp[n] = timeStamp;
+				n++;
+			}
+
+			t0 = nowNs();
+			if (burst > 1) {
+				retVal = screamTx->addTransmittedBatch(time_ntp, burstSsrc, burstSize, burstSeqNr, burstIsMark,
+					burstRtpQueueDelay, burstTimeStamp, n);
+			}
+			else {
+				retVal = screamTx->addTransmitted(time_ntp, burstSsrc[0], burstSize[0], burstSeqNr[0], burstIsMark[0],
+					burstRtpQueueDelay[0], burstTimeStamp[0]);
+			}
+			stats[kAddTransmitted].add(nowNs() - t0 - timerOverhead);
+			nextCallT_ntp = int64_t(time_ntp) + max(1, int(retVal * 65536));
+			isCall = retVal == 0.0f;
+		}
+	}
+
+	/*
+	* CPU share per Gbps, given by the time per transmitted packet
+	*/
+	double packetsPerGbps = nPackets > 0 ? 1e9 / (8.0 * bytesTx / nPackets) : 0.0;
+	uint64_t totalNs = 0;
+	for (int k = 0; k < kNumBenchFunctions; k++) {
+		CallStats& s = stats[k];
+		const char* name = kFunctionNames[k];
+		if (burst > 1 && k == kIsOkToTransmit)
+			name = "getTransmitBudget";
+		if (burst > 1 && k == kAddTransmitted)
+			name = "addTransmittedBatch";
+		totalNs += s.totalNs;
+		double meanNs = s.samples.empty() ? 0.0 : double(s.totalNs) / s.samples.size();
+		double cpuPct = nPackets > 0 ? double(s.totalNs) / nPackets * packetsPerGbps / 1e9 * 100 : 0.0;
+		printf("%d,%d,%d,%s,%s,%zu,%.1f,%u,%u,%u,%u,%.2f,%.3f\n",
+			nStreams, nReports, lossBurst, isL4s ? "on" : "off", name,
+			s.samples.size(), meanNs, s.percentile(0.5f), s.percentile(0.99f), s.percentile(0.999f),
+			s.percentile(1.0f), meanNs > 0.0 ? 1e3 / meanNs : 0.0, cpuPct);
+	}
+	double nsPerPacket = nPackets > 0 ? double(totalNs) / nPackets : 0.0;
+	printf("%d,%d,%d,%s,%s,%llu,%.1f,,,,,%.2f,%.3f\n",
+		nStreams, nReports, lossBurst, isL4s ? "on" : "off", "per_packet",
+		(unsigned long long)nPackets, nsPerPacket, nsPerPacket > 0.0 ? 1e3 / nsPerPacket : 0.0,
+		nsPerPacket * packetsPerGbps / 1e9 * 100);
+	fflush(stdout);
+
+	delete screamTx;
+	for (int k = 0; k < nStreams; k++) {
+		delete streams[k]->rtpQueue;
+		delete streams[k];
+	}
+}
+
+static bool parseInts(const char* s, vector<int>& values) {
+	values.clear();
+	char tmp[1000];
+	strncpy(tmp, s, sizeof(tmp) - 1);
+	tmp[sizeof(tmp) - 1] = 0;
+	char* save = 0;
+	for (char* tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(0, ",", &save))
+		values.push_back(atoi(tok));
+	return !values.empty();
+}
+
+int main(int argc, char* argv[]) {
+	vector<int> nStreamsList(1, 1);
+	vector<int> nReportsList;
+	nReportsList.push_back(32);
+	nReportsList.push_back(128);
+	nReportsList.push_back(512);
+	nReportsList.push_back(1024);
+	vector<int> lossBursts;
+	lossBursts.push_back(0);
+	lossBursts.push_back(16);
+	vector<int> l4sList;
+	l4sList.push_back(1);
+	l4sList.push_back(0);
+	int lossInterval = 1000;
+	int burst = 1;
+	float rate = 100e6f;
+	float duration = 10.0f;
+
+	if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "-help") == 0)) {
+		cerr << "SCReAM V2 sender microbenchmark. Ericsson AB." << endl;
+		cerr << "Usage : " << endl << " > scream_bench <options>" << endl;
+		cerr << " Lists are comma separated values, all combinations are run" << endl;
+		cerr << "     -streams list            Number of streams, max " << kMaxBenchStreams << " (default 1)" << endl;
+		cerr << "     -reports list            RTP packets per feedback and stream (default 32,128,512,1024)" << endl;
+		cerr << "     -lossburst list          Packets lost per loss burst (default 0,16)" << endl;
+		cerr << "     -lossinterval n          Packets between the starts of the loss bursts (default 1000)" << endl;
+		cerr << "     -l4s list                1 = L4S, 0 = classic ECN (default 1,0)" << endl;
+		cerr << "     -burst n                 Max RTP packets per transmit burst, n > 1 uses getTransmitBudget" << endl;
+		cerr << "                               and addTransmittedBatch, max " << kMaxBurst << " (default 1)" << endl;
+		cerr << "     -rate val                Bottleneck rate [bps] (default 100e6)" << endl;
+		cerr << "     -time val                Duration [s] of the media per run (default 10)" << endl;
+		cerr << " One CSV row per function and run is printed on stdout, times are in ns per call." << endl;
+		cerr << " cpu_pct_per_gbps is the CPU time per packet scaled to 1Gbps of media" << endl;
+		exit(-1);
+	}
+
+	int ix = 1;
+	while (ix < argc) {
+		bool isOk = true;
+		if (strcmp(argv[ix], "-streams") == 0 && ix + 1 < argc) {
+			isOk = parseInts(argv[ix + 1], nStreamsList);
+			for (size_t k = 0; k < nStreamsList.size(); k++)
+				isOk = isOk && nStreamsList[k] >= 1 && nStreamsList[k] <= kMaxBenchStreams;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-reports") == 0 && ix + 1 < argc) {
+			isOk = parseInts(argv[ix + 1], nReportsList);
+			for (size_t k = 0; k < nReportsList.size(); k++)
+				isOk = isOk && nReportsList[k] >= 1 && nReportsList[k] <= kMaxTxPackets / 2;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-lossburst") == 0 && ix + 1 < argc) {
+			isOk = parseInts(argv[ix + 1], lossBursts);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-lossinterval") == 0 && ix + 1 < argc) {
+			lossInterval = atoi(argv[ix + 1]);
+			isOk = lossInterval > 0;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-l4s") == 0 && ix + 1 < argc) {
+			isOk = parseInts(argv[ix + 1], l4sList);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-burst") == 0 && ix + 1 < argc) {
+			burst = atoi(argv[ix + 1]);
+			isOk = burst >= 1 && burst <= kMaxBurst;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-rate") == 0 && ix + 1 < argc) {
+			rate = atof(argv[ix + 1]);
+			isOk = rate > 0.0f;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-time") == 0 && ix + 1 < argc) {
+			duration = atof(argv[ix + 1]);
+			isOk = duration > 0.0f;
+			ix += 2;
+		}
+		else {
+			isOk = false;
+		}
+		if (!isOk) {
+			cerr << "Invalid option " << argv[ix] << ", scream_bench -h for help" << endl;
+			exit(-1);
+		}
+	}
+
+	calibrateTimer();
+	cerr << "Timer overhead " << timerOverhead << " ns, subtracted from the samples" << endl;
+	printf("streams,reports,lossburst,l4s,function,calls,mean_ns,p50_ns,p99_ns,p999_ns,max_ns,mcalls_per_s,cpu_pct_per_gbps\n");
+	for (size_t s = 0; s < nStreamsList.size(); s++)
+	for (size_t r = 0; r < nReportsList.size(); r++)
+	for (size_t l = 0; l < lossBursts.size(); l++)
+	for (size_t e = 0; e < l4sList.size(); e++)
+		runBench(nStreamsList[s], nReportsList[r], lossBursts[l], lossInterval, l4sList[e] != 0, rate, duration, burst);
+	return 0;
+}
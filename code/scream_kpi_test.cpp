@@ -0,0 +1,418 @@
+// KPI regression test for the SCReAM simulator
+//
+
+#include "stdafx.h"
+#include "Simulation.h"
+#include "RtpQueue.h"
+#include "ScreamTx.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+/*
+* Canonical scenarios, CTest runs one test per golden file
+*  test/golden/<scenario>.kpi and compares the KPIs against it.
+*  The kpi_scenarios test fails if a scenario has no golden file
+*  or a golden file has no scenario
+*/
+static const char* kScenarios[] = {
+	"rate_step",          // Reference scenario, L4S, 10Mbps with a drop to 5Mbps between 3s and 6s
+	"rate_step_classic",  // As rate_step with classic ECN and a step marker at 30ms
+	"key_frame",          // As rate_step with a video trace with key frames
+	"key_frame_discard",  // As key_frame with a drop to 1Mbps and frame discard instead of RTP queue clear
+	"multi_stream",       // Four streams with different priorities, the priorities are swapped at 20s and 25s
+	"multi_stream_fq",    // As multi_stream with the fair queueing scheduler
+	"competing_flows",    // Two SCReAM flows, a Cubic and a Prague flow over DualPI2
+	0
+};
+
+static bool setupScenario(const char* name, SimulationParams& params) {
+	if (strcmp(name, "rate_step") == 0) {
+		// The defaults
+	}
+	else if (strcmp(name, "rate_step_classic") == 0) {
+		params.isL4s = false;
+	}
+	else if (strcmp(name, "key_frame") == 0) {
+		params.traceFile = "./traces/trace_key.txt";
+	}
+	else if (strcmp(name, "key_frame_discard") == 0) {
+		params.traceFile = "./traces/trace_key.txt";
+		params.linkRateLow = 1000e3;
+		params.isFrameDiscard = true;
+	}
+	else if (strcmp(name, "multi_stream") == 0) {
+		params.mode = 0x0F;
+		params.swprio = 0;
+		params.Tmax = 30;
+	}
+	else if (strcmp(name, "multi_stream_fq") == 0) {
+		params.mode = 0x0F;
+		params.swprio = 0;
+		params.Tmax = 30;
+		params.isFairQueueing = true;
+	}
+	else if (strcmp(name, "competing_flows") == 0) {
+		params.nScreamFlows = 2;
+		params.tcpFlows = "cubic+prague";
+		params.aqm = "dualpi2";
+		params.isChRate = false;
+		params.flowStartInterval = 2.0f;
+		params.Tmax = 30;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/*
+* KPIs that are checked, a regression is a value that is worse than
+*  the golden value by more than the tolerance. The default tolerance
+*  is used when a golden file is created, it is max(tolAbs, tolRel*golden)
+*/
+class KpiDef {
+public:
+	const char* name;
+	int direction;     // 1 = higher is better, -1 = lower is better, 0 = a change either way is a regression
+	float tolAbs;
+	float tolRel;
+};
+
+static const KpiDef kKpis[] = {
+	{ "utilization",             1, 0.02f, 0.0f },
+	{ "fairness",                1, 0.05f, 0.0f },
+	{ "queue_delay_p50_ms",     -1, 1.0f,  0.2f },
+	{ "queue_delay_p95_ms",     -1, 1.0f,  0.2f },
+	{ "queue_delay_p99_ms",     -1, 2.0f,  0.2f },
+	{ "rtp_queue_delay_p50_ms", -1, 1.0f,  0.2f },
+	{ "rtp_queue_delay_p95_ms", -1, 2.0f,  0.2f },
+	{ "rtp_queue_delay_p99_ms", -1, 5.0f,  0.2f },
+	{ "stream_share_0",          0, 0.02f, 0.0f },
+	{ "stream_share_1",          0, 0.02f, 0.0f },
+	{ "stream_share_2",          0, 0.02f, 0.0f },
+	{ "stream_share_3",          0, 0.02f, 0.0f },
+};
+static const int kNumKpis = sizeof(kKpis) / sizeof(KpiDef);
+
+static void getKpiValues(const SimulationKpi& kpi, float* values) {
+	values[0] = kpi.utilization;
+	values[1] = kpi.fairness;
+	values[2] = kpi.queueDelayP50 * 1e3f;
+	values[3] = kpi.queueDelayP95 * 1e3f;
+	values[4] = kpi.queueDelayP99 * 1e3f;
+	values[5] = kpi.rtpQueueDelayP50 * 1e3f;
+	values[6] = kpi.rtpQueueDelayP95 * 1e3f;
+	values[7] = kpi.rtpQueueDelayP99 * 1e3f;
+	for (int n = 0; n < 4; n++)
+		values[8 + n] = kpi.streamShare[n];
+}
+
+/*
+* Golden file, one line per KPI with name, golden value and tolerance,
+*  lines that start with # are comments
+*/
+static bool readGolden(const char* fname, map<string, pair<float, float> >& golden) {
+	FILE* fp = fopen(fname, "r");
+	if (fp == 0)
+		return false;
+	char s[500];
+	while (fgets(s, sizeof(s), fp)) {
+		if (s[0] == '#')
+			continue;
+		char name[100];
+		float value, tolerance;
+		if (sscanf(s, "%99s %f %f", name, &value, &tolerance) == 3)
+			golden[name] = make_pair(value, tolerance);
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool writeGolden(const char* fname, const char* scenario, const float* values,
+	map<string, pair<float, float> >& golden) {
+	FILE* fp = fopen(fname, "w");
+	if (fp == 0)
+		return false;
+	fprintf(fp, "# Golden KPIs for the scenario %s, see scream_kpi_test.cpp\n", scenario);
+	fprintf(fp, "# Update with > ./bin/scream_kpi_test %s %s -update\n", scenario, fname);
+	fprintf(fp, "# kpi value tolerance\n");
+	for (int k = 0; k < kNumKpis; k++) {
+		/*
+		* Tolerances in an existing file are kept
+		*/
+		float tolerance = max(kKpis[k].tolAbs, kKpis[k].tolRel * values[k]);
+		if (golden.count(kKpis[k].name))
+			tolerance = golden[kKpis[k].name].second;
+		fprintf(fp, "%s %.4f %.4f\n", kKpis[k].name, values[k], tolerance);
+	}
+	fclose(fp);
+	return true;
+}
+
+/*
+* Fair queueing shares, three streams with the priorities 1.0, 0.5 and 0.25
+*  are kept backlogged and the transmitted bytes must be shared in proportion
+*  to the priorities even though stream 1 has smaller RTP packets
+*/
+static bool checkFqShares() {
+	const int kStreams = 3;
+	const float kPriority[kStreams] = { 1.0f, 0.5f, 0.25f };
+	const int kSize[kStreams] = { 1200, 300, 1200 };
+	const float kTolerance = 0.01f;
+	ScreamV2Tx* screamTx = new ScreamV2Tx();
+	screamTx->enableFairQueueing(true);
+	RtpQueue* rtpQueue[kStreams];
+	uint16_t seqNr[kStreams];
+	double bytes[kStreams];
+	for (int n = 0; n < kStreams; n++) {
+		rtpQueue[n] = new RtpQueue();
+		seqNr[n] = 0;
+		bytes[n] = 0.0;
+		screamTx->registerNewStream(rtpQueue[n], 10 + n, kPriority[n], 1e5f, 1e6f, 1e7f);
+	}
+	char buf[1500];
+	uint32_t time_ntp = 0;
+	for (int k = 0; k < 60000; k++) {
+		time_ntp += 10;
+		for (int n = 0; n < kStreams; n++) {
+			while (rtpQueue[n]->sizeOfQueue() < 5)
+				rtpQueue[n]->push(buf, kSize[n], 10 + n, seqNr[n]++, false, time_ntp / 65536.0f, 0);
+		}
+		uint32_t ssrc = 0;
+		screamTx->isOkToTransmit(time_ntp, ssrc);
+		int n = int(ssrc) - 10;
+		if (n < 0 || n >= kStreams)
+			continue;
+		void* rtpPacket;
+		int size;
+		uint16_t sn;
+		bool isMark;
+		uint32_t timeStamp;
+		rtpQueue[n]->pop(&rtpPacket, size, ssrc, sn, isMark, timeStamp);
+		screamTx->addTransmitted(time_ntp, ssrc, size, sn, isMark);
+		bytes[n] += size;
+	}
+	double totalBytes = 0.0;
+	float totalPriority = 0.0f;
+	for (int n = 0; n < kStreams; n++) {
+		totalBytes += bytes[n];
+		totalPriority += kPriority[n];
+	}
+	bool isOk = totalBytes > 0.0;
+	for (int n = 0; n < kStreams; n++) {
+		float share = totalBytes > 0.0 ? float(bytes[n] / totalBytes) : 0.0f;
+		float target = kPriority[n] / totalPriority;
+		const char* verdict = "ok";
+		if (fabs(share - target) > kTolerance) {
+			verdict = "REGRESSION";
+			isOk = false;
+		}
+		char s[300];
+		snprintf(s, sizeof(s), "stream %d share %.4f  target %.4f +/- %.4f  %s", n, share, target, kTolerance, verdict);
+		cout << s << endl;
+	}
+	delete screamTx;
+	for (int n = 0; n < kStreams; n++)
+		delete rtpQueue[n];
+	cout << "fq_shares: " << (isOk ? "passed" : "failed") << endl;
+	return isOk;
+}
+
+/*
+* Frame discard, a stream with maxRtpQueueDelay 0.1s queues delta frames from
+*  t=0 to 0.1s, a key frame (not discardable) at 0.12s and then delta frames.
+*  Nothing is transmitted. At 0.28s the stale delta frames are discarded and
+*  listed by getDiscardedFrames(), the late key frame is kept at the head of the
+*  RTP queue. At 0.34s the key frame is 0.22s old and the queue is cleared
+*/
+static bool checkFrameDiscard() {
+	const float kFrameInterval = 0.02f;
+	const int kKeyFrame = 6;
+	const int kCheckFrame = 14;
+	const int kClearFrame = 17;
+	const int kPacketsPerFrame = 3;
+	ScreamV2Tx* screamTx = new ScreamV2Tx();
+	screamTx->enableFrameDiscard(true);
+	RtpQueue* rtpQueue = new RtpQueue();
+	screamTx->registerNewStream(rtpQueue, 10, 1.0f, 1e5f, 1e6f, 1e7f, 0.1f);
+	/*
+	* Initialize 0.5s ahead, the RTP queue is otherwise cleared for the
+	*  base delay refresh during the first RTTs
+	*/
+	uint32_t ssrc = 0;
+	screamTx->isOkToTransmit(uint32_t(0.5f * 65536.0f), ssrc);
+	bool isOk = true;
+	uint16_t seqNr = 0;
+	int nDiscarded = 0;
+	for (int f = 0; f <= kClearFrame; f++) {
+		float time = 1.0f + f * kFrameInterval;
+		uint32_t time_ntp = uint32_t(time * 65536.0f);
+		for (int n = 0; n < kPacketsPerFrame; n++) {
+			rtpQueue->push(0, 1000, 10, seqNr++, n == kPacketsPerFrame - 1, time, f * 1800, f != kKeyFrame);
+			screamTx->newMediaFrame(time_ntp, 10, 1000, n == kPacketsPerFrame - 1);
+		}
+		uint32_t timeStamps[kMaxDiscardedFrames];
+		int nFrames = screamTx->getDiscardedFrames(10, timeStamps, kMaxDiscardedFrames);
+		for (int n = 0; n < nFrames; n++) {
+			if (timeStamps[n] != uint32_t(nDiscarded * 1800)) {
+				cout << "frame " << f << ": discarded timestamp " << timeStamps[n] << ", expected " << nDiscarded * 1800 << endl;
+				isOk = false;
+			}
+			nDiscarded++;
+		}
+		bool isLossEpoch = screamTx->isLossEpoch(10);
+		if (f == kCheckFrame) {
+			cout << "discarded frames " << nDiscarded << ", expected " << kKeyFrame << endl;
+			cout << "next RTP seqNr " << rtpQueue->seqNrOfNextRtp() << ", expected key frame " << kKeyFrame * kPacketsPerFrame << endl;
+			isOk = isOk && nDiscarded == kKeyFrame && rtpQueue->seqNrOfNextRtp() == kKeyFrame * kPacketsPerFrame;
+		}
+		if (f < kClearFrame && isLossEpoch) {
+			cout << "frame " << f << ": RTP queue cleared before the key frame was 0.2s old" << endl;
+			isOk = false;
+		}
+		if (f == kClearFrame) {
+			cout << "next RTP seqNr " << rtpQueue->seqNrOfNextRtp() << " after the key frame is 0.2s old, expected cleared" << endl;
+			isOk = isOk && isLossEpoch && rtpQueue->seqNrOfNextRtp() > kKeyFrame * kPacketsPerFrame;
+		}
+	}
+	delete screamTx;
+	delete rtpQueue;
+	cout << "frame_discard: " << (isOk ? "passed" : "failed") << endl;
+	return isOk;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1 && strcmp(argv[1], "-list") == 0) {
+		for (int k = 0; kScenarios[k]; k++)
+			cout << kScenarios[k] << endl;
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "-fqshares") == 0) {
+		return checkFqShares() ? 0 : 1;
+	}
+	if (argc > 1 && strcmp(argv[1], "-framediscard") == 0) {
+		return checkFrameDiscard() ? 0 : 1;
+	}
+	if (argc > 1 && strcmp(argv[1], "-check") == 0) {
+		/*
+		* The golden files are given as arguments, match them
+		*  against the scenarios by base name
+		*/
+		vector<string> names;
+		for (int n = 2; n < argc; n++) {
+			string name = argv[n];
+			size_t pos = name.find_last_of("/\\");
+			if (pos != string::npos)
+				name = name.substr(pos + 1);
+			pos = name.rfind(".kpi");
+			if (pos != string::npos)
+				name = name.substr(0, pos);
+			names.push_back(name);
+		}
+		int nErrors = 0;
+		for (int k = 0; kScenarios[k]; k++) {
+			if (find(names.begin(), names.end(), kScenarios[k]) == names.end()) {
+				cerr << "Scenario " << kScenarios[k] << " has no golden file, create it with -update" << endl;
+				nErrors++;
+			}
+		}
+		for (int n = 0; n < int(names.size()); n++) {
+			bool isFound = false;
+			for (int k = 0; kScenarios[k]; k++)
+				isFound |= names[n] == kScenarios[k];
+			if (!isFound) {
+				cerr << "Golden file " << argv[n + 2] << " has no scenario" << endl;
+				nErrors++;
+			}
+		}
+		if (nErrors > 0)
+			return 1;
+		cout << names.size() << " scenarios with golden files" << endl;
+		return 0;
+	}
+	if (argc < 3) {
+		cerr << "SCReAM V2 simulator KPI regression test. Ericsson AB." << endl;
+		cerr << "Usage : " << endl;
+		cerr << " > scream_kpi_test scenario goldenfile [-update]" << endl;
+		cerr << " > scream_kpi_test -list" << endl;
+		cerr << " > scream_kpi_test -check goldenfile ..." << endl;
+		cerr << " > scream_kpi_test -fqshares" << endl;
+		cerr << " > scream_kpi_test -framediscard" << endl;
+		cerr << "     -update       Write the KPIs of the run to the golden file" << endl;
+		cerr << "     -list         List the scenarios" << endl;
+		cerr << "     -check        Check that the golden files match the scenarios" << endl;
+		cerr << "     -fqshares     Check the fair queueing shares of backlogged streams" << endl;
+		cerr << "     -framediscard Check that stale frames are discarded and key frames are kept" << endl;
+		cerr << " Run from the repo root so that the traces are found" << endl;
+		exit(-1);
+	}
+	const char* scenario = argv[1];
+	const char* goldenFile = argv[2];
+	bool isUpdate = argc > 3 && strcmp(argv[3], "-update") == 0;
+
+	SimulationParams params;
+	if (!setupScenario(scenario, params)) {
+		cerr << "Unknown scenario " << scenario << ", scream_kpi_test -list for a list" << endl;
+		return 1;
+	}
+	SimulationKpi kpi;
+	Simulation simulation(params);
+	if (!simulation.run(kpi))
+		return 1;
+	float values[kNumKpis];
+	getKpiValues(kpi, values);
+
+	map<string, pair<float, float> > golden;
+	bool hasGolden = readGolden(goldenFile, golden);
+	if (isUpdate) {
+		if (!writeGolden(goldenFile, scenario, values, golden)) {
+			cerr << "Cannot write " << goldenFile << endl;
+			return 1;
+		}
+		cout << "Updated " << goldenFile << endl;
+		return 0;
+	}
+	if (!hasGolden) {
+		cerr << "Cannot open " << goldenFile << ", create it with -update" << endl;
+		return 1;
+	}
+
+	int nRegressions = 0;
+	for (int k = 0; k < kNumKpis; k++) {
+		const KpiDef& def = kKpis[k];
+		char s[300];
+		if (golden.count(def.name) == 0) {
+			snprintf(s, sizeof(s), "%-24s %10.4f  no golden value", def.name, values[k]);
+			cout << s << endl;
+			nRegressions++;
+			continue;
+		}
+		float goldenValue = golden[def.name].first;
+		float tolerance = golden[def.name].second;
+		float diff = fabs(values[k] - goldenValue);
+		if (def.direction != 0)
+			diff = def.direction > 0 ? goldenValue - values[k] : values[k] - goldenValue;
+		const char* verdict = "ok";
+		if (diff > tolerance) {
+			verdict = "REGRESSION";
+			nRegressions++;
+		}
+		else if (def.direction != 0 && -diff > tolerance) {
+			verdict = "improved, consider updating the golden file";
+		}
+		snprintf(s, sizeof(s), "%-24s %10.4f  golden %10.4f +/- %.4f  %s",
+			def.name, values[k], goldenValue, tolerance, verdict);
+		cout << s << endl;
+	}
+	if (nRegressions > 0) {
+		cout << scenario << ": " << nRegressions << " KPI regressions" << endl;
+		return 1;
+	}
+	cout << scenario << ": passed" << endl;
+	return 0;
+}
@@ -0,0 +1,110 @@
+// Converts a binary event log from scream_bw_test_tx -binlog to CSV
+//
+#include "ScreamTx.h"
+#include "EventLog.h"
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc <= 1) {
+		cerr << "SCReAM binary event log converter. Ericsson AB." << endl;
+		cerr << "Usage : " << endl << " > scream_log_convert <options> binlog " << endl;
+		cerr << "  The output is the same as the -log and -txrxlog options of scream_bw_test_tx" << endl;
+		cerr << "     -log file                Write the detailed per-ACK log to file (default stdout)" << endl;
+		cerr << "     -txrxlog file            Write the tx and rx timestamps for RTP packets to file" << endl;
+		cerr << "     -itemlist                Add item list in beginning of the detailed log" << endl;
+		exit(-1);
+	}
+	int ix = 1;
+	char* logFile = 0;
+	char* txRxLogFile = 0;
+	bool itemlist = false;
+	while (ix < argc - 1 && strstr(argv[ix], "-")) {
+		if (strstr(argv[ix], "-txrxlog")) {
+			txRxLogFile = argv[ix + 1];
+			ix += 2;
+			continue;
+		}
+		if (strstr(argv[ix], "-log")) {
+			logFile = argv[ix + 1];
+			ix += 2;
+			continue;
+		}
+		if (strstr(argv[ix], "-itemlist")) {
+			itemlist = true;
+			ix++;
+			continue;
+		}
+		cerr << "unexpected option " << argv[ix] << endl;
+		exit(-1);
+	}
+
+	void* file = EventLog::openFile(argv[ix]);
+	if (file == 0) {
+		cerr << "could not open " << argv[ix] << endl;
+		exit(-1);
+	}
+	FILE* fp_log = logFile ? fopen(logFile, "w") : stdout;
+	FILE* fp_txrxlog = txRxLogFile ? fopen(txRxLogFile, "w") : 0;
+	if (fp_log == 0 || (txRxLogFile && fp_txrxlog == 0)) {
+		cerr << "could not open output file" << endl;
+		exit(-1);
+	}
+	if (itemlist)
+		fprintf(fp_log, "%s\n", ScreamV2Tx::getDetailedLogItemList());
+
+	EventLogRecord record;
+	char extraData[256] = "";
+	int nextExtraDataSeqNr = 0;
+	char s[1000];
+	int nRecords = 0;
+	while (EventLog::readRecord(file, record)) {
+		nRecords++;
+		switch (record.type) {
+		case kEventLogDetailed:
+			if (nextExtraDataSeqNr != 0) {
+				/*
+				* The last part of the extra data is missing
+				*/
+				extraData[0] = 0;
+				nextExtraDataSeqNr = 0;
+			}
+			EventLog::formatRecord(record, extraData, s);
+			fputs(s, fp_log);
+			break;
+		case kEventLogTxRx:
+		case kEventLogTxRxLost:
+			if (fp_txrxlog) {
+				EventLog::formatRecord(record, extraData, s);
+				fputs(s, fp_txrxlog);
+			}
+			break;
+		case kEventLogExtraData:
+			/*
+			* The extra data is split over several records and the last one is
+			*  not full. A string with missing parts is dropped, this does not
+			*  happen with logs from ScreamV2Tx which pushes the parts as a unit
+			*/
+			if (record.seqNr == 0)
+				extraData[0] = 0;
+			else if (record.seqNr != nextExtraDataSeqNr) {
+				extraData[0] = 0;
+				nextExtraDataSeqNr = 0;
+				break;
+			}
+			record.u.extraData[kEventLogExtraDataSize - 1] = 0;
+			nextExtraDataSeqNr = (strlen(record.u.extraData) < kEventLogExtraDataSize - 1) ? 0 : record.seqNr + 1;
+			if (strlen(extraData) + strlen(record.u.extraData) < sizeof(extraData))
+				strcat(extraData, record.u.extraData);
+			break;
+		}
+	}
+	EventLog::closeFile(file);
+	if (logFile)
+		fclose(fp_log);
+	if (fp_txrxlog)
+		fclose(fp_txrxlog);
+	cerr << nRecords << " records converted" << endl;
+	return 0;
+}
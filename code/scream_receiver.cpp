@@ -1,5 +1,6 @@
 // Scream sender side wrapper
 #include "ScreamRx.h"
+#include "Clock.h"
 #include "sys/socket.h"
 #include "sys/types.h"
 #include "netinet/in.h"
@@ -70,7 +71,7 @@ char* ifname = 0;
 
 int nPrint = 0;
 pthread_mutex_t lock_scream;
-double t0 = 0;
+Clock* appClock = 0;
 
 bool ipv6 = false;
 
@@ -80,12 +81,7 @@ bool ipv6 = false;
 * 16 least significant bits is fraction
 */
 uint32_t getTimeInNtp() {
-	struct timeval tp;
-	gettimeofday(&tp, NULL);
-	double time = (tp.tv_sec + tp.tv_usec * 1e-6) - t0;
-	uint64_t ntp64 = uint64_t(time * 65536);
-	uint32_t ntp = 0xFFFFFFFF & (ntp64); // NTP in Q16
-	return ntp;
+	return appClock->getTimeInNtp();
 }
 
 /*
@@ -201,7 +197,7 @@ void* rtcpPeriodicThread(void* arg) {
 			}
 			lastPunchNatT_ntp = getTimeInNtp();
 		}
-		usleep(500);
+		appClock->sleepUs(500);
 	}
 }
 
@@ -267,9 +263,7 @@ int main(int argc, char* argv[])
 	}
 
 
-	struct timeval tp;
-	gettimeofday(&tp, NULL);
-	t0 = (tp.tv_sec + tp.tv_usec * 1e-6) - 1e-3;
+	appClock = new RealClock();
 
 	screamRx = new ScreamRx(10, ackDiff, nReportedRtpPackets);
 
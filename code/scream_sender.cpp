@@ -1,6 +1,9 @@
 // Scream sender side wrapper
 #include "ScreamTx.h"
 #include "RtpQueue.h"
+#include "EventLog.h"
+#include "StatsShm.h"
+#include "Clock.h"
 #include "sys/socket.h"
 #include "sys/types.h"
 #include "netinet/in.h"
@@ -16,6 +19,10 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <errno.h>
+#include <time.h>
+#include <linux/net_tstamp.h>
 struct itimerval timer;
 struct sigaction sa;
 
@@ -32,6 +39,23 @@ using namespace std;
 float minPaceInterval = 0.0005f;
 int minPaceIntervalUs = 500;
 
+/*
+* Departure time stamping with SO_TXTIME, the kernel (fq or etf qdisc) releases
+*  each packet at its departure time and the transmit thread only needs to wake
+*  up once every microburst interval.
+* fq uses CLOCK_MONOTONIC and etf uses CLOCK_TAI
+*/
+bool useTxTime = false;
+clockid_t txTimeClock = CLOCK_MONOTONIC;
+uint64_t nextTxTime_ns = 0;
+
+/*
+* Event loop mode, frame generation, packet pacing and RTCP reception
+*  are multiplexed with epoll in a single thread, no locks are needed
+*/
+bool useEventLoop = false;
+bool isPaceTimerArmed = false;
+
 #define ECN_CAPABLE
 /*
 * ECN capable
@@ -61,6 +85,7 @@ float burstSleepTime = -1.0;
 bool pushTraffic = false;
 float maxWindowHeadroom = 5.0f;
 bool relaxedPacing = false;
+bool frameDiscard = false;
 float packetPacingHeadroom = 1.5f;
 float scaleFactor = 0.7f;
 ScreamV2Tx* screamTx = 0;
@@ -118,11 +143,25 @@ uint32_t lastLogTv_ntp = 0;
 uint32_t tD_ntp = 0;//(INT64_C(1) << 32)*1000 - 5000000;
 
 pthread_mutex_t lock_scream;
-pthread_mutex_t lock_rtp_queue;
 pthread_mutex_t lock_pace;
 
+/*
+* The locks are only needed when the sender runs in multiple threads
+*/
+void lock(pthread_mutex_t* mutex) {
+	if (!useEventLoop)
+		pthread_mutex_lock(mutex);
+}
+
+void unlock(pthread_mutex_t* mutex) {
+	if (!useEventLoop)
+		pthread_mutex_unlock(mutex);
+}
+
 FILE* fp_log = 0;
 FILE* fp_txrxlog = 0;
+EventLog* eventLog = 0;
+StatsShm* statsShm = 0;
 
 char* ifname = 0;
 
@@ -133,7 +172,11 @@ bool detailed = false;
 float randRate = 0.0f;
 bool ipv6 = false;
 
-double t0 = 0;
+/*
+* All time reads and sleeps go through appClock, except for the event loop
+*  timers and the SO_TXTIME departure times which are kernel clocks
+*/
+Clock* appClock = 0;
 /*
 long getTimeInUs(){
 struct timeval tp;
@@ -148,12 +191,14 @@ void packet_free(void* buf, uint32_t ssrc) {
 }
 
 uint32_t getTimeInNtp() {
-	struct timeval tp;
-	gettimeofday(&tp, NULL);
-	double time = tp.tv_sec + tp.tv_usec * 1e-6 - t0;
-	uint64_t ntp64 = uint64_t(time * 65536.0);
-	uint32_t ntp = 0xFFFFFFFF & ntp64;
-	return ntp;
+	return appClock->getTimeInNtp();
+}
+
+/*
+* Time in Q32 for the high resolution packet pacing, getTimeInNtp() is the mid 32 bits
+*/
+uint64_t getTimeInNtpQ32() {
+	return appClock->getTimeInNtpQ32();
 }
 
 // Accumulated pace time, used to avoid starting very short pace timers
@@ -201,6 +246,47 @@ void sendPacket(void* buf, int size) {
 		sendto(fd_outgoing_rtp, buf, size, 0, (struct sockaddr*)&outgoing_rtp_addr, sizeof(outgoing_rtp_addr));
 }
 
+uint64_t getTxTimeInNs() {
+	struct timespec tp;
+	clock_gettime(txTimeClock, &tp);
+	return uint64_t(tp.tv_sec) * 1000000000ull + tp.tv_nsec;
+}
+
+/*
+* Send a packet with a departure time txTime_ns [ns] in the txTimeClock domain
+*/
+void sendPacketAt(void* buf, int size, uint64_t txTime_ns) {
+#ifdef SO_TXTIME
+	struct msghdr msg;
+	struct iovec iov;
+	char control[CMSG_SPACE(sizeof(uint64_t))];
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (ipv6) {
+		msg.msg_name = &outgoing_rtp_addr6;
+		msg.msg_namelen = sizeof(outgoing_rtp_addr6);
+	}
+	else {
+		msg.msg_name = &outgoing_rtp_addr;
+		msg.msg_namelen = sizeof(outgoing_rtp_addr);
+	}
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TXTIME;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+	memcpy(CMSG_DATA(cmsg), &txTime_ns, sizeof(uint64_t));
+	sendmsg(fd_outgoing_rtp, &msg, 0);
+#else
+	sendPacket(buf, size);
+#endif
+}
+
 /*
 * Transmit a packet if possible.
 * If not allowed due to packet pacing restrictions,
@@ -214,7 +300,6 @@ void* transmitRtpThread(void* arg) {
 	char buf[2000];
 	uint32_t time_ntp = getTimeInNtp();
 	float retVal = 0.0f;
-	struct timeval start, end;
 	useconds_t diff = 0;
 
 	accumulatedPaceTime = 0.0;
@@ -228,11 +313,10 @@ void* transmitRtpThread(void* arg) {
 
 		while (retVal == -1.0f) {
 			pthread_mutex_lock(&lock_scream);
-			time_ntp = getTimeInNtp();
-			retVal = screamTx->isOkToTransmit(time_ntp, SSRC);
+			retVal = screamTx->isOkToTransmitQ32(getTimeInNtpQ32(), SSRC);
 			pthread_mutex_unlock(&lock_scream);
 			if (retVal == -1.0f) {
-				usleep(10);
+				appClock->sleepUs(10);
 				nTx = 0;
 			}
 
@@ -240,14 +324,32 @@ void* transmitRtpThread(void* arg) {
 		
 
 		
-		if (accumulatedPaceTime > minPaceIntervalUs * 1e-6) {
+		uint64_t txTime_ns = 0;
+		if (useTxTime) {
+			/*
+			* Packets are stamped with their departure times and paced out by
+			*  the qdisc until the next departure is more than one microburst
+			*  interval ahead. The thread then sleeps until that departure time,
+			*  the lead has then drained and the next microburst interval of
+			*  packets is stamped in one pass
+			*/
+			txTime_ns = getTxTimeInNs();
+			if (nextTxTime_ns > txTime_ns + minPaceIntervalUs * 1000ull) {
+				uint64_t wakeT_ns = nextTxTime_ns;
+				struct timespec wakeT;
+				wakeT.tv_sec = wakeT_ns / 1000000000ull;
+				wakeT.tv_nsec = wakeT_ns % 1000000000ull;
+				clock_nanosleep(txTimeClock, TIMER_ABSTIME, &wakeT, NULL);
+				txTime_ns = getTxTimeInNs();
+			}
+			txTime_ns = std::max(txTime_ns, nextTxTime_ns);
+		}
+		else if (accumulatedPaceTime > minPaceIntervalUs * 1e-6) {
 			diff = 100;
 			if (accumulatedPaceTime > 1.1 * minPaceIntervalUs * 1e-6)
-				usleep(std::max(10, (int)(accumulatedPaceTime * 1e6 - diff)));
+				appClock->sleepUs(std::max(10, (int)(accumulatedPaceTime * 1e6 - diff)));
 			else
-				usleep(std::max(10u, minPaceIntervalUs - diff));
-			gettimeofday(&end, 0);
-			diff = end.tv_usec - start.tv_usec;
+				appClock->sleepUs(std::max(10u, minPaceIntervalUs - diff));
 			accumulatedPaceTime = 0.0f;
 			nTx = 0;
 		}
@@ -257,23 +359,33 @@ void* transmitRtpThread(void* arg) {
 		void* buf;
 		uint32_t ssrc_unused;
 
-		pthread_mutex_lock(&lock_rtp_queue);
+		/*
+		* The RTP queue is lock free, the pop can still fail if the queue
+		*  was discarded by ScreamV2Tx after isOkToTransmit
+		*/
 		float rtpQueueDelay = 0.0f;
 		rtpQueueDelay = rtpQueue->getDelay((time_ntp) / 65536.0f);
-		rtpQueue->pop(&buf, size, ssrc_unused, seqNr, isMark, ts);
-		sendPacket(buf, size);
+		if (!rtpQueue->pop(&buf, size, ssrc_unused, seqNr, isMark, ts))
+			continue;
+		if (useTxTime)
+			sendPacketAt(buf, size, txTime_ns);
+		else
+			sendPacket(buf, size);
 		nTx++;
-		pthread_mutex_unlock(&lock_rtp_queue);
 
-		packet_free(buf, SSRC);
+		rtpQueue->freePacket(buf, SSRC);
 		buf = NULL;
 
 		pthread_mutex_lock(&lock_scream);
-		time_ntp = getTimeInNtp();
-		retVal = screamTx->addTransmitted(time_ntp, SSRC, size, seqNr, isMark, rtpQueueDelay, ts);
+		retVal = screamTx->addTransmittedQ32(getTimeInNtpQ32(), SSRC, size, seqNr, isMark, rtpQueueDelay, ts);
 		pthread_mutex_unlock(&lock_scream);
 
-		if (!disablePacing && retVal > 0.0) {
+		if (useTxTime) {
+			nextTxTime_ns = txTime_ns;
+			if (!disablePacing && retVal > 0.0)
+				nextTxTime_ns += uint64_t(retVal * 1e9);
+		}
+		else if (!disablePacing && retVal > 0.0) {
 			accumulatedPaceTime += retVal;
 		}
 	}
@@ -325,101 +437,129 @@ static void waitPeriod(struct periodicInfo* info)
 		info->wakeupsMissed += (missed - 1);
 }
 
-void* createRtpThread(void* arg) {
+/*
+* Generate the RTP packets for one video frame
+*/
+void createFrame() {
 	uint32_t keyFrameInterval_ntp = (uint32_t)(keyFrameInterval * 65536.0f);
 	float rateScale = 1.0f;
 	if (isKeyFrame) {
 		rateScale = 1.0f + 0.0 * keyFrameSize / (FPS * keyFrameInterval) / 2.0;
 		rateScale = (1.0f / rateScale);
 	}
-	uint32_t dT_us = (uint32_t)(1e6 / FPS);
 	unsigned char PT = 98;
-	struct periodicInfo info;
+	uint32_t time_ntp = getTimeInNtp();
 
-	makePeriodic(dT_us, &info);
+	uint32_t ts = (uint32_t)(time_ntp / 65536.0 * 90000);
+	float rateTx = screamTx->getTargetBitrate(time_ntp, SSRC) * rateScale;
 
-	/*
-	* Infinite loop that generates RTP packets
-	*/
-	for (;;) {
-		if (stopThread) {
-			return NULL;
-		}
-		uint32_t time_ntp = getTimeInNtp();
+	mtu = screamTx->getRecommendedMss(time_ntp);
 
-		uint32_t ts = (uint32_t)(time_ntp / 65536.0 * 90000);
-		float rateTx = screamTx->getTargetBitrate(time_ntp, SSRC) * rateScale;
-
-		mtu = screamTx->getRecommendedMss(time_ntp);
+	screamTx->setCwndMinLow((mtu+12)*2);
 
-		screamTx->setCwndMinLow((mtu+12)*2);
+	float randVal = float(rand()) / RAND_MAX - 0.5;
+	int bytes = (int)(rateTx / FPS / 8 * (1.0 + randVal * randRate));
+
+	bool isDiscardable = true;
+	if (isKeyFrame && time_ntp - lastKeyFrameT_ntp >= keyFrameInterval_ntp) {
+		/*
+		* Fake a key frame
+		*/
+		bytes = (int)(bytes * keyFrameSize);
+		lastKeyFrameT_ntp = time_ntp;
+		isDiscardable = false;
+	}
 
-		float randVal = float(rand()) / RAND_MAX - 0.5;
-		int bytes = (int)(rateTx / FPS / 8 * (1.0 + randVal * randRate));
+	if (frameDiscard) {
+		/*
+		* A real video coder would stop referencing the discarded frames,
+		*  the fake coder has no references and only collects the list
+		*/
+		uint32_t discardedFrames[kMaxDiscardedFrames];
+		lock(&lock_scream);
+		screamTx->getDiscardedFrames(SSRC, discardedFrames, kMaxDiscardedFrames);
+		unlock(&lock_scream);
+	}
 
-		if (isKeyFrame && time_ntp - lastKeyFrameT_ntp >= keyFrameInterval_ntp) {
-			/*
-			* Fake a key frame
-			*/
-			bytes = (int)(bytes * keyFrameSize);
-			lastKeyFrameT_ntp = time_ntp;
+	if (burstTime > 0) {
+		float time_s = time_ntp / 65536.0f;
+		if (burstStartTime < 0) {
+			burstStartTime = time_s;
+			isBurst = true;
 		}
-
-		if (burstTime > 0) {
-			float time_s = time_ntp / 65536.0f;
-			if (burstStartTime < 0) {
-				burstStartTime = time_s;
-				isBurst = true;
-			}
-			if (time_s > burstStartTime + burstTime && isBurst) {
-				isBurst = false;
-				burstSleepTime = time_s;
-			}
-			if (time_s > burstSleepTime + burstSleep && !isBurst) {
-				isBurst = true;
-				burstStartTime = time_s;
-			}
-			if (!isBurst)
-				bytes = 0;
+		if (time_s > burstStartTime + burstTime && isBurst) {
+			isBurst = false;
+			burstSleepTime = time_s;
 		}
+		if (time_s > burstSleepTime + burstSleep && !isBurst) {
+			isBurst = true;
+			burstStartTime = time_s;
+		}
+		if (!isBurst)
+			bytes = 0;
+	}
 
-		while (bytes > 0) {
-			int pl_size = min(bytes, mtu);
-			int recvlen = pl_size + 12;
-
-			bytes = std::max(0, bytes - pl_size);
-			unsigned char pt = PT;
-			bool isMark;
-			if (bytes == 0) {
-				// Last RTP packet, set marker bit
-				pt |= 0x80;
-				isMark = true;
-			}
-			else {
-				isMark = false;
-			}
-			uint8_t* buf_rtp = (uint8_t*)malloc(BUFSIZE);
+	while (bytes > 0) {
+		int pl_size = min(bytes, mtu);
+		int recvlen = pl_size + 12;
+
+		bytes = std::max(0, bytes - pl_size);
+		unsigned char pt = PT;
+		bool isMark;
+		if (bytes == 0) {
+			// Last RTP packet, set marker bit
+			pt |= 0x80;
+			isMark = true;
+		}
+		else {
+			isMark = false;
+		}
+		/*
+		* The packet pool is empty only if the RTP queue is full, the packet is
+		*  then dropped in the same way as when push() fails
+		*/
+		uint8_t* buf_rtp = (uint8_t*)rtpQueue->allocPacket();
+		if (buf_rtp != NULL)
 			writeRtp(buf_rtp, seqNr, ts, pt);
 
-			if (pushTraffic) {
+		if (pushTraffic) {
+			if (buf_rtp != NULL) {
 				sendPacket(buf_rtp, recvlen);
-				packet_free(buf_rtp, SSRC);
+				rtpQueue->freePacket(buf_rtp, SSRC);
 				buf_rtp = NULL;
 			}
-			else {
-				pthread_mutex_lock(&lock_rtp_queue);
-				rtpQueue->push(buf_rtp, recvlen, SSRC, seqNr, isMark, (time_ntp) / 65536.0f, ts);
-				pthread_mutex_unlock(&lock_rtp_queue);
-
-				pthread_mutex_lock(&lock_scream);
-				time_ntp = getTimeInNtp();
-				screamTx->newMediaFrame(time_ntp, SSRC, recvlen, isMark);
-				pthread_mutex_unlock(&lock_scream);
-			}
-			seqNr++;
 		}
-		waitPeriod(&info);
+		else {
+			if (buf_rtp != NULL && !rtpQueue->push(buf_rtp, recvlen, SSRC, seqNr, isMark, (time_ntp) / 65536.0f, ts, isDiscardable))
+				rtpQueue->freePacket(buf_rtp, SSRC);
 
+			lock(&lock_scream);
+			time_ntp = getTimeInNtp();
+			screamTx->newMediaFrame(time_ntp, SSRC, recvlen, isMark);
+			unlock(&lock_scream);
+		}
+		seqNr++;
+	}
+}
+
+void* createRtpThread(void* arg) {
+	uint64_t dT_ns = (uint64_t)(1e9 / FPS);
+	uint64_t nextT_ns = appClock->getTimeInNs() + dT_ns;
+
+	/*
+	* Infinite loop that generates RTP packets
+	*/
+	for (;;) {
+		if (stopThread) {
+			return NULL;
+		}
+		createFrame();
+		appClock->sleepUntil(nextT_ns);
+		/*
+		* Missed frame periods are skipped like with a periodic timer
+		*/
+		uint64_t time_ns = appClock->getTimeInNs();
+		nextT_ns += dT_ns * ((time_ns - nextT_ns) / dT_ns + 1);
 	}
 
 	return NULL;
@@ -427,43 +567,130 @@ void* createRtpThread(void* arg) {
 
 uint32_t rtcp_rx_time_ntp = 0;
 #define KEEP_ALIVE_PKT_SIZE 1
+/*
+* Receive one RTCP packet, flags = MSG_DONTWAIT makes the read non blocking
+* Return the packet length or -1 if no packet was received
+*/
+int receiveRtcp(int flags) {
+	if (ipv6)
+		return recvfrom(fd_outgoing_rtp, buf_rtcp, BUFSIZE, flags, (struct sockaddr*)&incoming_rtcp_addr6, &addrlen_incoming_rtcp6);
+	else
+		return recvfrom(fd_outgoing_rtp, buf_rtcp, BUFSIZE, flags, (struct sockaddr*)&incoming_rtcp_addr, &addrlen_incoming_rtcp);
+}
+
+/*
+* Process a received RTCP packet
+*/
+void processRtcp(int recvlen) {
+	if (recvlen > KEEP_ALIVE_PKT_SIZE) {
+		lock(&lock_scream);
+		uint32_t time_ntp = getTimeInNtp(); // We need time in microseconds, roughly ms granularity is OK
+		char s[100];
+		if (ntp) {
+			struct timeval tp;
+			gettimeofday(&tp, NULL);
+			double time = tp.tv_sec + tp.tv_usec * 1e-6;
+			sprintf(s, "%1.6f", time);
+		}
+		else {
+			sprintf(s, "%1.4f", time_ntp / 65536.0f);
+		}
+		screamTx->setTimeString(s);
+
+		screamTx->incomingStandardizedFeedback(time_ntp, buf_rtcp, recvlen);
+
+		unlock(&lock_scream);
+		rtcp_rx_time_ntp = time_ntp;
+	}
+}
+
 void* readRtcpThread(void* arg) {
 	/*
 	* Wait for RTCP packets from receiver
 	*/
 	for (;;) {
-		int recvlen = 0;
-		if (ipv6) {
-			recvlen = recvfrom(fd_outgoing_rtp, buf_rtcp, BUFSIZE, 0, (struct sockaddr*)&incoming_rtcp_addr6, &addrlen_incoming_rtcp6);
-		}
-		else {
-			recvlen = recvfrom(fd_outgoing_rtp, buf_rtcp, BUFSIZE, 0, (struct sockaddr*)&incoming_rtcp_addr, &addrlen_incoming_rtcp);
-		}
+		int recvlen = receiveRtcp(0);
 		if (stopThread)
 			return NULL;
-		if (recvlen > KEEP_ALIVE_PKT_SIZE) {
-			pthread_mutex_lock(&lock_scream);
-			uint32_t time_ntp = getTimeInNtp(); // We need time in microseconds, roughly ms granularity is OK
-			char s[100];
-			if (ntp) {
-				struct timeval tp;
-				gettimeofday(&tp, NULL);
-				double time = tp.tv_sec + tp.tv_usec * 1e-6;
-				sprintf(s, "%1.6f", time);
-			}
-			else {
-				sprintf(s, "%1.4f", time_ntp / 65536.0f);
+		processRtcp(recvlen);
+		appClock->sleepUs(10);
+	}
+	return NULL;
+}
+
+/*
+* Arm the one shot pacing timer to expire after delay [s]
+*/
+void armPaceTimer(int fd, float delay) {
+	struct itimerspec itval;
+	uint64_t delay_ns = std::max(uint64_t(1000), uint64_t(delay * 1e9));
+	memset(&itval, 0, sizeof(itval));
+	itval.it_value.tv_sec = delay_ns / 1000000000ull;
+	itval.it_value.tv_nsec = delay_ns % 1000000000ull;
+	timerfd_settime(fd, 0, &itval, NULL);
+	isPaceTimerArmed = true;
+}
+
+/*
+* Transmit the RTP packets that are allowed by the congestion window
+*  and the packet pacing, event loop version of transmitRtpThread.
+* The function returns when the pacing timer fd_pace is armed or when the RTP
+*  queue is empty or the congestion window is full. In the two latter cases the
+*  next video frame or RTCP packet triggers new transmissions
+*/
+void transmitRtp(int fd_pace) {
+	if (isPaceTimerArmed)
+		return;
+	for (;;) {
+		uint64_t time_q32 = getTimeInNtpQ32();
+		uint32_t time_ntp = uint32_t(time_q32 >> 16);
+		if (screamTx->isOkToTransmitQ32(time_q32, SSRC) == -1.0f)
+			return;
+
+		uint64_t txTime_ns = 0;
+		if (useTxTime) {
+			/*
+			* Wait until the lead has drained, as in transmitRtpThread
+			*/
+			txTime_ns = getTxTimeInNs();
+			if (nextTxTime_ns > txTime_ns + minPaceIntervalUs * 1000ull) {
+				armPaceTimer(fd_pace, (nextTxTime_ns - txTime_ns) * 1e-9f);
+				return;
 			}
-			screamTx->setTimeString(s);
+			txTime_ns = std::max(txTime_ns, nextTxTime_ns);
+		}
+		else if (accumulatedPaceTime > minPaceInterval) {
+			armPaceTimer(fd_pace, accumulatedPaceTime);
+			accumulatedPaceTime = 0.0f;
+			return;
+		}
+
+		void* buf;
+		int size;
+		uint32_t ssrc_unused;
+		uint16_t seqNr;
+		bool isMark;
+		uint32_t ts;
+		float rtpQueueDelay = rtpQueue->getDelay((time_ntp) / 65536.0f);
+		if (!rtpQueue->pop(&buf, size, ssrc_unused, seqNr, isMark, ts))
+			return;
+		if (useTxTime)
+			sendPacketAt(buf, size, txTime_ns);
+		else
+			sendPacket(buf, size);
+		rtpQueue->freePacket(buf, SSRC);
 
-			screamTx->incomingStandardizedFeedback(time_ntp, buf_rtcp, recvlen);
+		float retVal = screamTx->addTransmittedQ32(getTimeInNtpQ32(), SSRC, size, seqNr, isMark, rtpQueueDelay, ts);
 
-			pthread_mutex_unlock(&lock_scream);
-			rtcp_rx_time_ntp = time_ntp;
+		if (useTxTime) {
+			nextTxTime_ns = txTime_ns;
+			if (!disablePacing && retVal > 0.0)
+				nextTxTime_ns += uint64_t(retVal * 1e9);
+		}
+		else if (!disablePacing && retVal > 0.0) {
+			accumulatedPaceTime += retVal;
 		}
-		usleep(10);
 	}
-	return NULL;
 }
 
 int setup() {
@@ -568,6 +795,24 @@ int setup() {
 	}
 	int tmp = 0;
 #endif
+
+	/*
+	* Enable departure time stamping, requires the fq or etf qdisc on the outgoing interface
+	*/
+	if (useTxTime) {
+#ifdef SO_TXTIME
+		struct sock_txtime sockTxTime;
+		memset(&sockTxTime, 0, sizeof(sockTxTime));
+		sockTxTime.clockid = txTimeClock;
+		if (setsockopt(fd_outgoing_rtp, SOL_SOCKET, SO_TXTIME, &sockTxTime, sizeof(sockTxTime)) < 0) {
+			perror("setsockopt(SO_TXTIME) failed, using usleep pacing");
+			useTxTime = false;
+		}
+#else
+		cerr << "SO_TXTIME not supported, using usleep pacing" << endl;
+		useTxTime = false;
+#endif
+	}
 	char buf[10];
 	if (fixedRate > 0) {
 		screamTx = new ScreamV2Tx(
@@ -599,9 +844,14 @@ int setup() {
 			false,
 			enableClockDriftCompensation);
 	}
-	rtpQueue = new RtpQueue();
+	/*
+	* The packet pool holds the packets in the RTP queue plus the packets
+	*  that are being packetized and transmitted
+	*/
+	rtpQueue = new RtpQueue(kRtpQueueSize + 2, BUFSIZE);
 	screamTx->setCwndMinLow((mtu+12)*2);
 	screamTx->enableRelaxedPacing(relaxedPacing);
+	screamTx->enableFrameDiscard(frameDiscard);
 	screamTx->setMssListMinPacketsInFlight(mtuList, nMtuListItems, minPktsInFlight);
 	screamTx->setReorderTime(reorderTime);
 
@@ -638,6 +888,125 @@ uint32_t lastT_ntp;
 
 volatile sig_atomic_t done = 0;
 
+/*
+* Print statistics and the verbose log
+*/
+void printLog(bool verbose) {
+	uint32_t time_ntp = getTimeInNtp();
+	if (statsShm) {
+		/*
+		* Only the snapshot is taken under the lock, the publish is done after
+		*/
+		StatsSnapshot snapshot;
+		lock(&lock_scream);
+		screamTx->getStatsSnapshot(time_ntp / 65536.0f, snapshot);
+		unlock(&lock_scream);
+		statsShm->publish(snapshot);
+	}
+	bool isFeedback = time_ntp - rtcp_rx_time_ntp < 65536; // 1s in Q16
+	if ((printSummary || !isFeedback) && time_ntp - lastLogT_ntp > 2 * 65536) { // 2s in Q16
+		if (!isFeedback) {
+			cerr << "No RTCP feedback received" << endl;
+		}
+		else {
+			float time_s = time_ntp / 65536.0f;
+			char s[500];
+			screamTx->getStatistics(time_s, s);
+
+			cout << s << ", MTU = " << mtu <<endl;
+		}
+		lastLogT_ntp = time_ntp;
+	}
+	if (verbose && time_ntp - lastLogTv_ntp > 13107) { // 0.2s in Q16
+		if (isFeedback) {
+			float time_s = time_ntp / 65536.0f;
+			char s[3000];
+			char s1[500];
+			screamTx->getVeryShortLog(time_s, s1);
+
+			sprintf(s, "%8.3f, %s ", time_s, s1);
+
+			cout << s << endl;
+			/*
+			* Send statistics to receiver this can be used to
+			* verify reliability of remote control
+			*/
+			s1[0] = 0x80;
+			s1[1] = 0x7F; // Set PT = 0x7F for statistics packet
+			memcpy(&s1[2], s, strlen(s));
+			sendPacket(s1, strlen(s) + 2);
+		}
+		lastLogTv_ntp = time_ntp;
+	}
+}
+
+/*
+* Single threaded sender, the frame timer, the pacing timer, the statistics timer
+*  and the RTCP socket are multiplexed with epoll.
+* The timers are kernel timerfds, the event loop therefore runs in real time only
+*/
+void runEventLoop(bool verbose) {
+	struct periodicInfo frameInfo;
+	struct periodicInfo logInfo;
+	makePeriodic((uint32_t)(1e6 / FPS), &frameInfo);
+	makePeriodic(50000, &logInfo);
+	int fd_pace = timerfd_create(CLOCK_MONOTONIC, 0);
+	int fd_epoll = epoll_create1(0);
+	if (frameInfo.timer_fd == -1 || logInfo.timer_fd == -1 || fd_pace == -1 || fd_epoll == -1) {
+		perror("event loop setup failed");
+		return;
+	}
+	int fds[] = { frameInfo.timer_fd, logInfo.timer_fd, fd_pace, fd_outgoing_rtp };
+	for (int n = 0; n < 4; n++) {
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[n];
+		epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fds[n], &ev);
+	}
+
+	while (!stopThread && (runTime < 0 || getTimeInNtp() < runTime * 65536.0f)) {
+		struct epoll_event events[4];
+		int nEvents = epoll_wait(fd_epoll, events, 4, -1);
+		if (nEvents < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait failed");
+			break;
+		}
+		for (int n = 0; n < nEvents; n++) {
+			int fd = events[n].data.fd;
+			if (fd == frameInfo.timer_fd) {
+				waitPeriod(&frameInfo);
+				createFrame();
+			}
+			else if (fd == fd_pace) {
+				uint64_t expirations;
+				if (read(fd_pace, &expirations, sizeof(expirations)) < 0)
+					perror("read timer");
+				isPaceTimerArmed = false;
+			}
+			else if (fd == fd_outgoing_rtp) {
+				int recvlen;
+				while ((recvlen = receiveRtcp(MSG_DONTWAIT)) >= 0)
+					processRtcp(recvlen);
+			}
+			else if (fd == logInfo.timer_fd) {
+				waitPeriod(&logInfo);
+				if (!pushTraffic)
+					printLog(verbose);
+			}
+		}
+		if (!pushTraffic)
+			transmitRtp(fd_pace);
+	}
+	stopThread = true;
+	close(fd_epoll);
+	close(fd_pace);
+	close(frameInfo.timer_fd);
+	close(logInfo.timer_fd);
+}
+
 void stopAll(int signum)
 {
 	stopThread = true;
@@ -646,9 +1015,7 @@ void stopAll(int signum)
 int main(int argc, char* argv[]) {
 
     mtuList[0] = mtu;
-	struct timeval tp;
-	gettimeofday(&tp, NULL);
-	t0 = tp.tv_sec + tp.tv_usec * 1e-6 - 1e-3;
+	appClock = new RealClock();
 	lastT_ntp = getTimeInNtp();
 
 	/*
@@ -684,6 +1051,7 @@ int main(int argc, char* argv[]) {
 		cerr << "     -maxwindowheadroom val   How much bytes in flight can exceed cwnd  (default = 5.0) " << endl;
 		cerr << "     -adaptivepaceheadroom val Set adaptive packet pacing headroom (default = 1.5) " << endl;
 		cerr << "     -relaxedpacing           Allow increased pacing rate when max rate reached (default = false) " << endl;
+		cerr << "     -framediscard            Discard stale frames from the RTP queue instead of clearing it, key frames are kept" << endl;
 		cerr << "     -inflightheadroom val    Set a bytes in flight headroom (default = 2.0) " << endl;
 		cerr << "     -mulincrease val         Multiplicative increase factor for (default 0.05)" << endl;
 		cerr << "     -fps value               Set the frame rate (default 50)" << endl;
@@ -693,6 +1061,12 @@ int main(int argc, char* argv[]) {
 		cerr << "     -nosummary               Don't print summary" << endl;
 		cerr << "     -log logfile             Save detailed per-ACK log to file" << endl;
 		cerr << "     -txrxlog logfile         Save tx and rx timestamp for RTP packets" << endl;
+		cerr << "     -binlog logfile          Save the per-ACK log and the tx and rx timestamps in a binary" << endl;
+		cerr << "                               file, the file is written by a background thread and is" << endl;
+		cerr << "                               gzip compressed if the name ends with .gz" << endl;
+		cerr << "                               use scream_log_convert to get the -log and -txrxlog format" << endl;
+		cerr << "     -statshm name            Publish a statistics snapshot every 50ms in the POSIX shared" << endl;
+		cerr << "                               memory segment name (e.g /scream_stats), see scream_stats_dump" << endl;
 		cerr << "     -ntp                     Use NTP timestamp in logfile" << endl;
 		cerr << "     -append                  Append logfile" << endl;
 		cerr << "     -mtu values              List of mtu values separated by , without space"  << endl;
@@ -701,6 +1075,10 @@ int main(int argc, char* argv[]) {
 		cerr << "     -itemlist                Add item list in beginning of log file" << endl;
 		cerr << "     -detailed                Detailed log, per ACKed RTP" << endl;
 		cerr << "     -microburstinterval val  Microburst interval [ms] for packet pacing (default 0.5ms)" << endl;
+		cerr << "     -eventloop               Run the sender in a single thread with an epoll event loop" << endl;
+		cerr << "     -txtime qdisc            Stamp packets with departure times (SO_TXTIME), qdisc = fq or etf" << endl;
+		cerr << "                               the qdisc must be set up, e.g. tc qdisc replace dev eth0 root fq" << endl;
+		cerr << "                               the transmit thread then wakes once per microburst interval" << endl;
 		cerr << "     -hysteresis  val         Inhibit updated target rate to encoder if the rate change is small" << endl;
 		cerr << "                               a value of 0.1 means a hysteresis of +10%/-2.5%" << endl;
 		cerr << "     -reordertime val         Set packet reordering margin [s] (default 0.03)" << endl;
@@ -711,6 +1089,8 @@ int main(int argc, char* argv[]) {
 	bool verbose = false;
 	char* logFile = 0;
 	char* txRxLogFile = 0;
+	char* binLogFile = 0;
+	char* statShmName = 0;
 	/* First find options */
 	while (strstr(argv[ix], "-")) {
 		if (strstr(argv[ix], "-ect")) {
@@ -821,6 +1201,11 @@ int main(int argc, char* argv[]) {
 			ix++;
 			continue;
 		}
+		if (strstr(argv[ix], "-framediscard")) {
+			frameDiscard = true;
+			ix++;
+			continue;
+		}
 
 		if (strstr(argv[ix], "-reordertime")) {
 			reorderTime = atof(argv[ix + 1]);;
@@ -873,6 +1258,16 @@ int main(int argc, char* argv[]) {
 			ix += 2;
 			continue;
 		}
+		if (strstr(argv[ix], "-binlog")) {
+			binLogFile = argv[ix + 1];
+			ix += 2;
+			continue;
+		}
+		if (strstr(argv[ix], "-statshm")) {
+			statShmName = argv[ix + 1];
+			ix += 2;
+			continue;
+		}
 		if (strstr(argv[ix], "-ntp")) {
 			ntp = true;
 			ix++;
@@ -919,6 +1314,24 @@ int main(int argc, char* argv[]) {
 			}
 			continue;
 		}
+		if (strstr(argv[ix], "-eventloop")) {
+			useEventLoop = true;
+			ix++;
+			continue;
+		}
+		if (strstr(argv[ix], "-txtime")) {
+			useTxTime = true;
+			if (strstr(argv[ix + 1], "etf"))
+				txTimeClock = CLOCK_TAI;
+			else if (strstr(argv[ix + 1], "fq"))
+				txTimeClock = CLOCK_MONOTONIC;
+			else {
+				cerr << "txtime qdisc must be fq or etf" << endl;
+				exit(0);
+			}
+			ix += 2;
+			continue;
+		}
 		if (strstr(argv[ix], "-hysteresis")) {
 			hysteresis = atof(argv[ix + 1]);
 			ix += 2;
@@ -955,6 +1368,20 @@ int main(int argc, char* argv[]) {
 		else
 			fp_txrxlog = fopen(txRxLogFile, "w");
 	}
+	if (binLogFile) {
+		eventLog = new EventLog(binLogFile, append);
+		if (!eventLog->isOpen()) {
+			delete eventLog;
+			eventLog = 0;
+		}
+	}
+	if (statShmName) {
+		statsShm = new StatsShm(statShmName, true);
+		if (!statsShm->isOpen()) {
+			delete statsShm;
+			statsShm = 0;
+		}
+	}
 	if (minRate > initRate)
 		initRate = minRate;
 	DECODER_IP = argv[ix];ix++;
@@ -976,18 +1403,25 @@ int main(int argc, char* argv[]) {
 	screamTx->setDetailedLogFp(fp_log);
 	screamTx->useExtraDetailedLog(detailed);
 	screamTx->setTxRxLogFp(fp_txrxlog);
+	screamTx->setEventLog(eventLog);
 
 	pthread_mutex_init(&lock_scream, NULL);
-	pthread_mutex_init(&lock_rtp_queue, NULL);
 	pthread_mutex_init(&lock_pace, NULL);
 
-	/* Create RTP thread */
-	pthread_create(&create_rtp_thread, NULL, createRtpThread, (void*)"Create RTP thread...");
-	if (pushTraffic) {
+	if (useEventLoop) {
+		if (pushTraffic)
+			cerr << "Scream sender started in push traffic mode " << fixedRate << "kbps, event loop" << endl;
+		else
+			cerr << "Scream sender started, event loop! " << endl;
+		runEventLoop(verbose);
+	}
+	else if (pushTraffic) {
+		/* Create RTP thread */
+		pthread_create(&create_rtp_thread, NULL, createRtpThread, (void*)"Create RTP thread...");
 		cerr << "Scream sender started in push traffic mode " << fixedRate << "kbps" << endl;
 
 		while (!stopThread && (runTime < 0 || getTimeInNtp() < runTime * 65536.0f)) {
-			usleep(50000);
+			appClock->sleepUs(50000);
 		}
 		stopThread = true;
 
@@ -995,57 +1429,33 @@ int main(int argc, char* argv[]) {
 	else {
 		cerr << "Scream sender started! " << endl;
 
+		/* Create RTP thread */
+		pthread_create(&create_rtp_thread, NULL, createRtpThread, (void*)"Create RTP thread...");
 		/* Create RTCP thread */
 		pthread_create(&rtcp_thread, NULL, readRtcpThread, (void*)"RTCP thread...");
 		/* Transmit RTP thread */
 		pthread_create(&transmit_rtp_thread, NULL, transmitRtpThread, (void*)"Transmit RTP thread...");
 
 		while (!stopThread && (runTime < 0 || getTimeInNtp() < runTime * 65536.0f)) {
-			uint32_t time_ntp = getTimeInNtp();
-			bool isFeedback = time_ntp - rtcp_rx_time_ntp < 65536; // 1s in Q16
-			if ((printSummary || !isFeedback) && time_ntp - lastLogT_ntp > 2 * 65536) { // 2s in Q16
-				if (!isFeedback) {
-					cerr << "No RTCP feedback received" << endl;
-				}
-				else {
-					float time_s = time_ntp / 65536.0f;
-					char s[500];
-					screamTx->getStatistics(time_s, s);
-
-					cout << s << ", MTU = " << mtu <<endl;
-				}
-				lastLogT_ntp = time_ntp;
-			}
-			if (verbose && time_ntp - lastLogTv_ntp > 13107) { // 0.2s in Q16
-				if (isFeedback) {
-					float time_s = time_ntp / 65536.0f;
-					char s[3000];
-					char s1[500];
-					screamTx->getVeryShortLog(time_s, s1);
-
-					sprintf(s, "%8.3f, %s ", time_s, s1);
-
-					cout << s << endl;
-					/*
-					* Send statistics to receiver this can be used to
-					* verify reliability of remote control
-					*/
-					s1[0] = 0x80;
-					s1[1] = 0x7F; // Set PT = 0x7F for statistics packet
-					memcpy(&s1[2], s, strlen(s));
-					sendPacket(s1, strlen(s) + 2);
-				}
-				lastLogTv_ntp = time_ntp;
-			}
-			usleep(50000);
+			printLog(verbose);
+			appClock->sleepUs(50000);
 		};
 		stopThread = true;
 	}
-	usleep(500000);
+	appClock->sleepUs(500000);
 	close(fd_outgoing_rtp);
 	if (fp_log)
 		fclose(fp_log);
 	if (fp_txrxlog)
 		fclose(fp_txrxlog);
+	if (eventLog) {
+		lock(&lock_scream);
+		screamTx->setEventLog(0);
+		unlock(&lock_scream);
+		if (eventLog->getDroppedCount() > 0)
+			cerr << eventLog->getDroppedCount() << " event log records dropped" << endl;
+		delete eventLog;
+	}
+	delete statsShm;
 	screamTx->printFinalSummary();
 }
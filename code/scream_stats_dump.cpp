@@ -0,0 +1,89 @@
+// Prints the statistics snapshots that scream_bw_test_tx -statshm publishes
+//  in shared memory, one CSV line per new snapshot
+//
+#include "StatsShm.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc <= 1) {
+		cerr << "SCReAM statistics snapshot reader. Ericsson AB." << endl;
+		cerr << "Usage : " << endl << " > scream_stats_dump <options> name " << endl;
+		cerr << "  name is the shared memory segment given to scream_bw_test_tx -statshm" << endl;
+		cerr << "     -interval val            Poll interval [ms] (default 100)" << endl;
+		cerr << "     -count val               Exit after val snapshots (default run until the sender exits)" << endl;
+		cerr << "     -itemlist                Add item list in beginning of the output" << endl;
+		exit(-1);
+	}
+	int ix = 1;
+	int interval = 100;
+	int count = -1;
+	bool itemlist = false;
+	while (ix < argc - 1 && strstr(argv[ix], "-")) {
+		if (strstr(argv[ix], "-interval")) {
+			interval = atoi(argv[ix + 1]);
+			ix += 2;
+			continue;
+		}
+		if (strstr(argv[ix], "-count")) {
+			count = atoi(argv[ix + 1]);
+			ix += 2;
+			continue;
+		}
+		if (strstr(argv[ix], "-itemlist")) {
+			itemlist = true;
+			ix++;
+			continue;
+		}
+		cerr << "unexpected option " << argv[ix] << endl;
+		exit(-1);
+	}
+
+	StatsShm statsShm(argv[ix], false);
+	if (!statsShm.isOpen())
+		exit(-1);
+	if (itemlist) {
+		printf("time,cwnd,bytesInFlight,sRtt,queueDelay,queueDelayTarget,l4sAlpha,rateTransmitted,isL4s,nStreams,"
+			"{ssrc,targetBitrate,rateRtp,rateTransmitted,rateAcked,rateLost,rateCe,rtpQueueDelay,rtpQueueBytes,rtpQueueSize,packetsRtp,packetsLost,packetsCe}\n");
+	}
+
+	StatsSnapshot snapshot;
+	uint32_t lastCount = 0;
+	int nStale = 0;
+	while (count != 0) {
+		uint32_t publishCount = statsShm.getPublishCount();
+		if (publishCount != lastCount && statsShm.read(snapshot)) {
+			lastCount = publishCount;
+			nStale = 0;
+			printf("%1.3f,%d,%d,%1.4f,%1.4f,%1.4f,%1.4f,%1.0f,%d,%d",
+				snapshot.time, snapshot.cwnd, snapshot.bytesInFlight, snapshot.sRtt,
+				snapshot.queueDelay, snapshot.queueDelayTarget, snapshot.l4sAlpha,
+				snapshot.rateTransmitted, snapshot.isL4s, snapshot.nStreams);
+			for (int n = 0; n < snapshot.nStreams; n++) {
+				StatsSnapshotStream& s = snapshot.streams[n];
+				printf(",%u,%1.0f,%1.0f,%1.0f,%1.0f,%1.0f,%1.0f,%1.4f,%d,%d,%lu,%lu,%lu",
+					s.ssrc, s.targetBitrate, s.rateRtp, s.rateTransmitted,
+					s.rateAcked, s.rateLost, s.rateCe, s.rtpQueueDelay,
+					s.rtpQueueBytes, s.rtpQueueSize,
+					(unsigned long)s.packetsRtp, (unsigned long)s.packetsLost, (unsigned long)s.packetsCe);
+			}
+			printf("\n");
+			fflush(stdout);
+			if (count > 0)
+				count--;
+		}
+		else if (lastCount != 0 && ++nStale * interval > 5000) {
+			/*
+			* No new snapshot for 5s, the sender has most likely exited
+			*/
+			break;
+		}
+		usleep(interval * 1000);
+	}
+	return 0;
+}
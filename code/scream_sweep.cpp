@@ -0,0 +1,340 @@
+// Parameter sweep for the SCReAM simulator
+//
+
+#include "stdafx.h"
+#include "Simulation.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+/*
+* Parse a list of values, either comma separated "0.03,0.06,0.1"
+*  or a range "start:step:stop"
+*/
+static bool parseList(const char* s, vector<float>& values) {
+	values.clear();
+	float start, step, stop;
+	if (sscanf(s, "%f:%f:%f", &start, &step, &stop) == 3) {
+		if (step <= 0.0f || stop < start)
+			return false;
+		int nSteps = int((stop - start) / step + 0.5f);
+		for (int n = 0; n <= nSteps; n++)
+			values.push_back(start + n * step);
+		return true;
+	}
+	char tmp[1000];
+	strncpy(tmp, s, sizeof(tmp) - 1);
+	tmp[sizeof(tmp) - 1] = 0;
+	char* save = 0;
+	for (char* tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(0, ",", &save))
+		values.push_back(atof(tok));
+	return !values.empty();
+}
+
+static void parseNames(const char* s, vector<string>& names) {
+	names.clear();
+	string str(s);
+	size_t pos = 0;
+	while (pos <= str.size()) {
+		size_t end = str.find(',', pos);
+		if (end == string::npos)
+			end = str.size();
+		if (end > pos)
+			names.push_back(str.substr(pos, end - pos));
+		pos = end + 1;
+	}
+}
+
+/*
+* Seed for a given replica, all parameter combinations with the same
+*  replica index use the same seed, i.e. they see the same random sequence
+*/
+static uint32_t replicaSeed(uint32_t baseSeed, int replica) {
+	uint32_t x = baseSeed + 0x9e3779b9u * uint32_t(replica + 1);
+	x ^= x >> 16; x *= 0x85ebca6bu;
+	x ^= x >> 13; x *= 0xc2b2ae35u;
+	x ^= x >> 16;
+	return x;
+}
+
+int main(int argc, char* argv[]) {
+	vector<float> targets(1, 0.06f);
+	vector<float> paceHeadrooms(1, 1.5f);
+	vector<float> mulIncreases(1, 0.05f);
+	vector<float> rates(1, 10e6f);
+	vector<float> rtts(1, 0.025f);
+	vector<string> aqms(1, string("default"));
+	vector<string> linkTraces(1, string("fixed"));
+	vector<float> screamFlows(1, 1.0f);
+	vector<string> tcpFlows(1, string("none"));
+	const char* flowCsv = 0;
+	int nReplicas = 1;
+	uint32_t baseSeed = 1;
+	int nThreads = thread::hardware_concurrency();
+	SimulationParams base;
+
+	if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "-help") == 0)) {
+		cerr << "SCReAM V2 simulator parameter sweep. Ericsson AB." << endl;
+		cerr << "Usage : " << endl << " > scream_sweep <options>" << endl;
+		cerr << " Lists are comma separated values or start:step:stop, all combinations are run" << endl;
+		cerr << "     -target list             Queue delay target [s] (default 0.06)" << endl;
+		cerr << "     -paceheadroom list       Packet pacing headroom (default 1.5)" << endl;
+		cerr << "     -mulincrease list        Multiplicative increase scale factor (default 0.05)" << endl;
+		cerr << "     -rate list               Bottleneck rate [bps] (default 10e6)" << endl;
+		cerr << "     -rtt list                Round trip propagation delay [s] (default 0.025)" << endl;
+		cerr << "     -aqm names               Bottleneck AQM, default,step,ramp,pie,codel,fq_codel,dualpi2" << endl;
+		cerr << "     -linktrace files         Bottleneck capacity traces (Mahimahi format)," << endl;
+		cerr << "                               fixed = fixed rate given by -rate (default)" << endl;
+		cerr << "     -screamflows list        Number of SCReAM flows (default 1)" << endl;
+		cerr << "     -tcpflows names          Competing TCP flows, '+' separated reno, cubic and prague," << endl;
+		cerr << "                               e.g cubic+prague, none = no TCP flows (default)" << endl;
+		cerr << "     -startinterval val       Flow k starts at k*val [s] (default 0)" << endl;
+		cerr << "     -buffer val              Bottleneck buffer size [byte] (default 0 = unlimited)" << endl;
+		cerr << "     -flowcsv file            Write per flow KPIs as CSV to file" << endl;
+		cerr << "     -replicas n              Runs per parameter combination with different seeds (default 1)" << endl;
+		cerr << "     -seed val                Base seed (default 1)" << endl;
+		cerr << "     -time val                Simulation time [s] (default 20)" << endl;
+		cerr << "     -trace file              Video frame size trace (default ./traces/trace_no_key.txt)" << endl;
+		cerr << "     -mode val                Streams to run, bit mask (default 1)" << endl;
+		cerr << "     -nochrate                Don't reduce the bottleneck rate between 3s and 6s" << endl;
+		cerr << "     -classic                 Classic ECN instead of L4S" << endl;
+		cerr << "     -noecn                   Not ECN capable" << endl;
+		cerr << "     -fq                      Fair queueing scheduler between the streams" << endl;
+		cerr << "     -framediscard            Discard stale frames instead of clearing the RTP queue" << endl;
+		cerr << "     -threads n               Number of worker threads (default number of cores)" << endl;
+		cerr << " One CSV row with KPIs is printed on stdout per run" << endl;
+		exit(-1);
+	}
+
+	int ix = 1;
+	while (ix < argc) {
+		bool isOk = true;
+		if (strcmp(argv[ix], "-target") == 0 && ix + 1 < argc) {
+			isOk = parseList(argv[ix + 1], targets);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-paceheadroom") == 0 && ix + 1 < argc) {
+			isOk = parseList(argv[ix + 1], paceHeadrooms);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-mulincrease") == 0 && ix + 1 < argc) {
+			isOk = parseList(argv[ix + 1], mulIncreases);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-rate") == 0 && ix + 1 < argc) {
+			isOk = parseList(argv[ix + 1], rates);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-rtt") == 0 && ix + 1 < argc) {
+			isOk = parseList(argv[ix + 1], rtts);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-aqm") == 0 && ix + 1 < argc) {
+			parseNames(argv[ix + 1], aqms);
+			isOk = !aqms.empty();
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-linktrace") == 0 && ix + 1 < argc) {
+			parseNames(argv[ix + 1], linkTraces);
+			isOk = !linkTraces.empty();
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-screamflows") == 0 && ix + 1 < argc) {
+			isOk = parseList(argv[ix + 1], screamFlows);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-tcpflows") == 0 && ix + 1 < argc) {
+			parseNames(argv[ix + 1], tcpFlows);
+			isOk = !tcpFlows.empty();
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-startinterval") == 0 && ix + 1 < argc) {
+			base.flowStartInterval = atof(argv[ix + 1]);
+			isOk = base.flowStartInterval >= 0.0f;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-buffer") == 0 && ix + 1 < argc) {
+			base.bufferSize = atoi(argv[ix + 1]);
+			isOk = base.bufferSize >= 0;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-flowcsv") == 0 && ix + 1 < argc) {
+			flowCsv = argv[ix + 1];
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-replicas") == 0 && ix + 1 < argc) {
+			nReplicas = atoi(argv[ix + 1]);
+			isOk = nReplicas > 0;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-seed") == 0 && ix + 1 < argc) {
+			baseSeed = strtoul(argv[ix + 1], 0, 10);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-time") == 0 && ix + 1 < argc) {
+			base.Tmax = atof(argv[ix + 1]);
+			isOk = base.Tmax > 0.0f;
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-trace") == 0 && ix + 1 < argc) {
+			base.traceFile = argv[ix + 1];
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-mode") == 0 && ix + 1 < argc) {
+			base.mode = atoi(argv[ix + 1]);
+			ix += 2;
+		}
+		else if (strcmp(argv[ix], "-nochrate") == 0) {
+			base.isChRate = false;
+			ix++;
+		}
+		else if (strcmp(argv[ix], "-classic") == 0) {
+			base.isL4s = false;
+			ix++;
+		}
+		else if (strcmp(argv[ix], "-noecn") == 0) {
+			base.ecnCapable = false;
+			ix++;
+		}
+		else if (strcmp(argv[ix], "-fq") == 0) {
+			base.isFairQueueing = true;
+			ix++;
+		}
+		else if (strcmp(argv[ix], "-framediscard") == 0) {
+			base.isFrameDiscard = true;
+			ix++;
+		}
+		else if (strcmp(argv[ix], "-threads") == 0 && ix + 1 < argc) {
+			nThreads = atoi(argv[ix + 1]);
+			ix += 2;
+		}
+		else {
+			isOk = false;
+		}
+		if (!isOk) {
+			cerr << "Invalid option " << argv[ix] << ", scream_sweep -h for help" << endl;
+			exit(-1);
+		}
+	}
+	nThreads = std::max(1, nThreads);
+	FILE* fpFlow = 0;
+	if (flowCsv) {
+		fpFlow = fopen(flowCsv, "w");
+		if (fpFlow == 0) {
+			cerr << "Cannot open " << flowCsv << endl;
+			exit(-1);
+		}
+	}
+
+	/*
+	* Expand the grid, the replica index varies fastest
+	*/
+	vector<SimulationParams> runs;
+	for (size_t c = 0; c < linkTraces.size(); c++)
+	for (size_t f = 0; f < screamFlows.size(); f++)
+	for (size_t g = 0; g < tcpFlows.size(); g++)
+	for (size_t a = 0; a < aqms.size(); a++)
+	for (size_t r = 0; r < rtts.size(); r++)
+	for (size_t l = 0; l < rates.size(); l++)
+	for (size_t t = 0; t < targets.size(); t++)
+	for (size_t p = 0; p < paceHeadrooms.size(); p++)
+	for (size_t m = 0; m < mulIncreases.size(); m++)
+	for (int k = 0; k < nReplicas; k++) {
+		SimulationParams params = base;
+		params.aqm = aqms[a] == "default" ? 0 : aqms[a].c_str();
+		params.linkTrace = linkTraces[c] == "fixed" ? 0 : linkTraces[c].c_str();
+		params.nScreamFlows = int(screamFlows[f] + 0.5f);
+		params.tcpFlows = tcpFlows[g] == "none" ? 0 : tcpFlows[g].c_str();
+		params.RTT = rtts[r];
+		params.linkRate = rates[l];
+		params.linkRateLow = rates[l] / 2;
+		params.queueDelayTarget = targets[t];
+		params.packetPacingHeadroom = paceHeadrooms[p];
+		params.multiplicativeIncreaseScalefactor = mulIncreases[m];
+		params.seed = replicaSeed(baseSeed, k);
+		runs.push_back(params);
+	}
+	cerr << "Running " << runs.size() << " simulations on " << nThreads << " threads" << endl;
+
+	printf("run,seed,linktrace,screamflows,tcpflows,aqm,rtt,rate,target,paceheadroom,mulincrease,"
+		"throughput_kbps,utilization,qdelay_p50_ms,qdelay_p95_ms,qdelay_p99_ms,"
+		"rtpqdelay_p50_ms,rtpqdelay_p95_ms,rtpqdelay_p99_ms,ce_pct,delivered,dropped,events,fairness\n");
+	fflush(stdout);
+	if (fpFlow) {
+		fprintf(fpFlow, "run,flow,type,tstart,throughput_kbps,qdelay_p50_ms,qdelay_p95_ms,qdelay_p99_ms,"
+			"rtpqdelay_p50_ms,rtpqdelay_p95_ms,rtpqdelay_p99_ms,ce_pct,delivered,dropped\n");
+	}
+
+	/*
+	* Rows are printed in run order, as soon as all earlier runs are done
+	*/
+	vector<string> rows(runs.size());
+	vector<string> flowRows(runs.size());
+	vector<bool> isDone(runs.size(), false);
+	size_t nextPrint = 0;
+	bool isFailed = false;
+	mutex lock;
+	atomic<size_t> nextRun(0);
+
+	vector<thread> workers;
+	for (int k = 0; k < nThreads; k++) {
+		workers.push_back(thread([&]() {
+			size_t run;
+			while ((run = nextRun++) < runs.size()) {
+				const SimulationParams& params = runs[run];
+				SimulationKpi kpi;
+				Simulation simulation(params);
+				bool isOk = simulation.run(kpi);
+				char s[500];
+				snprintf(s, sizeof(s), "%zu,%u,%s,%d,%s,%s,%.4f,%.0f,%.4f,%.3f,%.4f,"
+					"%.1f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%d,%d,%llu,%.4f\n",
+					run, params.seed, params.linkTrace ? params.linkTrace : "fixed",
+					params.nScreamFlows, params.tcpFlows ? params.tcpFlows : "none",
+					params.aqm ? params.aqm : "default",
+					params.RTT, params.linkRate, params.queueDelayTarget,
+					params.packetPacingHeadroom, params.multiplicativeIncreaseScalefactor,
+					kpi.throughput / 1e3f, kpi.utilization,
+					kpi.queueDelayP50 * 1e3f, kpi.queueDelayP95 * 1e3f, kpi.queueDelayP99 * 1e3f,
+					kpi.rtpQueueDelayP50 * 1e3f, kpi.rtpQueueDelayP95 * 1e3f, kpi.rtpQueueDelayP99 * 1e3f,
+					kpi.ceRate * 100.0f, kpi.nDelivered, kpi.nDropped, (unsigned long long)kpi.nEvents, kpi.fairness);
+				string flowRow;
+				for (size_t k = 0; k < kpi.flows.size(); k++) {
+					const FlowKpi& flow = kpi.flows[k];
+					char t[300];
+					snprintf(t, sizeof(t), "%zu,%zu,%s,%.2f,%.1f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%d,%d\n",
+						run, k, flow.type, flow.tStart, flow.throughput / 1e3f,
+						flow.queueDelayP50 * 1e3f, flow.queueDelayP95 * 1e3f, flow.queueDelayP99 * 1e3f,
+						flow.rtpQueueDelayP50 * 1e3f, flow.rtpQueueDelayP95 * 1e3f, flow.rtpQueueDelayP99 * 1e3f,
+						flow.ceRate * 100.0f, flow.nDelivered, flow.nDropped);
+					flowRow += t;
+				}
+
+				std::unique_lock<std::mutex> guard(lock);
+				if (!isOk)
+					isFailed = true;
+				rows[run] = s;
+				flowRows[run] = flowRow;
+				isDone[run] = true;
+				while (nextPrint < runs.size() && isDone[nextPrint]) {
+					fputs(rows[nextPrint].c_str(), stdout);
+					rows[nextPrint].clear();
+					if (fpFlow) {
+						fputs(flowRows[nextPrint].c_str(), fpFlow);
+						flowRows[nextPrint].clear();
+					}
+					nextPrint++;
+				}
+				fflush(stdout);
+			}
+		}));
+	}
+	for (size_t k = 0; k < workers.size(); k++)
+		workers[k].join();
+	if (fpFlow)
+		fclose(fpFlow);
+	return isFailed ? 1 : 0;
+}
@@ -1,6 +1,7 @@
 // Scream sender side wrapper
 #include "ScreamTx.h"
 #include "RtpQueue.h"
+#include "Clock.h"
 #include "sys/types.h"
 #include <sys/time.h>
 #include <pthread.h>
@@ -114,13 +115,14 @@ uint32_t tD_ntp = 0;//(INT64_C(1) << 32)*1000 - 5000000;
 pthread_mutex_t lock_scream;
 
 FILE *fp_log = 0;
+StatsShm *statsShm = 0;
 
 bool ntp = false;
 bool append = false;
 bool itemlist = false;
 bool detailed = false;
 
-double t0=0;
+Clock* appClock = 0;
 
 int mtu = 1200;
 int mtuList[10];
@@ -129,12 +131,7 @@ int nMtuListItems = 1;
 int minPktsInFlight = 0;
 
 uint32_t getTimeInNtp(){
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  double time = tp.tv_sec + tp.tv_usec*1e-6-t0;
-  uint64_t ntp64 = uint64_t(time*65536.0);
-  uint32_t ntp = 0xFFFFFFFF & ntp64;
-  return ntp;
+  return appClock->getTimeInNtp();
 }
 
 // Accumulated pace time, used to avoid starting very short pace timers
@@ -158,7 +155,7 @@ void *transmitRtpThread(void *arg) {
   float retVal = 0.0f;
   int sizeOfQueue;
   uint32_t ssrc = 0;
-  struct timeval start, end;
+  uint64_t start_ns;
   useconds_t diff = 0;
   stream_t *stream = NULL;
   printf("%s %u \n", __FUNCTION__, __LINE__);
@@ -179,7 +176,7 @@ void *transmitRtpThread(void *arg) {
       sizeOfQueue = stream->rtpQueue->sizeOfQueue();
       pthread_mutex_unlock(&stream->lock_rtp_queue);
       do {
-         gettimeofday(&start, 0);
+         start_ns = appClock->getTimeInNs();
          time_ntp = getTimeInNtp();
 
          retVal = screamTx->isOkToTransmit(time_ntp, ssrc);
@@ -211,7 +208,7 @@ void *transmitRtpThread(void *arg) {
                }
            }
            if ((cur_n_streams > 1) && (sleeps++ < 120)) {
-               usleep(500);
+               appClock->sleepUs(500);
            }
            time_ntp = getTimeInNtp();
            pthread_mutex_lock(&lock_scream);
@@ -221,8 +218,7 @@ void *transmitRtpThread(void *arg) {
          pthread_mutex_lock(&stream->lock_rtp_queue);
          sizeOfQueue = stream->rtpQueue->sizeOfQueue();
          pthread_mutex_unlock(&stream->lock_rtp_queue);
-         gettimeofday(&end, 0);
-         diff = end.tv_usec-start.tv_usec;
+         diff = useconds_t((appClock->getTimeInNs() - start_ns) / 1000);
          accumulatedPaceTime = std::max(0.0f, accumulatedPaceTime-diff*1e-6f);
       } while (accumulatedPaceTime <= minPaceInterval &&
            retVal != -1.0f &&
@@ -232,7 +228,7 @@ void *transmitRtpThread(void *arg) {
           accumulatedPaceTime = 0.0f;
       }
     }
-    usleep(sleepTime_us);
+    appClock->sleepUs(sleepTime_us);
     sleepTime_us = 0;
   }
   return NULL;
@@ -314,21 +310,32 @@ statsPrintThread(void *arg)
             }
             lastLogTv_ntp = time_ntp;
         }
-        usleep(50000);
+        if (statsShm) {
+            StatsSnapshot snapshot;
+            pthread_mutex_lock(&lock_scream);
+            screamTx->getStatsSnapshot(time_ntp/65536.0f, snapshot);
+            pthread_mutex_unlock(&lock_scream);
+            statsShm->publish(snapshot);
+        }
+        appClock->sleepUs(50000);
     };
     stopThread = true;
-    usleep(500000);
+    appClock->sleepUs(500000);
     if (fp_log)
       fclose(fp_log);
+    delete statsShm;
+    statsShm = 0;
     return (NULL);
 }
 
 int tx_plugin_main(int argc, char* argv[], uint32_t ssrc)
 {
   stream_t *stream = getStream(ssrc);
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  t0 = tp.tv_sec + tp.tv_usec*1e-6 - 1e-3;
+  /*
+  * One clock for all streams, time must not restart when a stream is added
+  */
+  if (appClock == NULL)
+    appClock = new RealClock();
   lastT_ntp = getTimeInNtp();
 
   /*
@@ -370,6 +377,8 @@ int tx_plugin_main(int argc, char* argv[], uint32_t ssrc)
     std::cerr << "     -verbose                 Print a more extensive log" << std::endl;
     std::cerr << "     -nosummary               Don't print summary" << std::endl;
     std::cerr << "     -log logfile             Save detailed per-ACK log to file" << std::endl;
+    std::cerr << "     -statshm name            Publish a statistics snapshot every 50ms in the POSIX shared" << std::endl;
+    std::cerr << "                               memory segment name (e.g /scream_stats)" << std::endl;
     std::cerr << "     -ntp                     Use NTP timestamp in logfile" << std::endl;
     std::cerr << "     -append                  Append logfile" << std::endl;
     std::cerr << "     -mtu values              List of mtu values separated by , without space"  << std::endl;
@@ -385,6 +394,7 @@ int tx_plugin_main(int argc, char* argv[], uint32_t ssrc)
   }
   int ix = 1;
   char *logFile = 0;
+  char *statShmName = 0;
   /* First find options */
   while (ix < argc) {
       if (!strstr(argv[ix],"-")) {
@@ -500,6 +510,11 @@ int tx_plugin_main(int argc, char* argv[], uint32_t ssrc)
       ix+=2;
 			continue;
     }
+    if (strstr(argv[ix],"-statshm")) {
+      statShmName = argv[ix+1];
+      ix+=2;
+			continue;
+    }
     if (strstr(argv[ix],"-sierralog")) {
       sierraLog = true;
       ix++;
@@ -618,6 +633,14 @@ int tx_plugin_main(int argc, char* argv[], uint32_t ssrc)
       screamTx->setDetailedLogFp(fp_log);
       screamTx->useExtraDetailedLog(detailed);
 
+      if (statShmName) {
+          statsShm = new StatsShm(statShmName, true);
+          if (!statsShm->isOpen()) {
+              delete statsShm;
+              statsShm = 0;
+          }
+      }
+
       pthread_mutex_init(&lock_scream, NULL);
       pthread_mutex_init(&stream->lock_rtp_queue, NULL);
   }
@@ -849,9 +872,7 @@ void ScreamSenderGetTargetRate (uint32_t ssrc, uint32_t *rate_p, uint32_t *force
         /*
          * Force-IDR in case of loss
          */
-        struct timeval tp;
-        gettimeofday(&tp, NULL);
-        double time = tp.tv_sec + tp.tv_usec*1e-6-t0;
+        double time = appClock->getTimeInNs()*1e-9;
 
         if (screamTx->isLossEpoch(ssrc)) {
             stream->lastLossEpochT = time;
@@ -1,5 +1,6 @@
 #include "ScreamTx.h"
 #include "RtpQueue.h"
+#include "Clock.h"
 #include "sys/types.h"
 #include <sys/time.h>
 #include <pthread.h>
@@ -40,7 +41,7 @@ static float burstSleepTime = -1.0;
 static float rateScale = 0.5f;
 static uint32_t SSRC = 100;
 static uint64_t numframes = UINT64_MAX;
-static double t0=0;
+extern Clock* appClock;
 
 static int makePeriodic(unsigned int period, struct periodicInfo *info)
 {
@@ -202,9 +203,8 @@ static uint32_t lastT_ntp;
 
 int txbw_plugin_main(int argc, char* argv[])
 {
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  t0 = tp.tv_sec + tp.tv_usec*1e-6 - 1e-3;
+  if (appClock == NULL)
+    appClock = new RealClock();
   lastT_ntp = getTimeInNtp();
 
   /*
@@ -304,10 +304,10 @@ int txbw_plugin_main(int argc, char* argv[])
 	/* Create RTP thread */
 	pthread_create(&create_rtp_thread, NULL, createRtpThread, (void*)"Create RTP thread...");
     while (!stopThread && (runTime < 0 || getTimeInNtp() < runTime*65536.0f)) {
-        usleep(500000);
+        appClock->sleepUs(500000);
     }
     stopThread = true;
-	usleep(500000);
+	appClock->sleepUs(500000);
 }
   exit (0);
 }
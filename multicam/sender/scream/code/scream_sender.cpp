@@ -74,7 +74,6 @@ int in_port[MAX_SOURCES] = {30000,30002,30004,30006};
 uint32_t in_ssrc[MAX_SOURCES] = {1, 2, 3, 4};
 uint32_t in_ssrc_network[MAX_SOURCES]; // Network ordered versions of in_ssrc
 float priority[MAX_SOURCES] = { 1.0, 0.5, 0.1, 1.0};
-unsigned char *rtpBufs[MAX_SOURCES][kRtpQueueSize];
 float congestionScaleFactor = 0.9;
 int bytesInFlightHistSize = 5;
 float maxTotalRate = 100000000;
@@ -563,6 +562,7 @@ void *txRtpThread(void *arg) {
     		sendPacket((char*)buf, size);
     		nTx++;
     		pthread_mutex_unlock(&lock_rtp_queue);
+    		rtpQueue->freePacket(buf, ssrc);
 
         pthread_mutex_lock(&lock_scream);
     		time_ntp = getTimeInNtp();
@@ -616,9 +616,7 @@ void *txRtpThread(void *arg) {
             */
             RtpQueue *rtpQueue = (RtpQueue*)screamTx->getStreamQueue(ssrc);
 
-            pthread_mutex_lock(&lock_rtp_queue);
             sizeOfQueue = rtpQueue->sizeOfQueue();
-            pthread_mutex_unlock(&lock_rtp_queue);
             do {
                 if (retVal == -1.0f) {
                     sizeOfQueue = 0;
@@ -630,19 +628,19 @@ void *txRtpThread(void *arg) {
                         /*
                         * Get RTP packet from the selected RTP queue
                         */
-                        pthread_mutex_lock(&lock_rtp_queue);
                         bool isMark;
 						uint32_t ssrc_unused;
 
                         float rtpQueueDelay = 0.0f;
                         rtpQueueDelay = rtpQueue->getDelay((time_ntp) / 65536.0f);
-                        rtpQueue->pop(&buf, size, ssrc_unused, seqNr, isMark, ts);
-                        pthread_mutex_unlock(&lock_rtp_queue);
+                        if (!rtpQueue->pop(&buf, size, ssrc_unused, seqNr, isMark, ts))
+                            break;
 
                         /*
                         * Transmit RTP packet
                         */
                         sendPacket((char *)buf, size);
+                        rtpQueue->freePacket(buf, ssrc);
 
                         /*
                         * Register transmitted RTP packet
@@ -670,9 +668,7 @@ void *txRtpThread(void *arg) {
                         * Get RTP queue for selected stream (ssrc)
                         */
                         rtpQueue = (RtpQueue*)screamTx->getStreamQueue(ssrc);
-                        pthread_mutex_lock(&lock_rtp_queue);
                         sizeOfQueue = rtpQueue->sizeOfQueue();
-                        pthread_mutex_unlock(&lock_rtp_queue);
                     }
                 }
 
@@ -723,86 +719,58 @@ void processRtp(unsigned char *buf_rtp, int recvlen, int ix) {
         * on receiver side
         */
         memcpy(&buf_rtp[8], &in_ssrc_network[ix], 4);
-        pthread_mutex_lock(&lock_rtp_queue);
         uint32_t ssrc_unused = 0;
-        rtpQueue[ix]->push(buf_rtp, recvlen, ssrc_unused, seqNr, isMark, (getTimeInNtp())/65536.0f, ts);
-        pthread_mutex_unlock(&lock_rtp_queue);
+        if (!rtpQueue[ix]->push(buf_rtp, recvlen, ssrc_unused, seqNr, isMark, (getTimeInNtp())/65536.0f, ts))
+            rtpQueue[ix]->freePacket(buf_rtp, in_ssrc[ix]);
 
         pthread_mutex_lock(&lock_scream);
         screamTx->newMediaFrame(getTimeInNtp(), in_ssrc[ix], recvlen, isMark);
         pthread_mutex_unlock(&lock_scream);
+    } else {
+        rtpQueue[ix]->freePacket(buf_rtp, in_ssrc[ix]);
     }
 }
 
 /*
 * One thread for each media source (camera)
+* The RTP packets are received directly into buffers from the packet pool
+*  of the RTP queue, the buffers are returned to the pool when the packets
+*  are transmitted
 */
-void *rxRtpThread0(void *arg) {
-	for (int n=0; n < kRtpQueueSize; n++) {
-	  rtpBufs[0][n] = new unsigned char[BUFSIZE];
-    }
-    int rtpBufIx = 0;
-    //unsigned char buf_rtp[BUFSIZE];
+void rxRtp(int ix) {
+    unsigned char buf_drop[BUFSIZE];
     for (;;) {
-		unsigned char *buf_rtp = rtpBufs[0][rtpBufIx];
-        int len = recvRtp(buf_rtp, 0);
-        if (len > 0) {
-            processRtp(buf_rtp, len, 0);
+        unsigned char *buf_rtp = (unsigned char*)rtpQueue[ix]->allocPacket();
+        if (buf_rtp == NULL) {
+            /*
+            * Packet pool is empty because the RTP queue is full, drop the packet
+            */
+            recvRtp(buf_drop, ix);
+        } else {
+            int len = recvRtp(buf_rtp, ix);
+            if (len > 0) {
+                processRtp(buf_rtp, len, ix);
+            } else {
+                rtpQueue[ix]->freePacket(buf_rtp, in_ssrc[ix]);
+            }
         }
-        rtpBufIx = (rtpBufIx+1) % kRtpQueueSize;
         usleep(10);
     }
-    /*
-     * ToDo delete rtpBufs ?
-     */
+}
+void *rxRtpThread0(void *arg) {
+    rxRtp(0);
     return NULL;
 }
 void *rxRtpThread1(void *arg) {
-	for (int n=0; n < kRtpQueueSize; n++) {
-	  rtpBufs[1][n] = new unsigned char[BUFSIZE];
-    }
-    int rtpBufIx = 0;
-    for (;;) {
-		unsigned char *buf_rtp = rtpBufs[1][rtpBufIx];
-        int len = recvRtp(buf_rtp, 1);
-        if (len > 0) {
-            processRtp(buf_rtp, len, 1);
-        }
-        rtpBufIx = (rtpBufIx+1) % kRtpQueueSize;
-        usleep(10);
-    }
+    rxRtp(1);
     return NULL;
 }
 void *rxRtpThread2(void *arg) {
-	for (int n=0; n < kRtpQueueSize; n++) {
-	  rtpBufs[2][n] = new unsigned char[BUFSIZE];
-    }
-    int rtpBufIx = 0;
-    for (;;) {
-		unsigned char *buf_rtp = rtpBufs[2][rtpBufIx];
-        int len = recvRtp(buf_rtp, 2);
-        if (len > 0) {
-            processRtp(buf_rtp, len, 2);
-        }
-        rtpBufIx = (rtpBufIx+1) % kRtpQueueSize;
-        usleep(10);
-    }
+    rxRtp(2);
     return NULL;
 }
 void *rxRtpThread3(void *arg) {
-	for (int n=0; n < kRtpQueueSize; n++) {
-	  rtpBufs[3][n] = new unsigned char[BUFSIZE];
-    }
-    int rtpBufIx = 0;
-    for (;;) {
-		unsigned char *buf_rtp = rtpBufs[3][rtpBufIx];
-        int len = recvRtp(buf_rtp, 3);
-        if (len > 0) {
-            processRtp(buf_rtp, len, 3);
-        }
-        rtpBufIx = (rtpBufIx+1) % kRtpQueueSize;
-        usleep(10);
-    }
+    rxRtp(3);
     return NULL;
 }
 
@@ -961,7 +929,7 @@ int setup() {
 
 
     for (int n = 0; n < nSources; n++) {
-        rtpQueue[n] = new RtpQueue();
+        rtpQueue[n] = new RtpQueue(kRtpQueueSize + 2, BUFSIZE);
         screamTx->registerNewStream(rtpQueue[n],
             in_ssrc[n], priority[n],
             rateMin[n]*1000, rateInit[n]*1000, rateMax[n]*1000, 0.2f,false);